@@ -30,14 +30,45 @@
 #include <linux/poll.h>
 #include <linux/anon_inodes.h>
 #include <linux/file.h>
+#include <linux/hash.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+#include <linux/version.h>
+
+/* The reservation object fence API used here, as by kbase's dma-fence support */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 17, 0) && \
+	LINUX_VERSION_CODE < KERNEL_VERSION(4, 10, 0)
+#define DMA_BUF_LOCK_HAVE_FENCE 1
+#include <linux/fence.h>
+#include <linux/reservation.h>
+#include <linux/ww_mutex.h>
+#endif
 
 #include "dma_buf_lock.h"
 
 /* Maximum number of buffers that a single handle can address */
 #define DMA_BUF_LOCK_BUF_MAX 32
 
+/* Maximum number of lock requests in one batch */
+#define DMA_BUF_LOCK_BATCH_MAX 16
+
+/* Lock handles are hashed on their set of dma-bufs into this many buckets */
+#define DMA_BUF_LOCK_HASH_BITS 6
+#define DMA_BUF_LOCK_HASH_SIZE (1 << DMA_BUF_LOCK_HASH_BITS)
+
 #define DMA_BUF_LOCK_DEBUG 1
 
+/*
+ * Locks are implemented either on KDS or, where the kernel has reservation
+ * objects, by adding fences to the buffers' reservation objects, which lets
+ * the fences of other drivers take part. Chosen at module load.
+ */
+static char *backend = "kds";
+module_param(backend, charp, 0444);
+MODULE_PARM_DESC(backend, "Lock implementation, kds or fence");
+
+static bool dma_buf_lock_use_fence;
+
 static dev_t dma_buf_lock_dev;
 static struct cdev dma_buf_lock_cdev;
 static struct class *dma_buf_lock_class;
@@ -71,16 +102,59 @@ typedef struct dma_buf_lock_resource
 	wait_queue_head_t wait;
 	struct kds_callback cb;
 	struct kref refcount;
-	struct list_head link;
+	struct hlist_node link;
+	struct dma_buf_lock_bucket *bucket;     /* NULL until the buffers are resolved */
 	int count;
+#ifdef DMA_BUF_LOCK_HAVE_FENCE
+	struct fence *fence;                    /* Signalled on unlock, NULL with KDS */
+	atomic_t dep_count;                     /* Fences still to signal before the lock is held */
+	struct list_head fence_callbacks;
+#endif
 } dma_buf_lock_resource;
 
-static LIST_HEAD(dma_buf_lock_resource_list);
-static DEFINE_MUTEX(dma_buf_lock_mutex);
+typedef struct dma_buf_lock_bucket
+{
+	struct mutex lock;
+	struct hlist_head resources;
+} dma_buf_lock_bucket;
+
+static dma_buf_lock_bucket dma_buf_lock_buckets[DMA_BUF_LOCK_HASH_SIZE];
 
 static inline int is_dma_buf_lock_file(struct file *);
 static void dma_buf_lock_dounlock(struct kref *ref);
 
+/*
+ * The hash of a handle does not depend on the order its buffers were listed
+ * in, so requests on the same set of buffers share a bucket.
+ */
+static dma_buf_lock_bucket *dma_buf_lock_bucket_of(dma_buf_lock_resource *resource)
+{
+	u32 key = 0;
+	int i;
+
+	for (i = 0; i < resource->count; i++)
+	{
+		key ^= hash_ptr(resource->dma_bufs[i], 32);
+	}
+
+	return &dma_buf_lock_buckets[hash_32(key, DMA_BUF_LOCK_HASH_BITS)];
+}
+
+static void dma_buf_lock_resource_put(dma_buf_lock_resource *resource)
+{
+	dma_buf_lock_bucket *bucket = resource->bucket;
+
+	if (NULL == bucket)
+	{
+		kref_put(&resource->refcount, dma_buf_lock_dounlock);
+		return;
+	}
+
+	mutex_lock(&bucket->lock);
+	kref_put(&resource->refcount, dma_buf_lock_dounlock);
+	mutex_unlock(&bucket->lock);
+}
+
 static int dma_buf_lock_handle_release(struct inode *inode, struct file *file)
 {
 	dma_buf_lock_resource *resource;
@@ -92,9 +166,7 @@ static int dma_buf_lock_handle_release(struct inode *inode, struct file *file)
 #if DMA_BUF_LOCK_DEBUG
 	printk("dma_buf_lock_handle_release\n");
 #endif
-	mutex_lock(&dma_buf_lock_mutex);
-	kref_put(&resource->refcount, dma_buf_lock_dounlock);
-	mutex_unlock(&dma_buf_lock_mutex);
+	dma_buf_lock_resource_put(resource);
 
 	return 0;
 }
@@ -160,6 +232,319 @@ static inline int is_dma_buf_lock_file(struct file *file)
 
 
 
+#ifdef DMA_BUF_LOCK_HAVE_FENCE
+
+typedef struct dma_buf_lock_fence_cb
+{
+	struct fence_cb fence_cb;
+	struct fence *fence;
+	dma_buf_lock_resource *resource;
+	struct list_head node;
+} dma_buf_lock_fence_cb;
+
+/* Protects all dma_buf_lock fences as fence->lock */
+static DEFINE_SPINLOCK(dma_buf_lock_fence_lock);
+/* u64 holds the context of all kernels, it is 64-bit since 4.8 */
+static u64 dma_buf_lock_fence_context;
+static atomic_t dma_buf_lock_fence_seqno = ATOMIC_INIT(0);
+
+static const char *dma_buf_lock_fence_get_driver_name(struct fence *fence)
+{
+	return dma_buf_lock_dev_name;
+}
+
+static const char *dma_buf_lock_fence_get_timeline_name(struct fence *fence)
+{
+	return dma_buf_lock_dev_name;
+}
+
+static bool dma_buf_lock_fence_enable_signaling(struct fence *fence)
+{
+	return true;
+}
+
+static const struct fence_ops dma_buf_lock_fence_ops = {
+	.get_driver_name = dma_buf_lock_fence_get_driver_name,
+	.get_timeline_name = dma_buf_lock_fence_get_timeline_name,
+	.enable_signaling = dma_buf_lock_fence_enable_signaling,
+	.wait = fence_default_wait,
+};
+
+static void dma_buf_lock_fence_dep_done(dma_buf_lock_resource *resource)
+{
+	if (atomic_dec_and_test(&resource->dep_count))
+	{
+		atomic_set(&resource->locked, 1);
+		wake_up(&resource->wait);
+	}
+}
+
+/* Called with fence->lock held, so fence_remove_callback() waits for it */
+static void dma_buf_lock_fence_callback(struct fence *fence, struct fence_cb *cb)
+{
+	dma_buf_lock_fence_cb *lock_cb = container_of(cb, dma_buf_lock_fence_cb, fence_cb);
+
+	dma_buf_lock_fence_dep_done(lock_cb->resource);
+}
+
+static int dma_buf_lock_fence_add_callback(dma_buf_lock_resource *resource,
+                                           struct fence *fence)
+{
+	dma_buf_lock_fence_cb *lock_cb;
+	int err;
+
+	/* Our own fences on other buffers of the same request */
+	if (fence == resource->fence)
+	{
+		return 0;
+	}
+
+	lock_cb = kmalloc(sizeof(*lock_cb), GFP_KERNEL);
+	if (NULL == lock_cb)
+	{
+		return -ENOMEM;
+	}
+
+	lock_cb->fence = fence_get(fence);
+	lock_cb->resource = resource;
+	list_add(&lock_cb->node, &resource->fence_callbacks);
+
+	atomic_inc(&resource->dep_count);
+	err = fence_add_callback(fence, &lock_cb->fence_cb, dma_buf_lock_fence_callback);
+	if (err == -ENOENT)
+	{
+		/* Already signalled */
+		atomic_dec(&resource->dep_count);
+		err = 0;
+	}
+
+	return err;
+}
+
+static int dma_buf_lock_fence_add_deps(dma_buf_lock_resource *resource,
+                                       struct reservation_object *resv)
+{
+	struct fence *excl_fence = NULL;
+	struct fence **shared_fences = NULL;
+	unsigned int shared_count = 0;
+	unsigned int i;
+	int err;
+
+	err = reservation_object_get_fences_rcu(resv, &excl_fence,
+	                                        &shared_count, &shared_fences);
+	if (err)
+	{
+		return err;
+	}
+
+	if (excl_fence)
+	{
+		err = dma_buf_lock_fence_add_callback(resource, excl_fence);
+		fence_put(excl_fence);
+	}
+
+	/* Readers only wait for the last writer, a writer waits for readers too */
+	for (i = 0; !err && resource->exclusive && i < shared_count; i++)
+	{
+		err = dma_buf_lock_fence_add_callback(resource, shared_fences[i]);
+	}
+
+	for (i = 0; i < shared_count; i++)
+	{
+		fence_put(shared_fences[i]);
+	}
+	kfree(shared_fences);
+
+	return err;
+}
+
+static int dma_buf_lock_fence_lock_resvs(struct reservation_object **resvs, int count,
+                                         struct ww_acquire_ctx *ctx)
+{
+	struct reservation_object *contended = NULL;
+	int contended_idx = 0;
+	int i;
+	int err = 0;
+
+	ww_acquire_init(ctx, &reservation_ww_class);
+
+retry:
+	for (i = 0; i < count; i++)
+	{
+		if (resvs[i] == contended)
+		{
+			contended = NULL;
+			continue;
+		}
+
+		err = ww_mutex_lock(&resvs[i]->lock, ctx);
+		if (err)
+		{
+			goto error;
+		}
+	}
+
+	ww_acquire_done(ctx);
+	return 0;
+
+error:
+	contended_idx = i;
+
+	while (i--)
+	{
+		ww_mutex_unlock(&resvs[i]->lock);
+	}
+
+	if (contended)
+	{
+		ww_mutex_unlock(&contended->lock);
+	}
+
+	if (err == -EDEADLK)
+	{
+		contended = resvs[contended_idx];
+		ww_mutex_lock_slow(&contended->lock, ctx);
+		goto retry;
+	}
+
+	ww_acquire_fini(ctx);
+	return err;
+}
+
+/*
+ * Start the lock: wait for the fences already on the buffers which conflict
+ * with the request, and add a fence of our own which later requests wait
+ * for, signalled when the lock is released.
+ */
+static int dma_buf_lock_fence_start(dma_buf_lock_resource *resource)
+{
+	struct reservation_object *resvs[DMA_BUF_LOCK_BUF_MAX];
+	struct ww_acquire_ctx ctx;
+	int nr_resvs = 0;
+	int i, j;
+	int err;
+
+	/* A buffer listed twice is only locked once */
+	for (i = 0; i < resource->count; i++)
+	{
+		struct reservation_object *resv = resource->dma_bufs[i]->resv;
+
+		for (j = 0; j < nr_resvs; j++)
+		{
+			if (resvs[j] == resv)
+			{
+				break;
+			}
+		}
+		if (j == nr_resvs)
+		{
+			resvs[nr_resvs++] = resv;
+		}
+	}
+
+	resource->fence = kzalloc(sizeof(*resource->fence), GFP_KERNEL);
+	if (NULL == resource->fence)
+	{
+		return -ENOMEM;
+	}
+	fence_init(resource->fence, &dma_buf_lock_fence_ops, &dma_buf_lock_fence_lock,
+	           dma_buf_lock_fence_context,
+	           atomic_inc_return(&dma_buf_lock_fence_seqno));
+
+	/* Held until every callback is set up */
+	atomic_set(&resource->dep_count, 1);
+
+	err = dma_buf_lock_fence_lock_resvs(resvs, nr_resvs, &ctx);
+	if (err)
+	{
+		return err;
+	}
+
+	for (i = 0; i < nr_resvs; i++)
+	{
+		err = dma_buf_lock_fence_add_deps(resource, resvs[i]);
+		if (err)
+		{
+			break;
+		}
+
+		if (resource->exclusive)
+		{
+			reservation_object_add_excl_fence(resvs[i], resource->fence);
+		}
+		else
+		{
+			err = reservation_object_reserve_shared(resvs[i]);
+			if (err)
+			{
+				break;
+			}
+			reservation_object_add_shared_fence(resvs[i], resource->fence);
+		}
+	}
+
+	for (i = 0; i < nr_resvs; i++)
+	{
+		ww_mutex_unlock(&resvs[i]->lock);
+	}
+	ww_acquire_fini(&ctx);
+
+	/*
+	 * On error the fence is already on some buffers, the caller signals it
+	 * with dma_buf_lock_fence_stop() so that they are not left locked.
+	 */
+	if (!err)
+	{
+		dma_buf_lock_fence_dep_done(resource);
+	}
+
+	return err;
+}
+
+static void dma_buf_lock_fence_stop(dma_buf_lock_resource *resource)
+{
+	dma_buf_lock_fence_cb *lock_cb, *tmp;
+
+	list_for_each_entry_safe(lock_cb, tmp, &resource->fence_callbacks, node)
+	{
+		fence_remove_callback(lock_cb->fence, &lock_cb->fence_cb);
+		fence_put(lock_cb->fence);
+		list_del(&lock_cb->node);
+		kfree(lock_cb);
+	}
+
+	if (resource->fence)
+	{
+		fence_signal(resource->fence);
+		fence_put(resource->fence);
+		resource->fence = NULL;
+	}
+}
+
+static int dma_buf_lock_fence_init(void)
+{
+	dma_buf_lock_fence_context = fence_context_alloc(1);
+	return 0;
+}
+
+#else /* DMA_BUF_LOCK_HAVE_FENCE */
+
+static int dma_buf_lock_fence_start(dma_buf_lock_resource *resource)
+{
+	return -ENODEV;
+}
+
+static void dma_buf_lock_fence_stop(dma_buf_lock_resource *resource)
+{
+}
+
+static int dma_buf_lock_fence_init(void)
+{
+	return -ENODEV;
+}
+
+#endif /* DMA_BUF_LOCK_HAVE_FENCE */
+
 /*
  * Start requested lock.
  *
@@ -170,6 +555,7 @@ static int dma_buf_lock_dolock(dma_buf_lock_k_request *request)
 {
 	dma_buf_lock_resource *resource;
 	int size;
+	struct file *file;
 	int fd;
 	int i;
 	int ret;
@@ -200,8 +586,12 @@ static int dma_buf_lock_dolock(dma_buf_lock_k_request *request)
 
 	atomic_set(&resource->locked, 0);
 	kref_init(&resource->refcount);
-	INIT_LIST_HEAD(&resource->link);
+	INIT_HLIST_NODE(&resource->link);
 	resource->count = request->count;
+	init_waitqueue_head(&resource->wait);
+#ifdef DMA_BUF_LOCK_HAVE_FENCE
+	INIT_LIST_HEAD(&resource->fence_callbacks);
+#endif
 
 	/* Allocate space to store dma_buf_fds received from user space */
 	size = request->count * sizeof(int);
@@ -252,13 +642,6 @@ static int dma_buf_lock_dolock(dma_buf_lock_k_request *request)
 	}
 #endif
 
-	/* Add resource to global list */
-	mutex_lock(&dma_buf_lock_mutex);
-
-	list_add(&resource->link, &dma_buf_lock_resource_list);
-
-	mutex_unlock(&dma_buf_lock_mutex);
-
 	for (i = 0; i < request->count; i++)
 	{
 		/* Convert fd into dma_buf structure */
@@ -266,20 +649,24 @@ static int dma_buf_lock_dolock(dma_buf_lock_k_request *request)
 
 		if (IS_ERR_VALUE(PTR_ERR(resource->dma_bufs[i])))
 		{
-			mutex_lock(&dma_buf_lock_mutex);
-			kref_put(&resource->refcount, dma_buf_lock_dounlock);
-			mutex_unlock(&dma_buf_lock_mutex);
+			/* Only the buffers obtained so far are put */
+			resource->count = i;
+			dma_buf_lock_resource_put(resource);
 			return -EINVAL;
 		}
 
+		if (dma_buf_lock_use_fence)
+		{
+			continue;
+		}
+
 		/*Get kds_resource associated with dma_buf */
 		resource->kds_resources[i] = get_dma_buf_kds_resource(resource->dma_bufs[i]);
 
 		if (NULL == resource->kds_resources[i])
 		{
-			mutex_lock(&dma_buf_lock_mutex);
-			kref_put(&resource->refcount, dma_buf_lock_dounlock);
-			mutex_unlock(&dma_buf_lock_mutex);
+			resource->count = i + 1;
+			dma_buf_lock_resource_put(resource);
 			return -EINVAL;
 		}
 #if DMA_BUF_LOCK_DEBUG
@@ -288,52 +675,132 @@ static int dma_buf_lock_dolock(dma_buf_lock_k_request *request)
 #endif	
 	}
 
-	kds_callback_init(&resource->cb, 1, dma_buf_lock_kds_callback);
-	init_waitqueue_head(&resource->wait);
+	/* Add resource to the bucket of its set of buffers */
+	resource->bucket = dma_buf_lock_bucket_of(resource);
+
+	mutex_lock(&resource->bucket->lock);
+	hlist_add_head(&resource->link, &resource->bucket->resources);
+	mutex_unlock(&resource->bucket->lock);
+
+	if (!dma_buf_lock_use_fence)
+	{
+		kds_callback_init(&resource->cb, 1, dma_buf_lock_kds_callback);
+	}
 
 	kref_get(&resource->refcount);
 
-	/* Create file descriptor associated with lock request */
-	fd = anon_inode_getfd("dma_buf_lock", &dma_buf_lock_handle_fops, 
-	                      (void *)resource, 0);
+	/*
+	 * Create file descriptor associated with lock request. It is only
+	 * installed once the lock is started, so that a failed request can
+	 * still take it back.
+	 */
+	fd = get_unused_fd_flags(0);
 	if (fd < 0)
 	{
-		mutex_lock(&dma_buf_lock_mutex);
+		mutex_lock(&resource->bucket->lock);
 		kref_put(&resource->refcount, dma_buf_lock_dounlock);
 		kref_put(&resource->refcount, dma_buf_lock_dounlock);
-		mutex_unlock(&dma_buf_lock_mutex);
+		mutex_unlock(&resource->bucket->lock);
 		return fd;
 	}
 
+	file = anon_inode_getfile("dma_buf_lock", &dma_buf_lock_handle_fops,
+	                          (void *)resource, 0);
+	if (IS_ERR(file))
+	{
+		put_unused_fd(fd);
+		mutex_lock(&resource->bucket->lock);
+		kref_put(&resource->refcount, dma_buf_lock_dounlock);
+		kref_put(&resource->refcount, dma_buf_lock_dounlock);
+		mutex_unlock(&resource->bucket->lock);
+		return PTR_ERR(file);
+	}
+
 	resource->exclusive = request->exclusive;
 
 	/* Start locking process */
-	ret = kds_async_waitall(&resource->resource_set,
-	                        &resource->cb, resource, NULL,
-	                        request->count,  &resource->exclusive,
-	                        resource->kds_resources);
+	if (dma_buf_lock_use_fence)
+	{
+		ret = dma_buf_lock_fence_start(resource);
+	}
+	else
+	{
+		ret = kds_async_waitall(&resource->resource_set,
+		                        &resource->cb, resource, NULL,
+		                        request->count,  &resource->exclusive,
+		                        resource->kds_resources);
+	}
 
 	if (IS_ERR_VALUE(ret))
 	{
+		/* Release the buffers the fence was already added to */
+		if (dma_buf_lock_use_fence)
+		{
+			dma_buf_lock_fence_stop(resource);
+		}
+
+		/* Releasing the file drops its reference */
+		fput(file);
 		put_unused_fd(fd);
 
-		mutex_lock(&dma_buf_lock_mutex);
-		kref_put(&resource->refcount, dma_buf_lock_dounlock);
-		mutex_unlock(&dma_buf_lock_mutex);
+		dma_buf_lock_resource_put(resource);
 
 		return ret;
 	}
 
+	fd_install(fd, file);
+
 #if DMA_BUF_LOCK_DEBUG
 	printk("dma_buf_lock_dolock : complete\n");
 #endif
-	mutex_lock(&dma_buf_lock_mutex);
-	kref_put(&resource->refcount, dma_buf_lock_dounlock);
-	mutex_unlock(&dma_buf_lock_mutex);
+	dma_buf_lock_resource_put(resource);
 
 	return fd;
 }
 
+/*
+ * Start a batch of lock requests.
+ *
+ * Each request is handled as by dma_buf_lock_dolock() and gets its own
+ * lock handle, the fd or error of every request is copied back to
+ * the results array. A failed request does not stop the rest of the batch.
+ */
+static int dma_buf_lock_dolock_batch(dma_buf_lock_k_batch_request *batch)
+{
+	dma_buf_lock_k_request requests[DMA_BUF_LOCK_BATCH_MAX];
+	int results[DMA_BUF_LOCK_BATCH_MAX];
+	int i;
+
+	if (NULL == batch->requests || NULL == batch->results)
+	{
+		return -EINVAL;
+	}
+	if (batch->count <= 0 || batch->count > DMA_BUF_LOCK_BATCH_MAX)
+	{
+		return -EINVAL;
+	}
+
+	if (0 != copy_from_user(requests, (void __user *)batch->requests,
+	                        batch->count * sizeof(dma_buf_lock_k_request)))
+	{
+		return -EFAULT;
+	}
+
+	for (i = 0; i < batch->count; i++)
+	{
+		results[i] = dma_buf_lock_dolock(&requests[i]);
+	}
+
+	/* The handles stay valid if this fails, they are owned by the process */
+	if (0 != copy_to_user((void __user *)batch->results, results,
+	                      batch->count * sizeof(int)))
+	{
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
 static void dma_buf_lock_dounlock(struct kref *ref)
 {
 	int i;
@@ -341,11 +808,18 @@ static void dma_buf_lock_dounlock(struct kref *ref)
 
 	atomic_set(&resource->locked, 0);
 
-	kds_callback_term(&resource->cb);
+	if (dma_buf_lock_use_fence)
+	{
+		dma_buf_lock_fence_stop(resource);
+	}
+	else if (NULL != resource->cb.user_cb)
+	{
+		kds_callback_term(&resource->cb);
 
-	kds_resource_set_release(&resource->resource_set);
+		kds_resource_set_release(&resource->resource_set);
+	}
 
-	list_del(&resource->link);
+	hlist_del_init(&resource->link);
 
 	for (i = 0; i < resource->count; i++)
 	{
@@ -361,9 +835,32 @@ static void dma_buf_lock_dounlock(struct kref *ref)
 static int __init dma_buf_lock_init(void)
 {
 	int err;
+	int i;
 #if DMA_BUF_LOCK_DEBUG
 	printk("dma_buf_lock_init\n");
 #endif
+	for (i = 0; i < DMA_BUF_LOCK_HASH_SIZE; i++)
+	{
+		mutex_init(&dma_buf_lock_buckets[i].lock);
+		INIT_HLIST_HEAD(&dma_buf_lock_buckets[i].resources);
+	}
+
+	if (0 == strcmp(backend, "fence"))
+	{
+		err = dma_buf_lock_fence_init();
+		if (err)
+		{
+			printk(KERN_ERR "dma_buf_lock: fence backend not supported by this kernel\n");
+			return err;
+		}
+		dma_buf_lock_use_fence = true;
+	}
+	else if (0 != strcmp(backend, "kds"))
+	{
+		printk(KERN_ERR "dma_buf_lock: unknown backend %s\n", backend);
+		return -EINVAL;
+	}
+
 	err = alloc_chrdev_region(&dma_buf_lock_dev, 0, 1, dma_buf_lock_dev_name);
 
 	if (0 == err)
@@ -404,26 +901,24 @@ static int __init dma_buf_lock_init(void)
 
 static void __exit dma_buf_lock_exit(void)
 {
+	int i;
 #if DMA_BUF_LOCK_DEBUG
 	printk("dma_buf_lock_exit\n");
 #endif
 
 	/* Unlock all outstanding references */
-	while (1)
+	for (i = 0; i < DMA_BUF_LOCK_HASH_SIZE; i++)
 	{
-		mutex_lock(&dma_buf_lock_mutex);
-		if (list_empty(&dma_buf_lock_resource_list))
-		{
-			mutex_unlock(&dma_buf_lock_mutex);
-			break;
-		}
-		else
+		dma_buf_lock_bucket *bucket = &dma_buf_lock_buckets[i];
+
+		mutex_lock(&bucket->lock);
+		while (!hlist_empty(&bucket->resources))
 		{
-			dma_buf_lock_resource *resource = list_entry(dma_buf_lock_resource_list.next, 
-			                                             dma_buf_lock_resource, link);
+			dma_buf_lock_resource *resource = hlist_entry(bucket->resources.first,
+			                                              dma_buf_lock_resource, link);
 			kref_put(&resource->refcount, dma_buf_lock_dounlock);
-			mutex_unlock(&dma_buf_lock_mutex);
 		}
+		mutex_unlock(&bucket->lock);
 	}
 
 	device_destroy(dma_buf_lock_class, dma_buf_lock_dev);
@@ -442,6 +937,7 @@ static int dma_buf_lock_ioctl(struct inode *inode, struct file *filp, unsigned i
 #endif
 {
 	dma_buf_lock_k_request request;
+	dma_buf_lock_k_batch_request batch;
 	int size = _IOC_SIZE(cmd);
 
 	if (_IOC_TYPE(cmd) != DMA_BUF_LOCK_IOC_MAGIC)
@@ -469,6 +965,19 @@ static int dma_buf_lock_ioctl(struct inode *inode, struct file *filp, unsigned i
 			printk("DMA_BUF_LOCK_FUNC_LOCK_ASYNC - %i\n", request.count);
 #endif
 			return dma_buf_lock_dolock(&request);
+		case DMA_BUF_LOCK_FUNC_LOCK_ASYNC_BATCH:
+			if (size != sizeof(dma_buf_lock_k_batch_request))
+			{
+				return -ENOTTY;
+			}
+			if (copy_from_user(&batch, (void __user *)arg, size))
+			{
+				return -EFAULT;
+			}
+#if DMA_BUF_LOCK_DEBUG
+			printk("DMA_BUF_LOCK_FUNC_LOCK_ASYNC_BATCH - %i\n", batch.count);
+#endif
+			return dma_buf_lock_dolock_batch(&batch);
 	}
 
 	return -ENOTTY;
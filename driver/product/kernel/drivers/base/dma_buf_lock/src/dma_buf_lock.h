@@ -32,11 +32,19 @@ typedef struct dma_buf_lock_k_request
 	dma_buf_lock_exclusive exclusive;
 } dma_buf_lock_k_request;
 
+typedef struct dma_buf_lock_k_batch_request
+{
+	int count;
+	dma_buf_lock_k_request *requests;
+	int *results;                   /* Lock handle fd or negative error, per request */
+} dma_buf_lock_k_batch_request;
+
 #define DMA_BUF_LOCK_IOC_MAGIC '~'
 
 #define DMA_BUF_LOCK_FUNC_LOCK_ASYNC       _IOW(DMA_BUF_LOCK_IOC_MAGIC, 11, dma_buf_lock_k_request)
+#define DMA_BUF_LOCK_FUNC_LOCK_ASYNC_BATCH _IOW(DMA_BUF_LOCK_IOC_MAGIC, 12, dma_buf_lock_k_batch_request)
 
 #define DMA_BUF_LOCK_IOC_MINNR 11
-#define DMA_BUF_LOCK_IOC_MAXNR 11
+#define DMA_BUF_LOCK_IOC_MAXNR 12
 
 #endif /* _DMA_BUF_LOCK_H */
@@ -27,19 +27,31 @@
 #include <linux/workqueue.h>
 #include <linux/kds.h>
 #include <linux/kref.h>
+#include <linux/hash.h>
+#include <linux/bitmap.h>
+#include <linux/cache.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/moduleparam.h>
 
 #include <asm/atomic.h>
 
 #define KDS_LINK_TRIGGERED (1u << 0)
 #define KDS_LINK_EXCLUSIVE (1u << 1)
 
+/* Waiting writer links count the readers that skipped ahead of them here */
+#define KDS_LINK_BYPASS_SHIFT 8
+#define KDS_LINK_BYPASS_ONE (1ul << KDS_LINK_BYPASS_SHIFT)
+
 #define KDS_INVALID (void *)-2
 #define KDS_RESOURCE (void *)-1
 
 struct kds_resource_set
 {
 	unsigned long         num_resources;
-	unsigned long         pending;
+	/* Size class cache this set came from, KDS_RSET_KMALLOC if none */
+	int                   cache;
+	atomic_t              pending;
 	struct kds_callback  *cb;
 	void                 *callback_parameter;
 	void                 *callback_extra_parameter;
@@ -53,18 +65,367 @@ struct kds_resource_set
 	/* This is only initted when kds_waitall() is called. */
 	wait_queue_head_t     wake;
 
+	/* The resource each link is queued on, stored after the links */
+	struct kds_resource **resource_list;
+
 	struct kds_link       resources[0];
 
 };
 
-static DEFINE_SPINLOCK(kds_lock);
+/*
+ * Resources are protected by a hashed array of locks rather than one global
+ * lock, so unrelated resource sets can be acquired and released in parallel.
+ * A resource set takes the locks of all its resources, always in ascending
+ * order, while it queues itself. Any two sets sharing a resource therefore
+ * queue on all their common resources in the same order, which keeps the
+ * acquisition deadlock free exactly as the global lock did. Releases only
+ * need the lock of one resource at a time.
+ */
+#define KDS_LOCK_BITS 6
+#define KDS_NR_LOCKS (1 << KDS_LOCK_BITS)
+
+struct kds_lock
+{
+	spinlock_t lock;
+} ____cacheline_aligned_in_smp;
+
+static struct kds_lock kds_locks[KDS_NR_LOCKS];
+
+/* One lockdep class per lock, they nest in ascending order */
+static struct lock_class_key kds_lock_keys[KDS_NR_LOCKS];
+
+static inline unsigned int kds_lock_index(struct kds_resource *res)
+{
+	return hash_ptr(res, KDS_LOCK_BITS);
+}
+
+static inline spinlock_t *kds_resource_lock(struct kds_resource *res)
+{
+	return &kds_locks[kds_lock_index(res)].lock;
+}
+
+/*
+ * Nearly every resource set covers one to four resources, those are
+ * allocated from per size class slab caches with the links stored inline.
+ * Larger sets fall back to kmalloc.
+ */
+#define KDS_RSET_KMALLOC (-1)
+#define KDS_RSET_NR_CACHES 3
+
+static const int kds_rset_cache_size[KDS_RSET_NR_CACHES] = { 1, 2, 4 };
+
+static const char * const kds_rset_cache_name[KDS_RSET_NR_CACHES] = {
+	"kds_rset_1", "kds_rset_2", "kds_rset_4"
+};
+
+static struct kmem_cache *kds_rset_caches[KDS_RSET_NR_CACHES];
+
+static struct
+{
+	atomic_long_t cached[KDS_RSET_NR_CACHES];
+	atomic_long_t kmalloced;
+	atomic_long_t failed;
+	atomic_long_t live;
+} kds_rset_stats;
+
+static size_t kds_rset_size(int number_resources)
+{
+	return sizeof(struct kds_resource_set) + number_resources *
+			(sizeof(struct kds_link) + sizeof(struct kds_resource *));
+}
+
+static struct kds_resource_set *kds_rset_alloc(int number_resources)
+{
+	struct kds_resource_set *rset;
+	int cache;
+
+	for (cache = 0; cache < KDS_RSET_NR_CACHES; cache++)
+		if (number_resources <= kds_rset_cache_size[cache])
+			break;
+
+	if (cache < KDS_RSET_NR_CACHES && kds_rset_caches[cache])
+	{
+		rset = kmem_cache_alloc(kds_rset_caches[cache], GFP_KERNEL);
+	}
+	else
+	{
+		cache = KDS_RSET_KMALLOC;
+		rset = kmalloc(kds_rset_size(number_resources), GFP_KERNEL);
+	}
+
+	if (!rset)
+	{
+		atomic_long_inc(&kds_rset_stats.failed);
+		return NULL;
+	}
+
+	if (cache == KDS_RSET_KMALLOC)
+		atomic_long_inc(&kds_rset_stats.kmalloced);
+	else
+		atomic_long_inc(&kds_rset_stats.cached[cache]);
+	atomic_long_inc(&kds_rset_stats.live);
+
+	rset->cache = cache;
+	rset->resource_list = (struct kds_resource **)
+			&rset->resources[number_resources];
+
+	return rset;
+}
+
+static void kds_rset_free(struct kds_resource_set *rset)
+{
+	atomic_long_dec(&kds_rset_stats.live);
+
+	if (rset->cache == KDS_RSET_KMALLOC)
+		kfree(rset);
+	else
+		kmem_cache_free(kds_rset_caches[rset->cache], rset);
+}
+
+static void kds_lock_all(unsigned long *locks, unsigned long *lflags)
+{
+	unsigned int i;
+
+	local_irq_save(*lflags);
+	for_each_set_bit(i, locks, KDS_NR_LOCKS)
+		spin_lock(&kds_locks[i].lock);
+}
+
+static void kds_unlock_all(unsigned long *locks, unsigned long lflags)
+{
+	unsigned int i;
+
+	for_each_set_bit(i, locks, KDS_NR_LOCKS)
+		spin_unlock(&kds_locks[i].lock);
+	local_irq_restore(lflags);
+}
+
+/*
+ * Reader batching: a resource set whose links can all be granted straight
+ * away may join the group of readers currently holding a resource even
+ * though a writer is already waiting on it. Such a set never waits, so it
+ * cannot take part in a wait cycle and the acquisition stays deadlock free.
+ * Each waiting writer lets at most kds_reader_bypass_limit readers past it,
+ * 0 disables batching.
+ */
+static unsigned int kds_reader_bypass_limit = 16;
+module_param(kds_reader_bypass_limit, uint, 0644);
+MODULE_PARM_DESC(kds_reader_bypass_limit, "Readers which may be granted ahead of one waiting writer");
+
+static struct
+{
+	/* all resources granted when queued */
+	atomic_long_t immediate;
+	/* granted by joining a reader group ahead of a waiting writer */
+	atomic_long_t batched;
+	/* some resources had to be waited for */
+	atomic_long_t queued;
+	/* batching refused as a waiting writer reached its bound */
+	atomic_long_t bypass_refused;
+} kds_contention_stats;
+
+/* The first link waiting on res behind a group of readers, NULL if none */
+static struct kds_link *kds_reader_group_end(struct kds_resource *res)
+{
+	struct kds_link *it;
+
+	if (list_empty(&res->waiters.link))
+		return NULL;
+
+	it = list_first_entry(&res->waiters.link, struct kds_link, link);
+	if ((it->state & (KDS_LINK_EXCLUSIVE | KDS_LINK_TRIGGERED)) != KDS_LINK_TRIGGERED)
+		return NULL;
+
+	list_for_each_entry(it, &res->waiters.link, link)
+	{
+		if (!(it->state & KDS_LINK_TRIGGERED))
+			return it;
+	}
+
+	return NULL;
+}
+
+/*
+ * Grant every resource of rset at once, letting shared links skip ahead of
+ * waiting writers where needed. Called with all the locks of rset held.
+ * Returns 1 if rset was queued, 0 if it has to take the normal path.
+ */
+static int kds_rset_try_batch(struct kds_resource_set *rset,
+		int number_resources,
+		unsigned long *exclusive_access_bitmap,
+		struct kds_resource **resource_list)
+{
+	unsigned int limit = READ_ONCE(kds_reader_bypass_limit);
+	int bypass = 0;
+	int i, j;
+
+	if (!limit)
+		return 0;
+
+	for (i = 0; i < number_resources; i++)
+	{
+		struct kds_resource *res = resource_list[i];
+		struct kds_link *tail;
+		struct kds_link *writer;
+
+		/* the normal path rejects a resource listed twice */
+		for (j = 0; j < i; j++)
+			if (resource_list[j] == res)
+				return 0;
+
+		if (list_empty(&res->waiters.link))
+			continue;
+
+		if (test_bit(i, exclusive_access_bitmap))
+			return 0;
+
+		tail = list_entry(res->waiters.link.prev, struct kds_link, link);
+		if ((tail->state & (KDS_LINK_EXCLUSIVE | KDS_LINK_TRIGGERED)) == KDS_LINK_TRIGGERED)
+			continue;
+
+		writer = kds_reader_group_end(res);
+		if (!writer)
+			return 0;
+
+		if ((writer->state >> KDS_LINK_BYPASS_SHIFT) >= limit)
+		{
+			atomic_long_inc(&kds_contention_stats.bypass_refused);
+			return 0;
+		}
+		bypass = 1;
+	}
+
+	/* nothing to skip, the normal path grants it just the same */
+	if (!bypass)
+		return 0;
+
+	for (i = 0; i < number_resources; i++)
+	{
+		struct kds_resource *res = resource_list[i];
+		struct kds_link *link = &rset->resources[i];
+		struct kds_link *writer = kds_reader_group_end(res);
+
+		link->state = KDS_LINK_TRIGGERED;
+		if (test_bit(i, exclusive_access_bitmap))
+			link->state |= KDS_LINK_EXCLUSIVE;
+
+		if (writer)
+		{
+			/* join the reader group, just ahead of the writer */
+			writer->state += KDS_LINK_BYPASS_ONE;
+			list_add_tail(&link->link, &writer->link);
+		}
+		else
+		{
+			list_add_tail(&link->link, &res->waiters.link);
+		}
+	}
+	atomic_set(&rset->pending, 0);
+
+	return 1;
+}
+
+/*
+ * Queue the links of rset on their resources, triggering those which can be
+ * granted straight away. Returns 1 if every resource was obtained, 0 if some
+ * are still pending or -EINVAL if rset is already the last waiter of one of
+ * the resources.
+ */
+static int kds_rset_add(struct kds_resource_set *rset,
+		int number_resources,
+		unsigned long *exclusive_access_bitmap,
+		struct kds_resource **resource_list)
+{
+	DECLARE_BITMAP(locks, KDS_NR_LOCKS);
+	unsigned long lflags;
+	int triggered;
+	int i;
+
+	bitmap_zero(locks, KDS_NR_LOCKS);
+	for (i = 0; i < number_resources; i++)
+	{
+		INIT_LIST_HEAD(&rset->resources[i].link);
+		rset->resources[i].parent = rset;
+		rset->resource_list[i] = resource_list[i];
+		__set_bit(kds_lock_index(resource_list[i]), locks);
+	}
+
+	kds_lock_all(locks, &lflags);
+
+	if (kds_rset_try_batch(rset, number_resources,
+			exclusive_access_bitmap, resource_list))
+	{
+		kds_unlock_all(locks, lflags);
+		atomic_long_inc(&kds_contention_stats.batched);
+		return 1;
+	}
+
+	for (i = 0; i < number_resources; i++)
+	{
+		unsigned long link_state = 0;
+
+		if (test_bit(i, exclusive_access_bitmap))
+		{
+			link_state |= KDS_LINK_EXCLUSIVE;
+		}
+
+		/* no-one else waiting? */
+		if (list_empty(&resource_list[i]->waiters.link))
+		{
+			link_state |= KDS_LINK_TRIGGERED;
+			atomic_dec(&rset->pending);
+		}
+		/* Adding a non-exclusive and the current tail is a triggered non-exclusive? */
+		else if (((link_state & KDS_LINK_EXCLUSIVE) == 0) &&
+				(((list_entry(resource_list[i]->waiters.link.prev, struct kds_link, link)->state & (KDS_LINK_EXCLUSIVE | KDS_LINK_TRIGGERED)) == KDS_LINK_TRIGGERED)))
+		{
+			link_state |= KDS_LINK_TRIGGERED;
+			atomic_dec(&rset->pending);
+		}
+		rset->resources[i].state = link_state;
+
+		/* avoid double wait (hang) */
+		if (!list_empty(&resource_list[i]->waiters.link))
+		{
+			/* adding same rset again? */
+			if (list_entry(resource_list[i]->waiters.link.prev, struct kds_link, link)->parent == rset)
+			{
+				goto roll_back;
+			}
+		}
+		list_add_tail(&rset->resources[i].link, &resource_list[i]->waiters.link);
+	}
+
+	/* Releases of our links need one of the locks we hold */
+	triggered = (atomic_read(&rset->pending) == 0);
+
+	kds_unlock_all(locks, lflags);
+
+	if (triggered)
+		atomic_long_inc(&kds_contention_stats.immediate);
+	else
+		atomic_long_inc(&kds_contention_stats.queued);
+
+	return triggered;
+
+roll_back:
+	/* roll back */
+	while (i-- > 0)
+	{
+		list_del(&rset->resources[i].link);
+	}
+
+	kds_unlock_all(locks, lflags);
+
+	return -EINVAL;
+}
 
 static void __resource_set_release(struct kref *ref)
 {
 	struct kds_resource_set *rset = container_of(ref,
 			struct kds_resource_set, refcount);
 
-	kfree(rset);
+	kds_rset_free(rset);
 }
 
 int kds_callback_init(struct kds_callback *cb, int direct, kds_callback_fn user_cb)
@@ -145,17 +506,19 @@ EXPORT_SYMBOL(kds_resource_init);
 
 int kds_resource_term(struct kds_resource *res)
 {
+	spinlock_t *lock;
 	unsigned long lflags;
 	BUG_ON(!res);
-	spin_lock_irqsave(&kds_lock, lflags);
+	lock = kds_resource_lock(res);
+	spin_lock_irqsave(lock, lflags);
 	if (!list_empty(&res->waiters.link))
 	{
-		spin_unlock_irqrestore(&kds_lock, lflags);
+		spin_unlock_irqrestore(lock, lflags);
 		printk(KERN_ERR "ERROR: KDS resource is still in use\n");
 		return -EBUSY;
 	}
 	res->waiters.parent = KDS_INVALID;
-	spin_unlock_irqrestore(&kds_lock, lflags);
+	spin_unlock_irqrestore(lock, lflags);
 	return 0;
 }
 EXPORT_SYMBOL(kds_resource_term);
@@ -170,10 +533,8 @@ int kds_async_waitall(
 		struct kds_resource     **resource_list)
 {
 	struct kds_resource_set *rset = NULL;
-	unsigned long lflags;
-	int i;
+	struct kds_resource_set *prev_rset;
 	int triggered;
-	int err = -EFAULT;
 
 	BUG_ON(!pprset);
 	BUG_ON(!resource_list);
@@ -181,14 +542,14 @@ int kds_async_waitall(
 
 	WARN_ONCE(number_resources > 10, "Waiting on a high numbers of resources may increase latency, see documentation.");
 
-	rset = kmalloc(sizeof(*rset) + number_resources * sizeof(struct kds_link), GFP_KERNEL);
+	rset = kds_rset_alloc(number_resources);
 	if (!rset)
 	{
 		return -ENOMEM;
 	}
 
 	rset->num_resources = number_resources;
-	rset->pending = number_resources;
+	atomic_set(&rset->pending, number_resources);
 	rset->cb = cb;
 	rset->callback_parameter = callback_parameter;
 	rset->callback_extra_parameter = callback_extra_parameter;
@@ -197,56 +558,18 @@ int kds_async_waitall(
 	atomic_set(&rset->cb_queued, 0);
 	kref_init(&rset->refcount);
 
-	for (i = 0; i < number_resources; i++)
-	{
-		INIT_LIST_HEAD(&rset->resources[i].link);
-		rset->resources[i].parent = rset;
-	}
-
-	spin_lock_irqsave(&kds_lock, lflags);
-
-	for (i = 0; i < number_resources; i++)
-	{
-		unsigned long link_state = 0;
-
-		if (test_bit(i, exclusive_access_bitmap))
-		{
-			link_state |= KDS_LINK_EXCLUSIVE;
-		}
-
-		/* no-one else waiting? */
-		if (list_empty(&resource_list[i]->waiters.link))
-		{
-			link_state |= KDS_LINK_TRIGGERED;
-			rset->pending--;
-		}
-		/* Adding a non-exclusive and the current tail is a triggered non-exclusive? */
-		else if (((link_state & KDS_LINK_EXCLUSIVE) == 0) &&
-				(((list_entry(resource_list[i]->waiters.link.prev, struct kds_link, link)->state & (KDS_LINK_EXCLUSIVE | KDS_LINK_TRIGGERED)) == KDS_LINK_TRIGGERED)))
-		{
-			link_state |= KDS_LINK_TRIGGERED;
-			rset->pending--;
-		}
-		rset->resources[i].state = link_state;
-
-		/* avoid double wait (hang) */
-		if (!list_empty(&resource_list[i]->waiters.link))
-		{
-			/* adding same rset again? */
-			if (list_entry(resource_list[i]->waiters.link.prev, struct kds_link, link)->parent == rset)
-			{
-				goto roll_back;
-			}
-		}
-		list_add_tail(&rset->resources[i].link, &resource_list[i]->waiters.link);
-	}
-
-	triggered = (rset->pending == 0);
-
 	/* set the pointer before the callback is called so it sees it */
+	prev_rset = *pprset;
 	*pprset = rset;
 
-	spin_unlock_irqrestore(&kds_lock, lflags);
+	triggered = kds_rset_add(rset, number_resources,
+			exclusive_access_bitmap, resource_list);
+	if (triggered < 0)
+	{
+		*pprset = prev_rset;
+		kds_rset_free(rset);
+		return triggered;
+	}
 
 	if (triggered)
 	{
@@ -255,18 +578,6 @@ int kds_async_waitall(
 	}
 
 	return 0;
-
-roll_back:
-	/* roll back */
-	while (i-- > 0)
-	{
-		list_del(&rset->resources[i].link);
-	}
-	err = -EINVAL;
-
-	spin_unlock_irqrestore(&kds_lock, lflags);
-	kfree(rset);
-	return err;
 }
 EXPORT_SYMBOL(kds_async_waitall);
 
@@ -290,75 +601,33 @@ struct kds_resource_set *kds_waitall(
 		unsigned long         jiffies_timeout)
 {
 	struct kds_resource_set *rset;
-	unsigned long lflags;
-	int i;
-	int triggered = 0;
-	DECLARE_WAIT_QUEUE_HEAD_ONSTACK(wake);
+	int triggered;
 
-	rset = kmalloc(sizeof(*rset) + number_resources * sizeof(struct kds_link), GFP_KERNEL);
+	rset = kds_rset_alloc(number_resources);
 	if (!rset)
 		return rset;
 
 	rset->num_resources = number_resources;
-	rset->pending = number_resources;
+	atomic_set(&rset->pending, number_resources);
 	init_waitqueue_head(&rset->wake);
 	INIT_LIST_HEAD(&rset->callback_link);
 	INIT_WORK(&rset->callback_work, kds_queued_callback);
 	atomic_set(&rset->cb_queued, 0);
 	kref_init(&rset->refcount);
 
-	spin_lock_irqsave(&kds_lock, lflags);
-
-	for (i = 0; i < number_resources; i++)
-	{
-		unsigned long link_state = 0;
-
-		if (test_bit(i, exclusive_access_bitmap))
-		{
-			link_state |= KDS_LINK_EXCLUSIVE;
-		}
-
-		if (list_empty(&resource_list[i]->waiters.link))
-		{
-			link_state |= KDS_LINK_TRIGGERED;
-			rset->pending--;
-		}
-		/* Adding a non-exclusive and the current tail is a triggered non-exclusive? */
-		else if (((link_state & KDS_LINK_EXCLUSIVE) == 0) &&
-				(((list_entry(resource_list[i]->waiters.link.prev, struct kds_link, link)->state & (KDS_LINK_EXCLUSIVE | KDS_LINK_TRIGGERED)) == KDS_LINK_TRIGGERED)))
-		{
-			link_state |= KDS_LINK_TRIGGERED;
-			rset->pending--;
-		}
-
-		INIT_LIST_HEAD(&rset->resources[i].link);
-		rset->resources[i].parent = rset;
-		rset->resources[i].state = link_state;
-
-		/* avoid double wait (hang) */
-		if (!list_empty(&resource_list[i]->waiters.link))
-		{
-			/* adding same rset again? */
-			if (list_entry(resource_list[i]->waiters.link.prev, struct kds_link, link)->parent == rset)
-			{
-				goto roll_back;
-			}
-		}
-
-		list_add_tail(&rset->resources[i].link, &resource_list[i]->waiters.link);
-	}
+	/* only called by a release once all resources were obtained */
+	rset->cb = &sync_cb;
+	rset->callback_parameter = &rset->wake;
+	rset->callback_extra_parameter = NULL;
 
-	if (rset->pending == 0)
-		triggered = 1;
-	else
+	triggered = kds_rset_add(rset, number_resources,
+			exclusive_access_bitmap, resource_list);
+	if (triggered < 0)
 	{
-		rset->cb = &sync_cb;
-		rset->callback_parameter = &rset->wake;
-		rset->callback_extra_parameter = NULL;
+		kds_rset_free(rset);
+		return ERR_PTR(triggered);
 	}
 
-	spin_unlock_irqrestore(&kds_lock, lflags);
-
 	if (!triggered)
 	{
 		long wait_res = 0;
@@ -368,7 +637,7 @@ struct kds_resource_set *kds_waitall(
 		if (timeout)
 		{
 			wait_res = wait_event_interruptible_timeout(rset->wake,
-					rset->pending == 0, timeout);
+					atomic_read(&rset->pending) == 0, timeout);
 		}
 
 		if ((wait_res == -ERESTARTSYS) || (wait_res == 0))
@@ -379,24 +648,13 @@ struct kds_resource_set *kds_waitall(
 		}
 	}
 	return rset;
-
-roll_back:
-	/* roll back */
-	while (i-- > 0)
-	{
-		list_del(&rset->resources[i].link);
-	}
-
-	spin_unlock_irqrestore(&kds_lock, lflags);
-	kfree(rset);
-	return ERR_PTR(-EINVAL);
 }
 EXPORT_SYMBOL(kds_waitall);
 
 static void trigger_new_rset_owner(struct kds_resource_set *rset,
 		struct list_head *triggered)
 {
-	if (0 == --rset->pending) {
+	if (atomic_dec_and_test(&rset->pending)) {
 		/* new owner now triggered, track for callback later */
 		kref_get(&rset->refcount);
 		list_add(&rset->callback_link, triggered);
@@ -410,13 +668,14 @@ static void __kds_resource_set_release_common(struct kds_resource_set *rset)
 	unsigned long lflags;
 	int i;
 
-	spin_lock_irqsave(&kds_lock, lflags);
-
 	for (i = 0; i < rset->num_resources; i++)
 	{
+		spinlock_t *lock = kds_resource_lock(rset->resource_list[i]);
 		struct kds_resource *resource;
 		struct kds_link *it = NULL;
 
+		spin_lock_irqsave(lock, lflags);
+
 		/* fetch the previous entry on the linked list */
 		it = list_entry(rset->resources[i].link.prev, struct kds_link, link);
 		/* unlink ourself */
@@ -424,7 +683,10 @@ static void __kds_resource_set_release_common(struct kds_resource_set *rset)
 
 		/* any waiters? */
 		if (list_empty(&it->link))
+		{
+			spin_unlock_irqrestore(lock, lflags);
 			continue;
+		}
 
 		/* were we the head of the list? (head if prev is a resource) */
 		if (it->parent != KDS_RESOURCE)
@@ -445,6 +707,10 @@ static void __kds_resource_set_release_common(struct kds_resource_set *rset)
 					if (it->state & KDS_LINK_EXCLUSIVE)
 						break;
 
+					/* a reader of the group already holding it */
+					if (it->state & KDS_LINK_TRIGGERED)
+						continue;
+
 					it->state |= KDS_LINK_TRIGGERED;
 					/* a parent to update? */
 					if (it->parent != KDS_RESOURCE)
@@ -453,6 +719,7 @@ static void __kds_resource_set_release_common(struct kds_resource_set *rset)
 								&triggered);
 				}
 			}
+			spin_unlock_irqrestore(lock, lflags);
 			continue;
 		}
 
@@ -487,9 +754,9 @@ static void __kds_resource_set_release_common(struct kds_resource_set *rset)
 				trigger_new_rset_owner(it->parent, &triggered);
 			}
 		}
-	}
 
-	spin_unlock_irqrestore(&kds_lock, lflags);
+		spin_unlock_irqrestore(lock, lflags);
+	}
 
 	while (!list_empty(&triggered))
 	{
@@ -554,6 +821,134 @@ void kds_resource_set_release_sync(struct kds_resource_set **pprset)
 }
 EXPORT_SYMBOL(kds_resource_set_release_sync);
 
+#ifdef CONFIG_DEBUG_FS
+
+static struct dentry *kds_debugfs_dir;
+
+static int kds_alloc_stats_show(struct seq_file *sfile, void *data)
+{
+	int i;
+
+	for (i = 0; i < KDS_RSET_NR_CACHES; i++)
+		seq_printf(sfile, "cached_%d: %ld\n", kds_rset_cache_size[i],
+				atomic_long_read(&kds_rset_stats.cached[i]));
+	seq_printf(sfile, "kmalloc: %ld\n",
+			atomic_long_read(&kds_rset_stats.kmalloced));
+	seq_printf(sfile, "failed: %ld\n",
+			atomic_long_read(&kds_rset_stats.failed));
+	seq_printf(sfile, "live: %ld\n",
+			atomic_long_read(&kds_rset_stats.live));
+
+	return 0;
+}
+
+static int kds_alloc_stats_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kds_alloc_stats_show, NULL);
+}
+
+static const struct file_operations kds_alloc_stats_fops = {
+	.open = kds_alloc_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int kds_contention_show(struct seq_file *sfile, void *data)
+{
+	seq_printf(sfile, "immediate: %ld\n",
+			atomic_long_read(&kds_contention_stats.immediate));
+	seq_printf(sfile, "batched: %ld\n",
+			atomic_long_read(&kds_contention_stats.batched));
+	seq_printf(sfile, "queued: %ld\n",
+			atomic_long_read(&kds_contention_stats.queued));
+	seq_printf(sfile, "bypass_refused: %ld\n",
+			atomic_long_read(&kds_contention_stats.bypass_refused));
+	seq_printf(sfile, "reader_bypass_limit: %u\n",
+			READ_ONCE(kds_reader_bypass_limit));
+
+	return 0;
+}
+
+static int kds_contention_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kds_contention_show, NULL);
+}
+
+static const struct file_operations kds_contention_fops = {
+	.open = kds_contention_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void kds_debugfs_init(void)
+{
+	kds_debugfs_dir = debugfs_create_dir("kds", NULL);
+	if (IS_ERR_OR_NULL(kds_debugfs_dir))
+	{
+		kds_debugfs_dir = NULL;
+		return;
+	}
+
+	debugfs_create_file("alloc_stats", S_IRUGO, kds_debugfs_dir, NULL,
+			&kds_alloc_stats_fops);
+	debugfs_create_file("contention", S_IRUGO, kds_debugfs_dir, NULL,
+			&kds_contention_fops);
+}
+
+static void kds_debugfs_term(void)
+{
+	debugfs_remove_recursive(kds_debugfs_dir);
+}
+
+#else /* CONFIG_DEBUG_FS */
+
+static inline void kds_debugfs_init(void)
+{
+}
+
+static inline void kds_debugfs_term(void)
+{
+}
+
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init kds_init(void)
+{
+	int i;
+
+	for (i = 0; i < KDS_NR_LOCKS; i++)
+	{
+		spin_lock_init(&kds_locks[i].lock);
+		lockdep_set_class(&kds_locks[i].lock, &kds_lock_keys[i]);
+	}
+
+	/* A missing cache only sends that size class to kmalloc */
+	for (i = 0; i < KDS_RSET_NR_CACHES; i++)
+		kds_rset_caches[i] = kmem_cache_create(kds_rset_cache_name[i],
+				kds_rset_size(kds_rset_cache_size[i]), 0,
+				SLAB_HWCACHE_ALIGN, NULL);
+
+	kds_debugfs_init();
+
+	return 0;
+}
+
+static void __exit kds_exit(void)
+{
+	int i;
+
+	kds_debugfs_term();
+
+	for (i = 0; i < KDS_RSET_NR_CACHES; i++)
+		kmem_cache_destroy(kds_rset_caches[i]);
+}
+
+/* After debugfs, before any resource can be waited on */
+subsys_initcall(kds_init);
+module_exit(kds_exit);
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("ARM Ltd.");
 MODULE_VERSION("1.0");
@@ -0,0 +1,259 @@
+/*
+ *
+ * (C) COPYRIGHT 2012-2015 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+/*
+ * Multi-threaded stress test for KDS.
+ *
+ * A number of threads repeatedly wait on random subsets of a shared pool of
+ * resources, each resource randomly requested shared or exclusive, using
+ * both the blocking and the asynchronous API. While a set is held, every
+ * thread checks that each of its exclusive resources has no other holder
+ * and that none of its shared resources has an exclusive holder. A deadlock
+ * shows up as a hung thread. The module fails to load if an error was seen.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/delay.h>
+#include <linux/jiffies.h>
+#include <linux/kds.h>
+
+#define KDS_TEST_MAX_SET 8
+
+static unsigned int kds_test_threads = 8;
+module_param(kds_test_threads, uint, 0444);
+MODULE_PARM_DESC(kds_test_threads, "Number of threads waiting on resources");
+
+static unsigned int kds_test_resources = 16;
+module_param(kds_test_resources, uint, 0444);
+MODULE_PARM_DESC(kds_test_resources, "Number of shared resources");
+
+static unsigned int kds_test_set_size = 4;
+module_param(kds_test_set_size, uint, 0444);
+MODULE_PARM_DESC(kds_test_set_size, "Largest number of resources in one set (1-8)");
+
+static unsigned int kds_test_duration_ms = 5000;
+module_param(kds_test_duration_ms, uint, 0444);
+MODULE_PARM_DESC(kds_test_duration_ms, "How long the test runs for");
+
+struct kds_test_resource
+{
+	struct kds_resource kds;
+	atomic_t exclusive;
+	atomic_t shared;
+};
+
+struct kds_test_thread
+{
+	struct task_struct *task;
+	struct completion done;
+	struct completion triggered;
+	unsigned long iterations;
+};
+
+static struct kds_test_resource *kds_test_res;
+static struct kds_callback kds_test_cb;
+static atomic_t kds_test_errors = ATOMIC_INIT(0);
+static unsigned long kds_test_end;
+
+static void kds_test_callback(void *callback_parameter, void *callback_extra_parameter)
+{
+	struct kds_test_thread *thread = callback_parameter;
+
+	complete(&thread->triggered);
+}
+
+static void kds_test_hold(struct kds_test_resource **res, int nr,
+		unsigned long *exclusive)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+	{
+		if (test_bit(i, exclusive))
+		{
+			if (atomic_inc_return(&res[i]->exclusive) != 1 ||
+					atomic_read(&res[i]->shared))
+				atomic_inc(&kds_test_errors);
+		}
+		else
+		{
+			atomic_inc(&res[i]->shared);
+			if (atomic_read(&res[i]->exclusive))
+				atomic_inc(&kds_test_errors);
+		}
+	}
+
+	if (prandom_u32() & 1)
+		udelay(prandom_u32() % 20);
+
+	for (i = 0; i < nr; i++)
+	{
+		if (test_bit(i, exclusive))
+			atomic_dec(&res[i]->exclusive);
+		else
+			atomic_dec(&res[i]->shared);
+	}
+}
+
+static int kds_test_thread_fn(void *data)
+{
+	struct kds_test_thread *thread = data;
+	struct kds_test_resource *res[KDS_TEST_MAX_SET];
+	struct kds_resource *resource_list[KDS_TEST_MAX_SET];
+	unsigned long exclusive[BITS_TO_LONGS(KDS_TEST_MAX_SET)];
+	unsigned int picked[KDS_TEST_MAX_SET];
+
+	while (time_before(jiffies, kds_test_end))
+	{
+		struct kds_resource_set *rset = NULL;
+		int nr = 1 + prandom_u32() % kds_test_set_size;
+		int i, j;
+
+		/* pick nr distinct resources */
+		for (i = 0; i < nr; i++)
+		{
+retry:
+			picked[i] = prandom_u32() % kds_test_resources;
+			for (j = 0; j < i; j++)
+				if (picked[j] == picked[i])
+					goto retry;
+
+			res[i] = &kds_test_res[picked[i]];
+			resource_list[i] = &res[i]->kds;
+		}
+		exclusive[0] = prandom_u32() & ((1ul << nr) - 1);
+
+		if (prandom_u32() & 1)
+		{
+			rset = kds_waitall(nr, exclusive, resource_list,
+					KDS_WAIT_BLOCKING);
+			if (IS_ERR_OR_NULL(rset))
+			{
+				atomic_inc(&kds_test_errors);
+				break;
+			}
+		}
+		else
+		{
+			reinit_completion(&thread->triggered);
+			if (kds_async_waitall(&rset, &kds_test_cb, thread, NULL,
+					nr, exclusive, resource_list))
+			{
+				atomic_inc(&kds_test_errors);
+				break;
+			}
+			wait_for_completion(&thread->triggered);
+		}
+
+		kds_test_hold(res, nr, exclusive);
+		kds_resource_set_release(&rset);
+
+		thread->iterations++;
+		cond_resched();
+	}
+
+	complete(&thread->done);
+	return 0;
+}
+
+static int __init kds_test_init(void)
+{
+	struct kds_test_thread *threads;
+	unsigned long iterations = 0;
+	unsigned int i;
+	int err;
+
+	if (!kds_test_threads || !kds_test_resources ||
+			!kds_test_set_size || kds_test_set_size > KDS_TEST_MAX_SET ||
+			kds_test_set_size > kds_test_resources)
+		return -EINVAL;
+
+	kds_test_res = kcalloc(kds_test_resources, sizeof(*kds_test_res),
+			GFP_KERNEL);
+	threads = kcalloc(kds_test_threads, sizeof(*threads), GFP_KERNEL);
+	if (!kds_test_res || !threads)
+	{
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	for (i = 0; i < kds_test_resources; i++)
+		kds_resource_init(&kds_test_res[i].kds);
+
+	err = kds_callback_init(&kds_test_cb, 1, kds_test_callback);
+	if (err)
+		goto out_free;
+
+	kds_test_end = jiffies + msecs_to_jiffies(kds_test_duration_ms);
+
+	for (i = 0; i < kds_test_threads; i++)
+	{
+		init_completion(&threads[i].done);
+		init_completion(&threads[i].triggered);
+		threads[i].task = kthread_run(kds_test_thread_fn, &threads[i],
+				"kds_test/%u", i);
+		if (IS_ERR(threads[i].task))
+		{
+			/* let the others finish on their own */
+			atomic_inc(&kds_test_errors);
+			complete(&threads[i].done);
+		}
+	}
+
+	for (i = 0; i < kds_test_threads; i++)
+	{
+		wait_for_completion(&threads[i].done);
+		iterations += threads[i].iterations;
+	}
+
+	kds_callback_term(&kds_test_cb);
+
+	for (i = 0; i < kds_test_resources; i++)
+	{
+		if (kds_resource_term(&kds_test_res[i].kds))
+			atomic_inc(&kds_test_errors);
+	}
+
+	pr_info("kds_test: %lu resource sets over %u threads, %d errors\n",
+			iterations, kds_test_threads,
+			atomic_read(&kds_test_errors));
+
+	err = atomic_read(&kds_test_errors) ? -EINVAL : 0;
+
+out_free:
+	kfree(threads);
+	if (err)
+		kfree(kds_test_res);
+	return err;
+}
+
+static void __exit kds_test_exit(void)
+{
+	kfree(kds_test_res);
+}
+
+module_init(kds_test_init);
+module_exit(kds_test_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("ARM Ltd.");
+MODULE_VERSION("1.0");
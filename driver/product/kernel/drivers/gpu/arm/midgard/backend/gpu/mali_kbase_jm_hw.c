@@ -69,6 +69,8 @@ void kbase_job_hw_submit(struct kbase_device *kbdev,
 	KBASE_DEBUG_ASSERT(!kbase_js_affinity_would_violate(kbdev, js,
 							katom->affinity));
 
+	kbase_latency_atom_stage(katom, KBASE_LATENCY_HW_START);
+
 	kbase_reg_write(kbdev, JOB_SLOT_REG(js, JS_HEAD_NEXT_LO),
 						jc_head & 0xFFFFFFFF, kctx);
 	kbase_reg_write(kbdev, JOB_SLOT_REG(js, JS_HEAD_NEXT_HI),
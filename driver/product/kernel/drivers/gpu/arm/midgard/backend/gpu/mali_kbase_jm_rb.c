@@ -625,6 +625,9 @@ static void kbase_gpu_release_atom(struct kbase_device *kbdev,
 {
 	struct kbase_context *kctx = katom->kctx;
 
+	if (unlikely(kbdev->hwcnt_job_sample))
+		kbase_vinstr_job_sample_remove(kbdev->vinstr_ctx, katom);
+
 	switch (katom->gpu_rb_state) {
 	case KBASE_ATOM_GPU_RB_NOT_IN_SLOT_RB:
 		/* Should be impossible */
@@ -759,6 +762,31 @@ static inline bool other_slots_busy(struct kbase_device *kbdev, int js)
 	return false;
 }
 
+/**
+ * kbase_gpu_job_sample_blocked - Determine if job sampling prevents an atom
+ *                                from being submitted
+ * @kbdev: Device pointer
+ * @js:    Job slot
+ * @idx:   Index of the atom in the slot ringbuffer
+ * @katom: Atom about to be submitted
+ *
+ * Atoms flagged with BASE_JD_REQ_HWCNT_SAMPLE are only submitted to an idle
+ * GPU. Once one reaches the head of its slot, no other atom is submitted
+ * until the other slots have drained and it has been sampled.
+ *
+ * Return: true if @katom must not be submitted yet, false otherwise
+ */
+static bool kbase_gpu_job_sample_blocked(struct kbase_device *kbdev, int js,
+		int idx, struct kbase_jd_atom *katom)
+{
+	/* Wait for the atom ahead in the slot before draining the GPU */
+	if ((katom->core_req & BASE_JD_REQ_HWCNT_SAMPLE) && idx == 1)
+		return true;
+
+	return !kbase_vinstr_job_sample_submit(kbdev->vinstr_ctx, katom,
+			idx == 0 && !other_slots_busy(kbdev, js));
+}
+
 static inline bool kbase_gpu_in_protected_mode(struct kbase_device *kbdev)
 {
 	return kbdev->protected_mode;
@@ -1195,6 +1223,13 @@ void kbase_backend_slot_update(struct kbase_device *kbdev)
 						kbase_reset_gpu_active(kbdev))
 					break;
 
+				/* If job sampling in use then atoms flagged for
+				 * sampling run alone on the GPU */
+				if (unlikely(kbdev->hwcnt_job_sample) &&
+						kbase_gpu_job_sample_blocked(
+						kbdev, js, idx, katom[idx]))
+					break;
+
 				/* Check if this job needs the cycle counter
 				 * enabled before submission */
 				if (katom[idx]->core_req & BASE_JD_REQ_PERMON)
@@ -1297,6 +1332,8 @@ void kbase_gpu_complete_hw(struct kbase_device *kbdev, int js,
 
 	lockdep_assert_held(&kbdev->hwaccess_lock);
 
+	kbase_latency_atom_stage(katom, KBASE_LATENCY_HW_DURATION);
+
 	if ((kbase_hw_has_issue(kbdev, BASE_HW_ISSUE_6787) || (katom->core_req &
 					BASE_JD_REQ_SKIP_CACHE_END)) &&
 			completion_code != BASE_JD_EVENT_DONE &&
@@ -47,6 +47,8 @@ static int kbase_ipa_internal_models_append_list(struct kbase_device *kbdev)
 	if (err)
 		return err;
 
+	err = kbase_ipa_model_ops_register(kbdev, &kbase_counter_ipa_model_ops);
+
 	return err;
 }
 
@@ -176,7 +178,8 @@ void kbase_ipa_model_term(struct kbase_device *kbdev)
 		/* Always terminate the default model,
 		 * unless it was the configured model */
 		if (model != kbdev->ipa_fallback_model)
-			kbdev->ipa_fallback_model->ops->term(model);
+			kbdev->ipa_fallback_model->ops->term(
+					kbdev->ipa_fallback_model);
 	}
 	/* Clean up the list */
 	if (!list_empty(&kbdev->ipa_power_models)) {
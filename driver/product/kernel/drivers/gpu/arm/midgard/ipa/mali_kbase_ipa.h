@@ -57,6 +57,7 @@ void kbase_ipa_model_use_fallback_locked(struct kbase_device *kbdev);
 void kbase_ipa_model_use_configured_locked(struct kbase_device *kbdev);
 
 extern struct kbase_ipa_model_ops kbase_generic_ipa_model_ops;
+extern struct kbase_ipa_model_ops kbase_counter_ipa_model_ops;
 
 /**
  * kbase_ipa_dynamic_power - calculate power
@@ -0,0 +1,640 @@
+/*
+ *
+ * (C) COPYRIGHT 2016 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+#include <linux/of.h>
+#include <linux/sysfs.h>
+
+#include "mali_kbase.h"
+#include "mali_kbase_defs.h"
+
+/*
+ * This model derives the dynamic power coefficient from hardware counters
+ * sampled through a kernel side vinstr client. Each selected counter has a
+ * weight giving the energy of one counted event; the weighted sum over a
+ * sampling period is divided by the number of cycles the GPU was active in
+ * that period. The devfreq cooling framework then scales the coefficient by
+ * the current OPP and the GPU utilisation, so the estimate follows the work
+ * actually being done rather than a single worst case coefficient.
+ *
+ * The counters are dumped from a delayed work, so devfreq only ever reads
+ * the last computed coefficient and never waits on a dump. The vinstr client
+ * is only attached while devfreq keeps asking for the dynamic power.
+ *
+ * Static power is delegated to the fallback (generic) model, which is always
+ * initialized by the IPA framework.
+ */
+
+/* Maximum number of counters that can be selected by the model */
+#define KBASE_IPA_COUNTER_MAX            32
+
+/* Weights are bounded so that the weighted sum cannot overflow 64 bits */
+#define KBASE_IPA_COUNTER_WEIGHT_MAX     (1 << 20)
+
+/* Coefficient is bounded to the range accepted by kbase_scale_power() */
+#define KBASE_IPA_COUNTER_COEFF_MAX      ((1ul << 16) - 1)
+
+/* Default minimum time between two counter samples */
+#define KBASE_IPA_COUNTER_SAMPLE_MS      100
+
+/* Sampling stops, and the vinstr client is detached, once the dynamic power
+ * has not been asked for during this many sampling periods */
+#define KBASE_IPA_COUNTER_IDLE_SAMPLES   4
+
+/* Layout of the hardware counter dump */
+#define NR_CNT_BLOCKS_PER_GROUP          8
+#define NR_CNT_PER_BLOCK                 64
+#define NR_CNT_PER_BITMAP_BIT            4
+
+/* Index of the GPU_ACTIVE counter in the job manager block */
+#define JM_GPU_ACTIVE                    6
+
+/* Counter block types, as used in the devicetree "counters" property */
+enum kbase_ipa_counter_block {
+	KBASE_IPA_BLOCK_JM,
+	KBASE_IPA_BLOCK_TILER,
+	KBASE_IPA_BLOCK_MMU_L2,
+	KBASE_IPA_BLOCK_SHADER,
+
+	KBASE_IPA_BLOCK_COUNT
+};
+
+/**
+ * struct kbase_ipa_counter - counter selected by the model
+ * @block:  type of counter block, see enum kbase_ipa_counter_block
+ * @index:  index of the counter within the block
+ * @weight: energy of one counted event, in fJ/V^2
+ */
+struct kbase_ipa_counter {
+	u32 block;
+	u32 index;
+	s32 weight;
+};
+
+/**
+ * struct kbase_ipa_model_counter_data - counter model context per device
+ * @model:              IPA model this data belongs to
+ * @setup:              counters enabled for the vinstr client
+ * @vinstr_cli:         vinstr kernel client used to sample the counters, only
+ *                      attached while sampling; owned by @sample_work
+ * @dump_buffer:        buffer the vinstr client dumps into
+ * @sample_work:        dumps the counters every sampling period
+ * @counters:           counters selected by the model, with their weights
+ * @nr_counters:        number of valid entries in @counters
+ * @sample_interval_ms: minimum time between two counter samples
+ * @last_request:       time the dynamic power was last asked for, in jiffies
+ * @sampling:           true while @sample_work is queued or running
+ * @coefficient:        last computed dynamic coefficient, in pW/(Hz V^2)
+ * @coefficient_valid:  true once @coefficient holds a sampled value
+ * @lock:               protects the counter model context, except for the
+ *                      vinstr client and its dump buffer
+ */
+struct kbase_ipa_model_counter_data {
+	struct kbase_ipa_model *model;
+	struct kbase_uk_hwcnt_reader_setup setup;
+	struct kbase_vinstr_client *vinstr_cli;
+	u32 *dump_buffer;
+	struct delayed_work sample_work;
+	struct kbase_ipa_counter counters[KBASE_IPA_COUNTER_MAX];
+	u32 nr_counters;
+	u32 sample_interval_ms;
+	unsigned long last_request;
+	bool sampling;
+	unsigned long coefficient;
+	bool coefficient_valid;
+	struct mutex lock;
+};
+
+/**
+ * kbase_ipa_counter_sum - sum a counter over all instances of its block type
+ * @model_data: counter model context
+ * @block:      type of counter block
+ * @index:      index of the counter within the block
+ *
+ * Return: the sum of the counter in the last dump
+ */
+static u64 kbase_ipa_counter_sum(
+		struct kbase_ipa_model_counter_data *model_data,
+		u32 block, u32 index)
+{
+	struct kbase_device *kbdev = model_data->model->kbdev;
+	const u32 *buf = model_data->dump_buffer;
+	u64 sum = 0;
+	int v4 = 0;
+
+#ifndef CONFIG_MALI_NO_MALI
+	v4 = kbase_hw_has_feature(kbdev, BASE_HW_FEATURE_V4);
+#endif
+
+	if (v4) {
+		u32 nr_cg = kbdev->gpu_props.num_core_groups;
+		u32 cg, sc;
+
+		for (cg = 0; cg < nr_cg; cg++) {
+			const u32 *group = &buf[cg * NR_CNT_BLOCKS_PER_GROUP *
+					NR_CNT_PER_BLOCK];
+
+			switch (block) {
+			case KBASE_IPA_BLOCK_JM:
+				sum += group[7 * NR_CNT_PER_BLOCK + index];
+				break;
+			case KBASE_IPA_BLOCK_TILER:
+				sum += group[4 * NR_CNT_PER_BLOCK + index];
+				break;
+			case KBASE_IPA_BLOCK_MMU_L2:
+				sum += group[5 * NR_CNT_PER_BLOCK + index];
+				break;
+			case KBASE_IPA_BLOCK_SHADER:
+				for (sc = 0; sc < 4; sc++)
+					sum += group[sc * NR_CNT_PER_BLOCK +
+							index];
+				break;
+			}
+		}
+	} else {
+		u32 nr_l2 = kbdev->gpu_props.props.l2_props.num_l2_slices;
+		u64 core_mask =
+			kbdev->gpu_props.props.coherency_info.group[0].core_mask;
+		const u32 *blk;
+		u32 i;
+
+		switch (block) {
+		case KBASE_IPA_BLOCK_JM:
+			sum = buf[index];
+			break;
+		case KBASE_IPA_BLOCK_TILER:
+			sum = buf[NR_CNT_PER_BLOCK + index];
+			break;
+		case KBASE_IPA_BLOCK_MMU_L2:
+			for (i = 0; i < nr_l2; i++)
+				sum += buf[(2 + i) * NR_CNT_PER_BLOCK + index];
+			break;
+		case KBASE_IPA_BLOCK_SHADER:
+			blk = &buf[(2 + nr_l2) * NR_CNT_PER_BLOCK];
+			for (; core_mask; core_mask >>= 1) {
+				if (core_mask & 1ull)
+					sum += blk[index];
+				blk += NR_CNT_PER_BLOCK;
+			}
+			break;
+		}
+	}
+
+	return sum;
+}
+
+/**
+ * kbase_ipa_counter_update_locked - update the dynamic coefficient from the
+ *                                   last counter dump
+ * @model_data: counter model context
+ *
+ * The previous coefficient is kept if the GPU was idle for the whole
+ * sampling period.
+ */
+static void kbase_ipa_counter_update_locked(
+		struct kbase_ipa_model_counter_data *model_data)
+{
+	u64 active_cycles;
+	s64 energy = 0;
+	u32 i;
+
+	lockdep_assert_held(&model_data->lock);
+
+	active_cycles = kbase_ipa_counter_sum(model_data, KBASE_IPA_BLOCK_JM,
+			JM_GPU_ACTIVE);
+	if (!active_cycles)
+		return;
+
+	for (i = 0; i < model_data->nr_counters; i++) {
+		const struct kbase_ipa_counter *cnt = &model_data->counters[i];
+
+		energy += (s64)kbase_ipa_counter_sum(model_data, cnt->block,
+				cnt->index) * cnt->weight;
+	}
+
+	/* Weights are in fJ/V^2, the coefficient is in pJ/V^2 per cycle */
+	if (energy <= 0)
+		model_data->coefficient = 0;
+	else
+		model_data->coefficient = min_t(u64,
+				div64_u64(energy, active_cycles * 1000),
+				KBASE_IPA_COUNTER_COEFF_MAX);
+	model_data->coefficient_valid = true;
+}
+
+/**
+ * kbase_ipa_counter_sample_worker - periodic counter sampling
+ * @work: the sample_work of a counter model context
+ *
+ * Attaches the vinstr client on the first run, then dumps the counters once
+ * per sampling period. The previous coefficient is kept if the counters
+ * could not be dumped, for instance while vinstr is suspended. Once the
+ * dynamic power has not been asked for in a while, because devfreq stopped
+ * polling or the fallback model is in use, the client is detached so that
+ * the counters do not stay enabled.
+ */
+static void kbase_ipa_counter_sample_worker(struct work_struct *work)
+{
+	struct kbase_ipa_model_counter_data *model_data = container_of(work,
+			struct kbase_ipa_model_counter_data, sample_work.work);
+	struct kbase_device *kbdev = model_data->model->kbdev;
+	unsigned long interval;
+	bool idle;
+
+	mutex_lock(&model_data->lock);
+	interval = max_t(unsigned long, 1,
+			msecs_to_jiffies(model_data->sample_interval_ms));
+	idle = time_after(jiffies, model_data->last_request +
+			KBASE_IPA_COUNTER_IDLE_SAMPLES * interval);
+	if (idle)
+		model_data->sampling = false;
+	mutex_unlock(&model_data->lock);
+
+	if (idle) {
+		if (model_data->vinstr_cli) {
+			kbase_vinstr_detach_client(model_data->vinstr_cli);
+			model_data->vinstr_cli = NULL;
+		}
+		return;
+	}
+
+	if (!model_data->vinstr_cli) {
+		model_data->vinstr_cli = kbase_vinstr_hwcnt_kernel_setup(
+				kbdev->vinstr_ctx, &model_data->setup,
+				model_data->dump_buffer);
+		if (!model_data->vinstr_cli)
+			dev_warn_ratelimited(kbdev->dev, "Failed to register IPA with vinstr core\n");
+	} else if (!kbase_vinstr_hwc_dump(model_data->vinstr_cli,
+			BASE_HWCNT_READER_EVENT_MANUAL)) {
+		mutex_lock(&model_data->lock);
+		kbase_ipa_counter_update_locked(model_data);
+		mutex_unlock(&model_data->lock);
+	}
+
+	queue_delayed_work(system_wq, &model_data->sample_work, interval);
+}
+
+static unsigned long model_dynamic_power(struct kbase_ipa_model *model)
+{
+	struct kbase_ipa_model_counter_data *model_data =
+		(struct kbase_ipa_model_counter_data *) model->model_data;
+	struct kbase_ipa_model *fallback = model->kbdev->ipa_fallback_model;
+	unsigned long coefficient;
+	bool valid;
+
+	mutex_lock(&model_data->lock);
+	model_data->last_request = jiffies;
+	if (!model_data->sampling) {
+		model_data->sampling = true;
+		queue_delayed_work(system_wq, &model_data->sample_work, 0);
+	}
+	coefficient = model_data->coefficient;
+	valid = model_data->coefficient_valid;
+	mutex_unlock(&model_data->lock);
+
+	if (!valid && fallback)
+		return fallback->ops->get_dynamic_power(fallback);
+
+	return coefficient;
+}
+
+static unsigned long model_static_power(struct kbase_ipa_model *model,
+		unsigned long voltage)
+{
+	struct kbase_ipa_model *fallback = model->kbdev->ipa_fallback_model;
+
+	if (!fallback)
+		return 0;
+
+	return fallback->ops->get_static_power(fallback, voltage);
+}
+
+/**
+ * kbase_ipa_counter_add - add a counter to the model
+ * @model_data: counter model context
+ * @block:      type of counter block
+ * @index:      index of the counter within the block
+ * @weight:     energy of one counted event, in fJ/V^2
+ *
+ * Return: 0 on success, or -EINVAL if the counter is not valid
+ */
+static int kbase_ipa_counter_add(
+		struct kbase_ipa_model_counter_data *model_data,
+		u32 block, u32 index, s32 weight)
+{
+	struct kbase_ipa_counter *cnt;
+
+	if (model_data->nr_counters >= KBASE_IPA_COUNTER_MAX ||
+			block >= KBASE_IPA_BLOCK_COUNT ||
+			index >= NR_CNT_PER_BLOCK ||
+			weight > KBASE_IPA_COUNTER_WEIGHT_MAX ||
+			weight < -KBASE_IPA_COUNTER_WEIGHT_MAX)
+		return -EINVAL;
+
+	cnt = &model_data->counters[model_data->nr_counters++];
+	cnt->block = block;
+	cnt->index = index;
+	cnt->weight = weight;
+
+	return 0;
+}
+
+static int kbase_ipa_counter_read_dt(struct kbase_device *kbdev,
+		struct kbase_ipa_model_counter_data *model_data)
+{
+	struct device_node *node;
+	struct property *prop;
+	u32 values[KBASE_IPA_COUNTER_MAX * 3];
+	u32 nr_values, i;
+	int err;
+
+	node = of_get_child_by_name(kbdev->dev->of_node,
+			"counter_power_model");
+	if (!node) {
+		dev_err(kbdev->dev, "could not find counter_power_model node\n");
+		return -ENODEV;
+	}
+	if (!of_device_is_compatible(node, "arm,mali-counter-power-model")) {
+		dev_err(kbdev->dev, "counter_power_model incompatible with counter power model\n");
+		err = -ENODEV;
+		goto out;
+	}
+
+	prop = of_find_property(node, "counters", NULL);
+	if (!prop || !prop->length ||
+			prop->length % (3 * sizeof(u32)) ||
+			prop->length > sizeof(values)) {
+		dev_err(kbdev->dev, "counters in counter_power_model not valid\n");
+		err = -EINVAL;
+		goto out;
+	}
+	nr_values = prop->length / sizeof(u32);
+
+	err = of_property_read_u32_array(node, "counters", values, nr_values);
+	if (err) {
+		dev_err(kbdev->dev, "counters in counter_power_model not available\n");
+		goto out;
+	}
+
+	for (i = 0; i < nr_values; i += 3) {
+		err = kbase_ipa_counter_add(model_data, values[i],
+				values[i + 1], (s32)values[i + 2]);
+		if (err) {
+			dev_err(kbdev->dev, "counter %u in counter_power_model not valid\n",
+					i / 3);
+			goto out;
+		}
+	}
+
+	if (of_property_read_u32(node, "sample-interval-ms",
+			&model_data->sample_interval_ms))
+		model_data->sample_interval_ms = KBASE_IPA_COUNTER_SAMPLE_MS;
+
+out:
+	of_node_put(node);
+	return err;
+}
+
+static struct kbase_ipa_model_counter_data *kbase_ipa_counter_data_from_dev(
+		struct device *dev)
+{
+	struct kbase_device *kbdev = dev_get_drvdata(dev);
+
+	if (!kbdev || !kbdev->ipa_configured_model ||
+			kbdev->ipa_configured_model->ops !=
+					&kbase_counter_ipa_model_ops)
+		return NULL;
+
+	return kbdev->ipa_configured_model->model_data;
+}
+
+static ssize_t show_counters(struct device *dev,
+		struct device_attribute *attr, char * const buf)
+{
+	struct kbase_ipa_model_counter_data *model_data;
+	ssize_t ret = 0;
+	u32 i;
+
+	model_data = kbase_ipa_counter_data_from_dev(dev);
+	if (!model_data)
+		return -ENODEV;
+
+	mutex_lock(&model_data->lock);
+	for (i = 0; i < model_data->nr_counters; i++)
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "%u %u %d\n",
+				model_data->counters[i].block,
+				model_data->counters[i].index,
+				model_data->counters[i].weight);
+	mutex_unlock(&model_data->lock);
+
+	return ret;
+}
+
+/*
+ * Writing "<block> <index> <weight>" updates the weight of a counter already
+ * selected by the model. New counters cannot be added at runtime as the
+ * vinstr client's counter set is fixed when the model is initialized.
+ */
+static ssize_t set_counters(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kbase_ipa_model_counter_data *model_data;
+	u32 block, index, i;
+	s32 weight;
+	int err = -EINVAL;
+
+	model_data = kbase_ipa_counter_data_from_dev(dev);
+	if (!model_data)
+		return -ENODEV;
+
+	if (sscanf(buf, "%u %u %d", &block, &index, &weight) != 3)
+		return -EINVAL;
+
+	if (weight > KBASE_IPA_COUNTER_WEIGHT_MAX ||
+			weight < -KBASE_IPA_COUNTER_WEIGHT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&model_data->lock);
+	for (i = 0; i < model_data->nr_counters; i++) {
+		if (model_data->counters[i].block == block &&
+				model_data->counters[i].index == index) {
+			model_data->counters[i].weight = weight;
+			err = 0;
+			break;
+		}
+	}
+	mutex_unlock(&model_data->lock);
+
+	if (err)
+		return err;
+
+	return count;
+}
+
+static DEVICE_ATTR(counters, S_IRUGO | S_IWUSR, show_counters, set_counters);
+
+static ssize_t show_sample_interval_ms(struct device *dev,
+		struct device_attribute *attr, char * const buf)
+{
+	struct kbase_ipa_model_counter_data *model_data;
+
+	model_data = kbase_ipa_counter_data_from_dev(dev);
+	if (!model_data)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			model_data->sample_interval_ms);
+}
+
+static ssize_t set_sample_interval_ms(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kbase_ipa_model_counter_data *model_data;
+	unsigned int interval;
+	int err;
+
+	model_data = kbase_ipa_counter_data_from_dev(dev);
+	if (!model_data)
+		return -ENODEV;
+
+	err = kstrtouint(buf, 0, &interval);
+	if (err)
+		return err;
+
+	mutex_lock(&model_data->lock);
+	model_data->sample_interval_ms = interval;
+	mutex_unlock(&model_data->lock);
+
+	return count;
+}
+
+static DEVICE_ATTR(sample_interval_ms, S_IRUGO | S_IWUSR,
+		show_sample_interval_ms, set_sample_interval_ms);
+
+static struct attribute *kbase_ipa_counter_attrs[] = {
+	&dev_attr_counters.attr,
+	&dev_attr_sample_interval_ms.attr,
+	NULL
+};
+
+static const struct attribute_group kbase_ipa_counter_attr_group = {
+	.name = "ipa_counter_model",
+	.attrs = kbase_ipa_counter_attrs,
+};
+
+static int kbase_counter_power_model_init(struct kbase_ipa_model *model)
+{
+	struct kbase_device *kbdev = model->kbdev;
+	struct kbase_ipa_model_counter_data *model_data;
+	struct kbase_uk_hwcnt_reader_setup *setup;
+	u32 *bm, i;
+	int err;
+
+	model_data = kzalloc(sizeof(struct kbase_ipa_model_counter_data),
+			    GFP_KERNEL);
+	if (!model_data)
+		return -ENOMEM;
+
+	model_data->model = model;
+	mutex_init(&model_data->lock);
+	INIT_DELAYED_WORK(&model_data->sample_work,
+			kbase_ipa_counter_sample_worker);
+	setup = &model_data->setup;
+
+	err = kbase_ipa_counter_read_dt(kbdev, model_data);
+	if (err)
+		goto error;
+
+	/* Each bit of the enable bitmaps covers a group of four counters.
+	 * GPU_ACTIVE is always needed to normalize the energy. */
+	setup->jm_bm = 1u << (JM_GPU_ACTIVE / NR_CNT_PER_BITMAP_BIT);
+	for (i = 0; i < model_data->nr_counters; i++) {
+		switch (model_data->counters[i].block) {
+		case KBASE_IPA_BLOCK_JM:
+			bm = &setup->jm_bm;
+			break;
+		case KBASE_IPA_BLOCK_TILER:
+			bm = &setup->tiler_bm;
+			break;
+		case KBASE_IPA_BLOCK_MMU_L2:
+			bm = &setup->mmu_l2_bm;
+			break;
+		default:
+			bm = &setup->shader_bm;
+			break;
+		}
+		*bm |= 1u << (model_data->counters[i].index /
+				NR_CNT_PER_BITMAP_BIT);
+	}
+
+	model_data->dump_buffer = kzalloc(kbase_vinstr_dump_size(kbdev),
+			GFP_KERNEL);
+	if (!model_data->dump_buffer) {
+		err = -ENOMEM;
+		goto error;
+	}
+
+	/* The vinstr client is attached by the sample worker once devfreq
+	 * starts asking for the dynamic power. */
+
+	model->model_data = (void *) model_data;
+
+	err = sysfs_create_group(&kbdev->dev->kobj,
+			&kbase_ipa_counter_attr_group);
+	if (err) {
+		dev_warn(kbdev->dev, "Failed to create IPA counter model sysfs group\n");
+		err = 0;
+	}
+
+	return 0;
+error:
+	kfree(model_data->dump_buffer);
+	kfree(model_data);
+	return err;
+}
+
+static void kbase_counter_power_model_term(struct kbase_ipa_model *model)
+{
+	struct kbase_ipa_model_counter_data *model_data =
+			(struct kbase_ipa_model_counter_data *)model->model_data;
+
+	if (!model_data)
+		return;
+
+	sysfs_remove_group(&model->kbdev->dev->kobj,
+			&kbase_ipa_counter_attr_group);
+
+	/* Stop model_dynamic_power() from queuing the worker again */
+	mutex_lock(&model_data->lock);
+	model_data->sampling = true;
+	mutex_unlock(&model_data->lock);
+	cancel_delayed_work_sync(&model_data->sample_work);
+
+	if (model_data->vinstr_cli)
+		kbase_vinstr_detach_client(model_data->vinstr_cli);
+	kfree(model_data->dump_buffer);
+	kfree(model_data);
+	model->model_data = NULL;
+}
+
+struct kbase_ipa_model_ops kbase_counter_ipa_model_ops = {
+		.name = "counter_ipa_model",
+		.init = &kbase_counter_power_model_init,
+		.term = &kbase_counter_power_model_term,
+		.get_dynamic_power = &model_dynamic_power,
+		.get_static_power = &model_static_power,
+		.power_to_state = NULL
+};
@@ -421,6 +421,17 @@ struct base_jit_alloc_info {
 	u8 id;
 };
 
+/**
+ * struct base_jd_timeline_point - A point on a software timeline
+ * @timeline:                      GPU virtual address of the 64-bit timeline
+ *                                 value, must be 8 byte aligned.
+ * @value:                         The point on the timeline.
+ */
+struct base_jd_timeline_point {
+	u64 timeline;
+	u64 value;
+};
+
 /**
  * @brief Job dependency type.
  *
@@ -624,6 +635,22 @@ typedef u32 base_jd_core_req;
  */
 #define BASE_JD_REQ_SOFT_EXT_RES_UNMAP          (BASE_JD_REQ_SOFT_JOB | 0xc)
 
+/**
+ * SW only requirement: timeline wait/signal job.
+ *
+ * A timeline is a 64-bit value in GPU memory which only ever increases. The
+ * jc element of the atom is a pointer to a @base_jd_timeline_point giving the
+ * GPU address of the timeline and a point on it.
+ *
+ * - BASE_JD_REQ_SOFT_TIMELINE_WAIT: this job will block until the timeline
+ *   has reached the point.
+ * - BASE_JD_REQ_SOFT_TIMELINE_SIGNAL: this job advances the timeline to the
+ *   point, unless it is already past it, and unblocks the jobs waiting for
+ *   any point up to it. It completes immediately.
+ */
+#define BASE_JD_REQ_SOFT_TIMELINE_WAIT          (BASE_JD_REQ_SOFT_JOB | 0xd)
+#define BASE_JD_REQ_SOFT_TIMELINE_SIGNAL        (BASE_JD_REQ_SOFT_JOB | 0xe)
+
 /**
  * HW Requirement: Requires Compute shaders (but not Vertex or Geometry Shaders)
  *
@@ -681,6 +708,30 @@ typedef u32 base_jd_core_req;
  */
 #define BASE_JD_REQ_SKIP_CACHE_END ((base_jd_core_req)1 << 16)
 
+/**
+ * SW Flag: Sample hardware counters at the start and end of this atom.
+ *
+ * If this bit is set and job sampling has been enabled through the
+ * hwcnt_job_sample debugfs file then the atom is run alone on the GPU and
+ * the counters selected through hwcnt_job_sample_counters, counted while it
+ * ran, are emitted in the auxiliary timeline stream. Otherwise this bit is
+ * ignored.
+ */
+#define BASE_JD_REQ_HWCNT_SAMPLE ((base_jd_core_req)1 << 17)
+
+/**
+ * SW Flag: Export the completion of this atom as a sync fence.
+ *
+ * Only valid on atoms which are not soft jobs. The atom's extres_list must
+ * hold one more entry after its nr_extres external resources, a struct
+ * base_fence in place of a base_external_resource, set up as for
+ * BASE_JD_REQ_SOFT_FENCE_TRIGGER: basep.stream_fd names the timeline and
+ * basep.fd receives the new fence. The fence is signalled when the atom
+ * completes, with an error if the atom failed, so no separate fence trigger
+ * soft job is needed.
+ */
+#define BASE_JD_REQ_FENCE_EXPORT ((base_jd_core_req)1 << 18)
+
 /**
  * These requirement bits are currently unused in base_jd_core_req
  */
@@ -690,7 +741,8 @@ typedef u32 base_jd_core_req;
 	BASE_JD_REQ_EVENT_COALESCE | \
 	BASE_JD_REQ_COHERENT_GROUP | BASE_JD_REQ_SPECIFIC_COHERENT_GROUP | \
 	BASE_JD_REQ_FS_AFBC | BASE_JD_REQ_PERMON | \
-	BASE_JD_REQ_SKIP_CACHE_START | BASE_JD_REQ_SKIP_CACHE_END))
+	BASE_JD_REQ_SKIP_CACHE_START | BASE_JD_REQ_SKIP_CACHE_END | \
+	BASE_JD_REQ_HWCNT_SAMPLE | BASE_JD_REQ_FENCE_EXPORT))
 
 /**
  * Mask of all bits in base_jd_core_req that control the type of the atom.
@@ -1826,7 +1878,65 @@ typedef struct base_profiling_controls {
  * to account for the performance impact. */
 #define BASE_TLSTREAM_JOB_DUMPING_ENABLED (1 << 1)
 
+/* Classes of timeline events to emit. If none of these bits is set, all
+ * classes are emitted. Latency tracepoints belonging to a class are only
+ * emitted if BASE_TLSTREAM_ENABLE_LATENCY_TRACEPOINTS is also set. */
+#define BASE_TLSTREAM_CLASS_SHIFT 8
+/* Creation and destruction of contexts and atoms */
+#define BASE_TLSTREAM_CLASS_OBJ    (1 << 8)
+/* Retention and release of objects by other objects (e.g. atoms by LPUs) */
+#define BASE_TLSTREAM_CLASS_RET    (1 << 9)
+/* Dependencies between atoms */
+#define BASE_TLSTREAM_CLASS_DEP    (1 << 10)
+/* Configuration attributes of atoms and address spaces */
+#define BASE_TLSTREAM_CLASS_ATTRIB (1 << 11)
+/* Atom state and priority changes */
+#define BASE_TLSTREAM_CLASS_STATE  (1 << 12)
+/* Soft-stop and GPU reset events */
+#define BASE_TLSTREAM_CLASS_EVENT  (1 << 13)
+/* Auxiliary stream events */
+#define BASE_TLSTREAM_CLASS_AUX    (1 << 14)
+
+#define BASE_TLSTREAM_CLASS_MASK (BASE_TLSTREAM_CLASS_OBJ | \
+		BASE_TLSTREAM_CLASS_RET | BASE_TLSTREAM_CLASS_DEP | \
+		BASE_TLSTREAM_CLASS_ATTRIB | BASE_TLSTREAM_CLASS_STATE | \
+		BASE_TLSTREAM_CLASS_EVENT | BASE_TLSTREAM_CLASS_AUX)
+
 #define BASE_TLSTREAM_FLAGS_MASK (BASE_TLSTREAM_ENABLE_LATENCY_TRACEPOINTS | \
-		BASE_TLSTREAM_JOB_DUMPING_ENABLED)
+		BASE_TLSTREAM_JOB_DUMPING_ENABLED | BASE_TLSTREAM_CLASS_MASK)
+
+/* Timeline stream descriptor ioctl, changes the latency and class flags of
+ * the stream while it is being read. Takes a u32 with the same encoding as
+ * the flags given when acquiring the stream. */
+#define BASE_TLSTREAM_IOCTL_SET_FLAGS _IOW(0xBF, 0x00, u32)
+
+/**
+ * struct base_tlstream_ring_ctrl - control page of the timeline packet ring
+ * @head:           index of the next packet slot written by the kernel
+ * @tail:           index of the next packet slot to be consumed, written by
+ *                  user space once it is done with a packet
+ * @packet_count:   number of packet slots in the ring, a power of two
+ * @packet_size:    size of a packet slot in bytes
+ * @wake_threshold: poll reports the stream as readable once this many
+ *                  packets are available, written by user space. Zero is
+ *                  treated as one.
+ * @dropped:        number of packets dropped because the ring was full
+ *
+ * The timeline stream descriptor can be mapped instead of being read. The
+ * mapping starts with this control page, followed by @packet_count slots of
+ * @packet_size bytes holding one packet each. The ring size is taken from
+ * the size of the mapping. Packets are in slot (index % @packet_count), their
+ * length is given by their header. While the ring is mapped, read() on the
+ * descriptor fails with EBUSY. Once it is unmapped, packets can be read
+ * again or a new ring mapped.
+ */
+struct base_tlstream_ring_ctrl {
+	u32 head;
+	u32 tail;
+	u32 packet_count;
+	u32 packet_size;
+	u32 wake_threshold;
+	u32 dropped;
+};
 
 #endif				/* _BASE_KERNEL_H_ */
@@ -200,6 +200,9 @@ void kbasep_remove_waiting_soft_job(struct kbase_jd_atom *katom);
 int kbase_soft_event_update(struct kbase_context *kctx,
 			    u64 event,
 			    unsigned char new_status);
+int kbase_timeline_batch(struct kbase_context *kctx,
+			 const struct base_jd_timeline_point *points,
+			 u32 count, u32 op, u64 timeout_ns);
 
 bool kbase_replay_process(struct kbase_jd_atom *katom);
 
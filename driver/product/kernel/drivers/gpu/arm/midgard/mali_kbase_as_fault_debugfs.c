@@ -65,6 +65,153 @@ static const struct file_operations as_fault_fops = {
 };
 
 #endif /* CONFIG_MALI_DEBUG */
+
+static int kbase_as_fault_stats_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_context *kctx = sfile->private;
+	struct kbase_fault_stats *stats = &kctx->fault_stats;
+	u32 nr_faults = atomic_read(&stats->nr_faults);
+	u32 nr_grown = atomic_read(&stats->nr_grown);
+	u32 nr_spurious = atomic_read(&stats->nr_spurious);
+
+	seq_printf(sfile, "faults: %u\n", nr_faults);
+	seq_printf(sfile, "grown: %u\n", nr_grown);
+	seq_printf(sfile, "spurious: %u\n", nr_spurious);
+	seq_printf(sfile, "fatal: %u\n", nr_faults - nr_grown - nr_spurious);
+	seq_printf(sfile, "pages_grown: %llu\n",
+			(u64)atomic64_read(&stats->nr_pages_grown));
+
+	kbase_latency_hist_show(sfile, "irq_to_worker", &stats->irq_to_worker);
+	kbase_latency_hist_show(sfile, "alloc", &stats->alloc);
+	kbase_latency_hist_show(sfile, "insert", &stats->insert);
+	kbase_latency_hist_show(sfile, "unlock", &stats->unlock);
+
+	return 0;
+}
+
+static int kbase_as_fault_stats_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbase_as_fault_stats_show, in->i_private);
+}
+
+static ssize_t kbase_as_fault_stats_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_context *kctx = sfile->private;
+	struct kbase_fault_stats *stats = &kctx->fault_stats;
+
+	atomic_set(&stats->nr_faults, 0);
+	atomic_set(&stats->nr_grown, 0);
+	atomic_set(&stats->nr_spurious, 0);
+	atomic64_set(&stats->nr_pages_grown, 0);
+	kbase_latency_hist_reset(&stats->irq_to_worker);
+	kbase_latency_hist_reset(&stats->alloc);
+	kbase_latency_hist_reset(&stats->insert);
+	kbase_latency_hist_reset(&stats->unlock);
+
+	return count;
+}
+
+static const struct file_operations as_fault_stats_fops = {
+	.open = kbase_as_fault_stats_open,
+	.read = seq_read,
+	.write = kbase_as_fault_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Number of regions listed in page_fault_regions */
+#define KBASE_AS_FAULT_TOP_REGIONS 16
+
+struct kbase_as_fault_region {
+	u64 start_pfn;
+	size_t nr_pages;
+	size_t backed;
+	size_t extent;
+	u32 nr_grow_faults;
+	size_t nr_grow_pages;
+};
+
+static void kbase_as_fault_top_add(struct kbase_as_fault_region *top,
+		unsigned int *nr_top, struct kbase_va_region *reg)
+{
+	unsigned int i = *nr_top;
+
+	if (!reg->nr_grow_faults)
+		return;
+
+	if (i == KBASE_AS_FAULT_TOP_REGIONS) {
+		if (top[i - 1].nr_grow_faults >= reg->nr_grow_faults)
+			return;
+		i--;
+	} else {
+		(*nr_top)++;
+	}
+
+	/* Keep the list sorted by decreasing number of faults */
+	for (; i > 0 && top[i - 1].nr_grow_faults < reg->nr_grow_faults; i--)
+		top[i] = top[i - 1];
+
+	top[i].start_pfn = reg->start_pfn;
+	top[i].nr_pages = reg->nr_pages;
+	top[i].backed = kbase_reg_current_backed_size(reg);
+	top[i].extent = reg->extent;
+	top[i].nr_grow_faults = reg->nr_grow_faults;
+	top[i].nr_grow_pages = reg->nr_grow_pages;
+}
+
+static int kbase_as_fault_regions_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_context *kctx = sfile->private;
+	struct rb_root *rbtrees[] = {
+		&kctx->reg_rbtree_same,
+		&kctx->reg_rbtree_exec,
+		&kctx->reg_rbtree_custom,
+	};
+	struct kbase_as_fault_region *top;
+	unsigned int nr_top = 0;
+	unsigned int i;
+
+	top = kcalloc(KBASE_AS_FAULT_TOP_REGIONS, sizeof(*top), GFP_KERNEL);
+	if (!top)
+		return -ENOMEM;
+
+	kbase_gpu_vm_lock(kctx);
+	for (i = 0; i < ARRAY_SIZE(rbtrees); i++) {
+		struct rb_node *p;
+
+		for (p = rb_first(rbtrees[i]); p; p = rb_next(p))
+			kbase_as_fault_top_add(top, &nr_top,
+					rb_entry(p, struct kbase_va_region,
+						rblink));
+	}
+	kbase_gpu_vm_unlock(kctx);
+
+	seq_puts(sfile, "gpu_va nr_pages backed extent faults pages_grown\n");
+	for (i = 0; i < nr_top; i++)
+		seq_printf(sfile, "0x%llx %zu %zu %zu %u %zu\n",
+				top[i].start_pfn << PAGE_SHIFT,
+				top[i].nr_pages, top[i].backed,
+				top[i].extent, top[i].nr_grow_faults,
+				top[i].nr_grow_pages);
+
+	kfree(top);
+
+	return 0;
+}
+
+static int kbase_as_fault_regions_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbase_as_fault_regions_show, in->i_private);
+}
+
+static const struct file_operations as_fault_regions_fops = {
+	.open = kbase_as_fault_regions_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 #endif /* CONFIG_DEBUG_FS */
 
 /*
@@ -100,3 +247,13 @@ void kbase_as_fault_debugfs_init(struct kbase_device *kbdev)
 #endif /* CONFIG_DEBUG_FS */
 	return;
 }
+
+void kbase_as_fault_debugfs_ctx_init(struct kbase_context *kctx)
+{
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("page_faults", S_IRUGO | S_IWUSR,
+			kctx->kctx_dentry, kctx, &as_fault_stats_fops);
+	debugfs_create_file("page_fault_regions", S_IRUGO,
+			kctx->kctx_dentry, kctx, &as_fault_regions_fops);
+#endif /* CONFIG_DEBUG_FS */
+}
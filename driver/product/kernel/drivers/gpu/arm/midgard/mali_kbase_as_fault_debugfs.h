@@ -25,6 +25,18 @@
  */
 void kbase_as_fault_debugfs_init(struct kbase_device *kbdev);
 
+/**
+ * kbase_as_fault_debugfs_ctx_init() - Add debugfs files for reporting page
+ * fault statistics of a context
+ *
+ * @kctx: Pointer to kbase_context
+ *
+ * page_faults shows the number of faults and the time spent handling them,
+ * writing to it resets the statistics. page_fault_regions lists the regions
+ * grown by the most faults.
+ */
+void kbase_as_fault_debugfs_ctx_init(struct kbase_context *kctx);
+
 /**
  * kbase_as_fault_debugfs_new() - make the last fault available on debugfs
  *
@@ -38,6 +38,8 @@ struct kbase_context *
 kbase_create_context(struct kbase_device *kbdev, bool is_compat)
 {
 	struct kbase_context *kctx;
+	int node;
+	int i;
 	int err;
 
 	KBASE_DEBUG_ASSERT(kbdev != NULL);
@@ -67,9 +69,10 @@ kbase_create_context(struct kbase_device *kbdev, bool is_compat)
 	kctx->tgid = current->tgid;
 	kctx->pid = current->pid;
 
+	node = kbase_mem_preferred_node(kbdev);
 	err = kbase_mem_pool_init(&kctx->mem_pool,
-			kbdev->mem_pool_max_size_default,
-			kctx->kbdev, &kbdev->mem_pool);
+			kbdev->mem_pool_max_size_default, node,
+			kctx->kbdev, &kbdev->mem_pools[node]);
 	if (err)
 		goto free_kctx;
 
@@ -97,6 +100,10 @@ kbase_create_context(struct kbase_device *kbdev, bool is_compat)
 
 	INIT_LIST_HEAD(&kctx->waiting_soft_jobs);
 	spin_lock_init(&kctx->waiting_soft_jobs_lock);
+	for (i = 0; i < ARRAY_SIZE(kctx->soft_event_waiters); i++)
+		INIT_HLIST_HEAD(&kctx->soft_event_waiters[i]);
+	atomic_set(&kctx->timeline_seq, 0);
+	init_waitqueue_head(&kctx->timeline_wait);
 #ifdef CONFIG_KDS
 	INIT_LIST_HEAD(&kctx->waiting_kds_resource);
 #endif
@@ -119,7 +126,8 @@ kbase_create_context(struct kbase_device *kbdev, bool is_compat)
 		mutex_unlock(&kctx->mmu_lock);
 	} while (!kctx->pgd);
 
-	kctx->aliasing_sink_page = kbase_mem_alloc_page(kctx->kbdev);
+	kctx->aliasing_sink_page = kbase_mem_alloc_page(kctx->kbdev,
+			kctx->mem_pool.node);
 	if (!kctx->aliasing_sink_page)
 		goto no_sink_page;
 
@@ -136,6 +144,14 @@ kbase_create_context(struct kbase_device *kbdev, bool is_compat)
 	if (err)
 		goto no_sticky;
 
+	err = kbase_umm_cache_init(kctx);
+	if (err)
+		goto no_umm_cache;
+
+	err = kbase_user_buf_cache_init(kctx);
+	if (err)
+		goto no_user_buf_cache;
+
 	err = kbase_jit_init(kctx);
 	if (err)
 		goto no_jit;
@@ -157,6 +173,15 @@ kbase_create_context(struct kbase_device *kbdev, bool is_compat)
 	return kctx;
 
 no_jit:
+	kbase_gpu_vm_lock(kctx);
+	kbase_user_buf_cache_term(kctx);
+	kbase_gpu_vm_unlock(kctx);
+	kbase_user_buf_cache_detach(kctx);
+no_user_buf_cache:
+	kbase_gpu_vm_lock(kctx);
+	kbase_umm_cache_term(kctx);
+	kbase_gpu_vm_unlock(kctx);
+no_umm_cache:
 	kbase_gpu_vm_lock(kctx);
 	kbase_sticky_resource_term(kctx);
 	kbase_gpu_vm_unlock(kctx);
@@ -245,6 +270,8 @@ void kbase_destroy_context(struct kbase_context *kctx)
 	kbase_gpu_vm_lock(kctx);
 
 	kbase_sticky_resource_term(kctx);
+	kbase_umm_cache_term(kctx);
+	kbase_user_buf_cache_term(kctx);
 
 	/* MMU is disabled as part of scheduling out the context */
 	kbase_mmu_free_pgd(kctx);
@@ -268,6 +295,8 @@ void kbase_destroy_context(struct kbase_context *kctx)
 	kbase_region_tracker_term(kctx);
 	kbase_gpu_vm_unlock(kctx);
 
+	kbase_user_buf_cache_detach(kctx);
+
 	/* Safe to call this one even when didn't initialize (assuming kctx was sufficiently zeroed) */
 	kbasep_js_kctx_term(kctx);
 
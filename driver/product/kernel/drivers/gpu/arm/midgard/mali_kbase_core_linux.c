@@ -1019,6 +1019,53 @@ copy_failed:
 			break;
 		}
 
+	case KBASE_FUNC_TIMELINE_BATCH:
+		{
+			struct kbase_uk_timeline_batch *batch = args;
+			struct base_jd_timeline_point *points;
+			void __user *user_points;
+			int err;
+
+			if (sizeof(*batch) != args_size)
+				goto bad_size;
+
+			if (!batch->count ||
+			    batch->count > KBASE_TIMELINE_BATCH_MAX_POINTS)
+				goto out_bad;
+
+#ifdef CONFIG_COMPAT
+			if (kbase_ctx_flag(kctx, KCTX_COMPAT))
+				user_points =
+					compat_ptr(batch->points.compat_value);
+			else
+#endif
+				user_points = batch->points.value;
+
+			points = kmalloc_array(batch->count, sizeof(*points),
+					GFP_KERNEL);
+			if (!points)
+				goto out_bad;
+
+			if (copy_from_user(points, user_points,
+					batch->count * sizeof(*points)))
+				err = -EFAULT;
+			else
+				err = kbase_timeline_batch(kctx, points,
+						batch->count, batch->op,
+						batch->timeout_ns);
+
+			kfree(points);
+
+			/* An interrupted wait fails the system call so that it
+			 * is restarted, or the signal reported to user space,
+			 * rather than being mistaken for a timeout. */
+			if (err == -ERESTARTSYS)
+				return err;
+			if (err)
+				ukh->ret = MALI_ERROR_FUNCTION_FAILED;
+			break;
+		}
+
 	default:
 		dev_err(kbdev->dev, "unknown ioctl %u\n", id);
 		goto out_bad;
@@ -1239,6 +1286,11 @@ static int kbase_open(struct inode *inode, struct file *filp)
 	kbase_mem_pool_debugfs_init(kctx->kctx_dentry, &kctx->mem_pool);
 
 	kbase_jit_debugfs_init(kctx);
+	kbase_umm_cache_debugfs_init(kctx);
+	kbase_user_buf_cache_debugfs_init(kctx);
+
+	kbase_latency_debugfs_ctx_init(kctx);
+	kbase_as_fault_debugfs_ctx_init(kctx);
 #endif /* CONFIG_DEBUG_FS */
 
 	dev_dbg(kbdev->dev, "created base context\n");
@@ -1261,6 +1313,9 @@ static int kbase_open(struct inode *inode, struct file *filp)
 			dev_warn(kbdev->dev, "couldn't add kctx to kctx_list\n");
 		}
 	}
+
+	kbase_mem_pool_tuner_warmup(kctx);
+
 	return 0;
 
  out:
@@ -1294,6 +1349,8 @@ static int kbase_release(struct inode *inode, struct file *filp)
 	if (!found_element)
 		dev_warn(kbdev->dev, "kctx not in kctx_list\n");
 
+	kbase_mem_pool_tuner_remove_ctx(kctx);
+
 	filp->private_data = NULL;
 
 	mutex_lock(&kctx->vinstr_cli_lock);
@@ -1322,6 +1379,7 @@ static long kbase_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	u64 msg[(CALL_MAX_SIZE + 7) >> 3] = { 0xdeadbeefdeadbeefull };	/* alignment fixup */
 	u32 size = _IOC_SIZE(cmd);
 	struct kbase_context *kctx = filp->private_data;
+	int err;
 
 	if (size > CALL_MAX_SIZE)
 		return -ENOTTY;
@@ -1331,7 +1389,10 @@ static long kbase_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		return -EFAULT;
 	}
 
-	if (kbase_dispatch(kctx, &msg, size) != 0)
+	err = kbase_dispatch(kctx, &msg, size);
+	if (err == -ERESTARTSYS)
+		return err;
+	if (err != 0)
 		return -EFAULT;
 
 	if (0 != copy_to_user((void __user *)arg, &msg, size)) {
@@ -2926,18 +2987,41 @@ static DEVICE_ATTR(reset_timeout, S_IRUGO | S_IWUSR, show_reset_timeout,
 
 
 
+/**
+ * kbase_mem_pool_node_share - Share of a total taken by one node's pool
+ * @total: Total number of pages across the device memory pools
+ * @idx:   Index of the pool among the possible nodes
+ *
+ * The sysfs files below report and accept totals over all the device memory
+ * pools, which are split evenly across the nodes, so that writing back a
+ * value that was read leaves the pools as they are. The per-node values can
+ * be found in the mem_pools debugfs file.
+ *
+ * Return: Number of pages of @total given to the pool
+ */
+static size_t kbase_mem_pool_node_share(size_t total, int idx)
+{
+	size_t nr_nodes = num_possible_nodes();
+
+	return total / nr_nodes + ((size_t)idx < total % nr_nodes ? 1 : 0);
+}
+
 static ssize_t show_mem_pool_size(struct device *dev,
 		struct device_attribute *attr, char * const buf)
 {
 	struct kbase_device *kbdev;
+	size_t size = 0;
 	ssize_t ret;
+	int node;
 
 	kbdev = to_kbase_device(dev);
 	if (!kbdev)
 		return -ENODEV;
 
-	ret = scnprintf(buf, PAGE_SIZE, "%zu\n",
-			kbase_mem_pool_size(&kbdev->mem_pool));
+	for_each_node(node)
+		size += kbase_mem_pool_size(&kbdev->mem_pools[node]);
+
+	ret = scnprintf(buf, PAGE_SIZE, "%zu\n", size);
 
 	return ret;
 }
@@ -2947,6 +3031,8 @@ static ssize_t set_mem_pool_size(struct device *dev,
 {
 	struct kbase_device *kbdev;
 	size_t new_size;
+	int node;
+	int idx = 0;
 	int err;
 
 	kbdev = to_kbase_device(dev);
@@ -2957,7 +3043,9 @@ static ssize_t set_mem_pool_size(struct device *dev,
 	if (err)
 		return err;
 
-	kbase_mem_pool_trim(&kbdev->mem_pool, new_size);
+	for_each_node(node)
+		kbase_mem_pool_trim(&kbdev->mem_pools[node],
+				kbase_mem_pool_node_share(new_size, idx++));
 
 	return count;
 }
@@ -2969,14 +3057,18 @@ static ssize_t show_mem_pool_max_size(struct device *dev,
 		struct device_attribute *attr, char * const buf)
 {
 	struct kbase_device *kbdev;
+	size_t max_size = 0;
 	ssize_t ret;
+	int node;
 
 	kbdev = to_kbase_device(dev);
 	if (!kbdev)
 		return -ENODEV;
 
-	ret = scnprintf(buf, PAGE_SIZE, "%zu\n",
-			kbase_mem_pool_max_size(&kbdev->mem_pool));
+	for_each_node(node)
+		max_size += kbase_mem_pool_max_size(&kbdev->mem_pools[node]);
+
+	ret = scnprintf(buf, PAGE_SIZE, "%zu\n", max_size);
 
 	return ret;
 }
@@ -2986,6 +3078,8 @@ static ssize_t set_mem_pool_max_size(struct device *dev,
 {
 	struct kbase_device *kbdev;
 	size_t new_max_size;
+	int node;
+	int idx = 0;
 	int err;
 
 	kbdev = to_kbase_device(dev);
@@ -2996,7 +3090,9 @@ static ssize_t set_mem_pool_max_size(struct device *dev,
 	if (err)
 		return -EINVAL;
 
-	kbase_mem_pool_set_max_size(&kbdev->mem_pool, new_max_size);
+	for_each_node(node)
+		kbase_mem_pool_set_max_size(&kbdev->mem_pools[node],
+				kbase_mem_pool_node_share(new_max_size, idx++));
 
 	return count;
 }
@@ -3004,6 +3100,296 @@ static ssize_t set_mem_pool_max_size(struct device *dev,
 static DEVICE_ATTR(mem_pool_max_size, S_IRUGO | S_IWUSR, show_mem_pool_max_size,
 		set_mem_pool_max_size);
 
+/**
+ * show_mem_pool_dirty_wmark - Show the background zeroing watermark
+ * @dev:  The device this sysfs file is for
+ * @attr: The attributes of the sysfs file
+ * @buf:  The output buffer
+ *
+ * Return: The number of bytes output to @buf.
+ */
+static ssize_t show_mem_pool_dirty_wmark(struct device *dev,
+		struct device_attribute *attr, char * const buf)
+{
+	struct kbase_device *kbdev;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%zu\n",
+			kbase_mem_pool_dirty_wmark(&kbdev->mem_pools[
+				kbase_mem_preferred_node(kbdev)]));
+}
+
+/**
+ * set_mem_pool_dirty_wmark - Set the background zeroing watermark
+ * @dev:   The device this sysfs file is for
+ * @attr:  The attributes of the sysfs file
+ * @buf:   The value written to the sysfs file
+ * @count: The number of bytes written to the sysfs file
+ *
+ * Pages spilled into the device memory pool are zeroed in the background once
+ * more than this number of them are waiting.
+ *
+ * Return: @count if the function succeeded. An error code on failure.
+ */
+static ssize_t set_mem_pool_dirty_wmark(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kbase_device *kbdev;
+	unsigned long wmark;
+	int node;
+	int err;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	err = kstrtoul(buf, 0, &wmark);
+	if (err)
+		return -EINVAL;
+
+	for_each_node(node)
+		kbase_mem_pool_set_dirty_wmark(&kbdev->mem_pools[node], wmark);
+
+	return count;
+}
+
+static DEVICE_ATTR(mem_pool_dirty_wmark, S_IRUGO | S_IWUSR,
+		show_mem_pool_dirty_wmark, set_mem_pool_dirty_wmark);
+
+/**
+ * show_mem_pool_dirty_max - Show the maximum number of pages to zero
+ * @dev:  The device this sysfs file is for
+ * @attr: The attributes of the sysfs file
+ * @buf:  The output buffer
+ *
+ * Return: The number of bytes output to @buf.
+ */
+static ssize_t show_mem_pool_dirty_max(struct device *dev,
+		struct device_attribute *attr, char * const buf)
+{
+	struct kbase_device *kbdev;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%zu\n",
+			kbase_mem_pool_dirty_max(&kbdev->mem_pools[
+				kbase_mem_preferred_node(kbdev)]));
+}
+
+/**
+ * set_mem_pool_dirty_max - Set the maximum number of pages to zero
+ * @dev:   The device this sysfs file is for
+ * @attr:  The attributes of the sysfs file
+ * @buf:   The value written to the sysfs file
+ * @count: The number of bytes written to the sysfs file
+ *
+ * Pages spilled into the device memory pool while this many pages wait to be
+ * zeroed are zeroed by the freeing thread. Zero disables background zeroing.
+ *
+ * Return: @count if the function succeeded. An error code on failure.
+ */
+static ssize_t set_mem_pool_dirty_max(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kbase_device *kbdev;
+	unsigned long dirty_max;
+	int node;
+	int err;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	err = kstrtoul(buf, 0, &dirty_max);
+	if (err)
+		return -EINVAL;
+
+	for_each_node(node)
+		kbase_mem_pool_set_dirty_max(&kbdev->mem_pools[node], dirty_max);
+
+	return count;
+}
+
+static DEVICE_ATTR(mem_pool_dirty_max, S_IRUGO | S_IWUSR,
+		show_mem_pool_dirty_max, set_mem_pool_dirty_max);
+
+/**
+ * show_mem_pool_node - Show the NUMA node new contexts allocate from
+ * @dev:  The device this sysfs file is for
+ * @attr: The attributes of the sysfs file
+ * @buf:  The output buffer
+ *
+ * Return: The number of bytes output to @buf.
+ */
+static ssize_t show_mem_pool_node(struct device *dev,
+		struct device_attribute *attr, char * const buf)
+{
+	struct kbase_device *kbdev;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", kbdev->mem_pool_node);
+}
+
+/**
+ * set_mem_pool_node - Set the NUMA node new contexts allocate from
+ * @dev:   The device this sysfs file is for
+ * @attr:  The attributes of the sysfs file
+ * @buf:   The value written to the sysfs file
+ * @count: The number of bytes written to the sysfs file
+ *
+ * Contexts created after this is written back their memory pool onto the
+ * device pool of the given node. Writing -1 selects the node of the task
+ * creating each context.
+ *
+ * Return: @count if the function succeeded. An error code on failure.
+ */
+static ssize_t set_mem_pool_node(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kbase_device *kbdev;
+	int node;
+	int err;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	err = kstrtoint(buf, 0, &node);
+	if (err)
+		return -EINVAL;
+
+	if (node != NUMA_NO_NODE &&
+			(node < 0 || node >= nr_node_ids || !node_possible(node)))
+		return -EINVAL;
+
+	WRITE_ONCE(kbdev->mem_pool_node, node);
+
+	return count;
+}
+
+static DEVICE_ATTR(mem_pool_node, S_IRUGO | S_IWUSR, show_mem_pool_node,
+		set_mem_pool_node);
+
+/**
+ * show_mem_pool_tune_period - Show the memory pool autotuner period
+ * @dev:  The device this sysfs file is for
+ * @attr: The attributes of the sysfs file
+ * @buf:  The output buffer
+ *
+ * Return: The number of bytes output to @buf.
+ */
+static ssize_t show_mem_pool_tune_period(struct device *dev,
+		struct device_attribute *attr, char * const buf)
+{
+	struct kbase_device *kbdev;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			READ_ONCE(kbdev->mem_pool_tuner.period_ms));
+}
+
+/**
+ * set_mem_pool_tune_period - Set the memory pool autotuner period
+ * @dev:   The device this sysfs file is for
+ * @attr:  The attributes of the sysfs file
+ * @buf:   The value written to the sysfs file
+ * @count: The number of bytes written to the sysfs file
+ *
+ * The demand on each memory pool is sampled every this many milliseconds.
+ * Writing 0 disables autotuning, leaving the pools to grow on demand only.
+ *
+ * Return: @count if the function succeeded. An error code on failure.
+ */
+static ssize_t set_mem_pool_tune_period(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kbase_device *kbdev;
+	unsigned int period_ms;
+	int err;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	err = kstrtouint(buf, 0, &period_ms);
+	if (err)
+		return -EINVAL;
+
+	kbase_mem_pool_tuner_set_period(kbdev, period_ms);
+
+	return count;
+}
+
+static DEVICE_ATTR(mem_pool_tune_period, S_IRUGO | S_IWUSR,
+		show_mem_pool_tune_period, set_mem_pool_tune_period);
+
+/**
+ * show_mem_pool_warmup - Show the number of pages new context pools get
+ * @dev:  The device this sysfs file is for
+ * @attr: The attributes of the sysfs file
+ * @buf:  The output buffer
+ *
+ * Return: The number of bytes output to @buf.
+ */
+static ssize_t show_mem_pool_warmup(struct device *dev,
+		struct device_attribute *attr, char * const buf)
+{
+	struct kbase_device *kbdev;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%zu\n",
+			READ_ONCE(kbdev->mem_pool_tuner.warmup_pages));
+}
+
+/**
+ * set_mem_pool_warmup - Set the number of pages new context pools get
+ * @dev:   The device this sysfs file is for
+ * @attr:  The attributes of the sysfs file
+ * @buf:   The value written to the sysfs file
+ * @count: The number of bytes written to the sysfs file
+ *
+ * The memory pool of a new context is grown to this many pages in the
+ * background while autotuning is enabled.
+ *
+ * Return: @count if the function succeeded. An error code on failure.
+ */
+static ssize_t set_mem_pool_warmup(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kbase_device *kbdev;
+	unsigned long warmup_pages;
+	int err;
+
+	kbdev = to_kbase_device(dev);
+	if (!kbdev)
+		return -ENODEV;
+
+	err = kstrtoul(buf, 0, &warmup_pages);
+	if (err)
+		return -EINVAL;
+
+	WRITE_ONCE(kbdev->mem_pool_tuner.warmup_pages, warmup_pages);
+
+	return count;
+}
+
+static DEVICE_ATTR(mem_pool_warmup, S_IRUGO | S_IWUSR, show_mem_pool_warmup,
+		set_mem_pool_warmup);
+
 #ifdef CONFIG_DEBUG_FS
 
 /* Number of entries in serialize_jobs_settings[] */
@@ -3463,6 +3849,10 @@ static int kbase_device_debugfs_init(struct kbase_device *kbdev)
 	kbase_debug_job_fault_debugfs_init(kbdev);
 	kbasep_gpu_memory_debugfs_init(kbdev);
 	kbase_as_fault_debugfs_init(kbdev);
+	kbase_vinstr_debugfs_init(kbdev);
+	kbase_latency_debugfs_init(kbdev);
+	kbase_mem_pool_nodes_debugfs_init(kbdev->mali_debugfs_directory,
+			kbdev);
 #if KBASE_GPU_RESET_EN
 	debugfs_create_file("quirks_sc", 0644,
 			kbdev->mali_debugfs_directory, kbdev,
@@ -3617,6 +4007,11 @@ static struct attribute *kbase_attrs[] = {
 	&dev_attr_core_mask.attr,
 	&dev_attr_mem_pool_size.attr,
 	&dev_attr_mem_pool_max_size.attr,
+	&dev_attr_mem_pool_dirty_wmark.attr,
+	&dev_attr_mem_pool_dirty_max.attr,
+	&dev_attr_mem_pool_node.attr,
+	&dev_attr_mem_pool_tune_period.attr,
+	&dev_attr_mem_pool_warmup.attr,
 	NULL
 };
 
@@ -3670,11 +4065,6 @@ static int kbase_platform_device_remove(struct platform_device *pdev)
 		kbase_debug_job_fault_dev_term(kbdev);
 		kbdev->inited_subsys &= ~inited_job_fault;
 	}
-	if (kbdev->inited_subsys & inited_vinstr) {
-		kbase_vinstr_term(kbdev->vinstr_ctx);
-		kbdev->inited_subsys &= ~inited_vinstr;
-	}
-
 #ifdef CONFIG_MALI_DEVFREQ
 	if (kbdev->inited_subsys & inited_devfreq) {
 		kbase_devfreq_term(kbdev);
@@ -3682,6 +4072,11 @@ static int kbase_platform_device_remove(struct platform_device *pdev)
 	}
 #endif
 
+	if (kbdev->inited_subsys & inited_vinstr) {
+		kbase_vinstr_term(kbdev->vinstr_ctx);
+		kbdev->inited_subsys &= ~inited_vinstr;
+	}
+
 	if (kbdev->inited_subsys & inited_backend_late) {
 		kbase_backend_late_term(kbdev);
 		kbdev->inited_subsys &= ~inited_backend_late;
@@ -3917,16 +4312,13 @@ static int kbase_platform_device_probe(struct platform_device *pdev)
 	}
 	kbdev->inited_subsys |= inited_backend_late;
 
-#ifdef CONFIG_MALI_DEVFREQ
-	err = kbase_devfreq_init(kbdev);
-	if (err) {
-		dev_err(kbdev->dev, "Devfreq initialization failed\n");
-		kbase_platform_device_remove(pdev);
-		return err;
-	}
-	kbdev->inited_subsys |= inited_devfreq;
-#endif /* CONFIG_MALI_DEVFREQ */
+	/* initialize the kctx list. This must be done before any vinstr
+	 * client can attach, as vinstr creates a kernel context. */
+	mutex_init(&kbdev->kctx_list_lock);
+	INIT_LIST_HEAD(&kbdev->kctx_list);
 
+	/* Vinstr is initialized before devfreq, as IPA power models may
+	 * attach a vinstr client to sample hardware counters. */
 	kbdev->vinstr_ctx = kbase_vinstr_init(kbdev);
 	if (!kbdev->vinstr_ctx) {
 		dev_err(kbdev->dev,
@@ -3936,6 +4328,16 @@ static int kbase_platform_device_probe(struct platform_device *pdev)
 	}
 	kbdev->inited_subsys |= inited_vinstr;
 
+#ifdef CONFIG_MALI_DEVFREQ
+	err = kbase_devfreq_init(kbdev);
+	if (err) {
+		dev_err(kbdev->dev, "Devfreq initialization failed\n");
+		kbase_platform_device_remove(pdev);
+		return err;
+	}
+	kbdev->inited_subsys |= inited_devfreq;
+#endif /* CONFIG_MALI_DEVFREQ */
+
 	err = kbase_debug_job_fault_dev_init(kbdev);
 	if (err) {
 		dev_err(kbdev->dev, "Job fault debug initialization failed\n");
@@ -3952,10 +4354,6 @@ static int kbase_platform_device_probe(struct platform_device *pdev)
 	}
 	kbdev->inited_subsys |= inited_debugfs;
 
-	/* initialize the kctx list */
-	mutex_init(&kbdev->kctx_list_lock);
-	INIT_LIST_HEAD(&kbdev->kctx_list);
-
 	kbdev->mdev.minor = MISC_DYNAMIC_MINOR;
 	kbdev->mdev.name = kbdev->devname;
 	kbdev->mdev.fops = &kbase_fops;
@@ -35,11 +35,15 @@
 #include <mali_kbase_mmu_mode.h>
 #include <mali_kbase_instr_defs.h>
 #include <mali_kbase_pm.h>
+#include <mali_kbase_latency.h>
 
 #include <linux/atomic.h>
 #include <linux/mempool.h>
 #include <linux/slab.h>
 #include <linux/file.h>
+#include <linux/mmu_notifier.h>
+#include <asm/local.h>
+#include <asm/local64.h>
 
 #ifdef CONFIG_MALI_FPGA_BUS_LOGGER
 #include <linux/bus_logger.h>
@@ -170,6 +174,9 @@
 /* Maximum force replay limit when randomization is enabled */
 #define KBASEP_FORCE_REPLAY_RANDOM_LIMIT 16
 
+/* Number of hash buckets, log2, for the soft event waiters of a context */
+#define KBASEP_SOFT_EVENT_HASH_BITS 6
+
 /** Atom has been previously soft-stoppped */
 #define KBASE_KATOM_FLAG_BEEN_SOFT_STOPPPED (1<<1)
 /** Atom has been previously retried to execute */
@@ -409,6 +416,10 @@ struct kbase_ext_res {
 struct kbase_jd_atom {
 	struct work_struct work;
 	ktime_t start_timestamp;
+	/* End of the last stage of the atom, in ns, zero if untracked */
+	u64 latency_ts;
+	/* Next stage expected, see enum kbase_latency_stage */
+	u8 latency_next;
 
 	struct base_jd_udata udata;
 	struct kbase_context *kctx;
@@ -437,6 +448,8 @@ struct kbase_jd_atom {
 	bool kds_dep_satisfied;
 #endif				/* CONFIG_KDS */
 #ifdef CONFIG_SYNC
+	/* Fence of a fence soft job, or exported by a BASE_JD_REQ_FENCE_EXPORT
+	 * atom and signalled when it completes */
 	struct sync_fence *fence;
 	struct sync_fence_waiter sync_waiter;
 #endif				/* CONFIG_SYNC */
@@ -491,6 +504,10 @@ struct kbase_jd_atom {
 		 * kctx->dma_fence.wq.
 		 */
 		atomic_t dep_count;
+		/* When the atom started waiting for its dependencies, for the
+		 * fence wait latency reported in the timeline stream.
+		 */
+		ktime_t wait_start;
 	} dma_fence;
 #endif /* CONFIG_MALI_DMA_FENCE */
 
@@ -555,6 +572,18 @@ struct kbase_jd_atom {
 	 */
 	struct list_head queue;
 
+	/* Event or timeline a waiting soft job is blocked on, @timeline
+	 * telling which of the two @addr is. The node links the atom into
+	 * kbase_context::soft_event_waiters, hashed by @addr, while it is also
+	 * on the list of waiting soft jobs.
+	 */
+	struct {
+		u64 addr;
+		u64 point;
+		bool timeline;
+		struct hlist_node node;
+	} soft_event;
+
 	/* Used to keep track of all JIT free/alloc jobs in submission order
 	 */
 	struct list_head jit_node;
@@ -676,6 +705,8 @@ struct kbase_as {
 	u32 fault_status;
 	u64 fault_addr;
 	u64 fault_extra_addr;
+	/* Time the page fault worker was queued, in ns */
+	u64 fault_ts;
 
 	struct kbase_mmu_setup current_setup;
 
@@ -705,6 +736,30 @@ struct kbasep_mem_device {
 
 };
 
+/**
+ * struct kbase_fault_stats - page fault statistics of a context
+ * @nr_faults:      number of page faults handled
+ * @nr_grown:       number of faults that grew a region
+ * @nr_spurious:    number of faults on pages already backed
+ * @nr_pages_grown: number of pages added by growing regions
+ * @irq_to_worker:  time from the MMU interrupt to the worker starting
+ * @alloc:          time spent allocating the physical pages
+ * @insert:         time spent inserting the pages in the page tables
+ * @unlock:         time spent flushing and unlocking the address space
+ *
+ * Faults that are neither grown nor spurious are fatal to the context.
+ */
+struct kbase_fault_stats {
+	atomic_t nr_faults;
+	atomic_t nr_grown;
+	atomic_t nr_spurious;
+	atomic64_t nr_pages_grown;
+	struct kbase_latency_hist irq_to_worker;
+	struct kbase_latency_hist alloc;
+	struct kbase_latency_hist insert;
+	struct kbase_latency_hist unlock;
+};
+
 #define KBASE_TRACE_CODE(X) KBASE_TRACE_CODE_ ## X
 
 enum kbase_trace_code {
@@ -722,20 +777,61 @@ enum kbase_trace_code {
 #define KBASE_TRACE_FLAG_REFCOUNT (((u8)1) << 0)
 #define KBASE_TRACE_FLAG_JOBSLOT  (((u8)1) << 1)
 
+/**
+ * struct kbase_trace - trace record
+ * @timestamp:   CLOCK_MONOTONIC time of the record in nanoseconds
+ * @ctx:         address of the context the record refers to
+ * @atom_udata:  user data of the atom the record refers to
+ * @gpu_addr:    GPU address
+ * @info_val:    code specific value
+ * @seq:         sequence number of the record in the ring of its CPU, zero
+ *               while the record is being written. Sequence numbers start at
+ *               one and are 64-bit so they never wrap back to zero.
+ * @thread_id:   pid of the thread that emitted the record
+ * @cpu:         CPU that emitted the record
+ * @atom_number: number of the atom the record refers to
+ * @code:        trace code, see enum kbase_trace_code
+ * @jobslot:     job slot, valid if KBASE_TRACE_FLAG_JOBSLOT is set
+ * @refcount:    reference count, valid if KBASE_TRACE_FLAG_REFCOUNT is set
+ * @flags:       KBASE_TRACE_FLAG_* bits
+ * @katom:       true if the record refers to an atom
+ * @padding:     padding
+ *
+ * The layout is fixed as records are exported as-is through the
+ * mali_trace_raw debugfs file.
+ */
 struct kbase_trace {
-	struct timespec timestamp;
-	u32 thread_id;
-	u32 cpu;
-	void *ctx;
-	bool katom;
-	int atom_number;
+	u64 timestamp;
+	u64 ctx;
 	u64 atom_udata[2];
 	u64 gpu_addr;
-	unsigned long info_val;
+	u64 info_val;
+	u64 seq;
+	u32 thread_id;
+	u32 cpu;
+	s32 atom_number;
 	u8 code;
 	u8 jobslot;
 	u8 refcount;
 	u8 flags;
+	u8 katom;
+	u8 padding[7];
+};
+
+/**
+ * struct kbase_trace_cpu - per-CPU trace ring
+ * @next_in:   sequence number of the last record written
+ * @first_out: sequence number of the last record written when the ring was
+ *             cleared, dumping starts at the record following it
+ * @rbuf:      ring of records, indexed by sequence number
+ *
+ * Records are only written by the CPU owning the ring, so reserving a slot
+ * is a local increment and does not require a lock.
+ */
+struct kbase_trace_cpu {
+	local64_t next_in;
+	u64 first_out;
+	struct kbase_trace rbuf[KBASE_TRACE_SIZE];
 };
 
 /** Event IDs for the power management framework.
@@ -943,6 +1039,50 @@ struct kbase_mem_pool {
 	struct shrinker     reclaim;
 
 	struct kbase_mem_pool *next_pool;
+
+	/* NUMA node new pages are allocated from */
+	int                 node;
+
+	/* Pages spilled from other pools, waiting to be zeroed by
+	 * zero_thread. They are included in cur_size. */
+	struct list_head    dirty_list;
+	size_t              dirty_size;
+	size_t              dirty_wmark;
+	size_t              dirty_max;
+	struct task_struct  *zero_thread;
+	wait_queue_head_t   zero_wait;
+
+	/* Autotuning state, see kbase_mem_pool_tune(). nr_alloc counts the
+	 * pages requested from the pool since the last sample, target,
+	 * idle_periods and tune_link are protected by the tuner lock. */
+	atomic_t            nr_alloc;
+	size_t              target;
+	unsigned int        idle_periods;
+	struct list_head    tune_link;
+};
+
+/**
+ * struct kbase_mem_pool_tuner - Background resizing of the memory pools
+ * @lock:         Serializes the tuning works and changes of pool targets
+ * @work:         Periodic work sampling the demand on each pool and resizing
+ *                the pools to follow it
+ * @refill_work:  Work growing the pools back to their targets after a burst
+ * @armed:        Non-zero while @work is queued
+ * @queue_lock:   Protects @stopping and changes of @period_ms, so that the
+ *                works are not queued again once they have been cancelled
+ * @stopping:     Set when the autotuner is terminated
+ * @period_ms:    Sampling period in milliseconds, 0 disables autotuning
+ * @warmup_pages: Number of pages the pool of a new context is grown to
+ */
+struct kbase_mem_pool_tuner {
+	struct mutex        lock;
+	struct delayed_work work;
+	struct work_struct  refill_work;
+	atomic_t            armed;
+	spinlock_t          queue_lock;
+	bool                stopping;
+	unsigned int        period_ms;
+	size_t              warmup_pages;
 };
 
 
@@ -986,7 +1126,12 @@ struct kbase_device {
 
 	struct kbase_pm_device_data pm;
 	struct kbasep_js_device_data js_data;
-	struct kbase_mem_pool mem_pool;
+	/* One memory pool per NUMA node, indexed by node id */
+	struct kbase_mem_pool *mem_pools;
+	/* Node whose pool new contexts use, NUMA_NO_NODE for the node of the
+	 * task creating the context */
+	int mem_pool_node;
+	struct kbase_mem_pool_tuner mem_pool_tuner;
 	struct kbasep_mem_device memdev;
 	struct kbase_mmu_mode const *mmu_mode;
 
@@ -1067,14 +1212,16 @@ struct kbase_device {
 
 	struct kbase_vinstr_context *vinstr_ctx;
 
+	/* Job latency histograms of each job slot, collected while
+	 * latency_enabled is set */
+	struct kbase_latency latency_slot[BASE_JM_MAX_NR_SLOTS];
+	bool latency_enabled;
+
 	/*value to be written to the irq_throttle register each time an irq is served */
 	atomic_t irq_throttle_cycles;
 
 #if KBASE_TRACE_ENABLE
-	spinlock_t              trace_lock;
-	u16                     trace_first_out;
-	u16                     trace_next_in;
-	struct kbase_trace            *trace_rbuf;
+	struct kbase_trace_cpu        **trace_cpu;
 #endif
 
 	u32 reset_timeout_ms;
@@ -1247,6 +1394,10 @@ struct kbase_device {
 
 	/* Current serialization mode. See KBASE_SERIALIZE_* for details */
 	u8 serialize_jobs;
+
+	/* True while job-boundary hwcnt sampling is enabled. Protected by
+	 * hwaccess_lock. See kbase_vinstr_job_sample_enable() */
+	bool hwcnt_job_sample;
 };
 
 /**
@@ -1320,6 +1471,75 @@ enum kbase_context_flags {
 	KCTX_NO_IMPLICIT_SYNC = 1U << 10,
 };
 
+/**
+ * struct kbase_umm_cache - Cache of GPU mappings of imported dma-bufs
+ * @lock:         Protects @idle_list, @nr_idle, @nr_pages and @max_idle
+ * @idle_list:    Imported allocations which stay mapped on the GPU while no
+ *                atom uses them, most recently used first
+ * @nr_idle:      Number of allocations on @idle_list
+ * @nr_pages:     Number of pages mapped by the allocations on @idle_list
+ * @max_idle:     Max number of allocations kept on @idle_list, 0 disables
+ *                the cache
+ * @reclaim:      Shrinker dropping idle mappings under memory pressure
+ * @nr_maps:      Number of times an import was mapped on the GPU
+ * @nr_unmaps:    Number of times an import was unmapped from the GPU
+ * @nr_hits:      Number of times an idle mapping was reused
+ * @nr_evictions: Number of idle mappings dropped
+ */
+struct kbase_umm_cache {
+	struct mutex lock;
+	struct list_head idle_list;
+	unsigned int nr_idle;
+	size_t nr_pages;
+	unsigned int max_idle;
+	struct shrinker reclaim;
+	atomic_t nr_maps;
+	atomic_t nr_unmaps;
+	atomic_t nr_hits;
+	atomic_t nr_evictions;
+};
+
+/**
+ * struct kbase_user_buf_cache - Cache of pinned imported user buffers
+ * @lock:         Protects @idle_list, @nr_idle, @nr_pages and @budget
+ * @idle_list:    Imported user buffers which stay pinned and mapped on the
+ *                GPU while no atom uses them, most recently used first
+ * @nr_idle:      Number of allocations on @idle_list
+ * @nr_pages:     Number of pages pinned by the allocations on @idle_list
+ * @budget:       Max number of pages kept pinned on @idle_list, 0 disables
+ *                the cache
+ * @register_lock: Serializes registration of @notifier
+ * @mm:           Address space @notifier is registered with, or NULL. Only
+ *                buffers imported from it are cached.
+ * @notifier:     Drops idle buffers whose pages are unmapped or remapped
+ * @nr_pins:      Number of times a user buffer was pinned
+ * @nr_pinned_pages: Number of pages pinned
+ * @pin_ns:       Total time spent pinning and DMA mapping, in nanoseconds
+ * @nr_unpins:    Number of times a user buffer was unpinned
+ * @nr_hits:      Number of times an idle pinned buffer was reused
+ * @nr_evictions: Number of idle buffers dropped to stay within @budget
+ * @nr_invalidations: Number of idle buffers dropped by @notifier
+ */
+struct kbase_user_buf_cache {
+	struct mutex lock;
+	struct list_head idle_list;
+	unsigned int nr_idle;
+	size_t nr_pages;
+	size_t budget;
+	struct mutex register_lock;
+	struct mm_struct *mm;
+#ifdef CONFIG_MMU_NOTIFIER
+	struct mmu_notifier notifier;
+#endif
+	atomic_t nr_pins;
+	atomic64_t nr_pinned_pages;
+	atomic64_t pin_ns;
+	atomic_t nr_unpins;
+	atomic_t nr_hits;
+	atomic_t nr_evictions;
+	atomic_t nr_invalidations;
+};
+
 struct kbase_context {
 	struct file *filp;
 	struct kbase_device *kbdev;
@@ -1363,6 +1583,11 @@ struct kbase_context {
 	atomic_t used_pages;
 	atomic_t         nonmapped_pages;
 
+	/* Job latency histograms of the atoms of this context */
+	struct kbase_latency latency;
+
+	struct kbase_fault_stats fault_stats;
+
 	struct kbase_mem_pool mem_pool;
 
 	struct shrinker         reclaim;
@@ -1370,6 +1595,16 @@ struct kbase_context {
 
 	struct list_head waiting_soft_jobs;
 	spinlock_t waiting_soft_jobs_lock;
+	/* Waiting soft event and timeline jobs hashed by the address they
+	 * wait on, and how many there are (protected by waiting_soft_jobs_lock)
+	 */
+	struct hlist_head soft_event_waiters[1 << KBASEP_SOFT_EVENT_HASH_BITS];
+	unsigned int soft_event_nr_waiters;
+	/* Bumped, and timeline_wait woken, whenever the driver advances a
+	 * timeline of this context
+	 */
+	atomic_t timeline_seq;
+	wait_queue_head_t timeline_wait;
 #ifdef CONFIG_KDS
 	struct list_head waiting_kds_resource;
 #endif
@@ -1482,6 +1717,12 @@ struct kbase_context {
 	/* External sticky resource management */
 	struct list_head ext_res_meta_head;
 
+	/* Idle GPU mappings of imported dma-bufs */
+	struct kbase_umm_cache umm_cache;
+
+	/* Idle pinned imported user buffers */
+	struct kbase_user_buf_cache user_buf_cache;
+
 	/* Used to record that a drain was requested from atomic context */
 	atomic_t drain_pending;
 
@@ -27,6 +27,8 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/of_platform.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 
 #include <mali_kbase.h>
 #include <mali_kbase_defs.h>
@@ -276,6 +278,8 @@ void kbase_device_term(struct kbase_device *kbdev)
 
 	kbase_instr_backend_term(kbdev);
 
+	kbase_latency_term(kbdev);
+
 	kbasep_trace_term(kbdev);
 
 	kbase_device_all_as_term(kbdev);
@@ -376,31 +380,86 @@ void kbase_device_trace_register_access(struct kbase_context *kctx, enum kbase_r
  */
 #if KBASE_TRACE_ENABLE
 
+/* NOTE: Magic - 0x4252544b (KTRB in ASCII).
+ * Identifies the binary trace exported through the mali_trace_raw debugfs
+ * file. The version must be bumped whenever struct kbase_trace or the
+ * layout of the export changes.
+ */
+#define KBASE_TRACE_RAW_MAGIC   0x4252544b
+#define KBASE_TRACE_RAW_VERSION 2
+
+/**
+ * struct kbase_trace_raw_header - header of the binary trace export
+ * @magic:       KBASE_TRACE_RAW_MAGIC
+ * @version:     KBASE_TRACE_RAW_VERSION
+ * @record_size: size of a record, sizeof(struct kbase_trace)
+ * @nr_codes:    number of trace code names following the header
+ * @names_size:  size of the trace code names table, padded to 8 bytes
+ * @nr_records:  number of records following the names table
+ * @dropped:     number of records overwritten before they could be read
+ *
+ * The header is followed by the NUL terminated names of the trace codes,
+ * indexed by kbase_trace::code, and by the records ordered by timestamp.
+ */
+struct kbase_trace_raw_header {
+	u32 magic;
+	u16 version;
+	u16 record_size;
+	u32 nr_codes;
+	u32 names_size;
+	u32 nr_records;
+	u32 dropped;
+};
+
 static int kbasep_trace_init(struct kbase_device *kbdev)
 {
-	struct kbase_trace *rbuf;
+	unsigned int cpu;
 
-	rbuf = kmalloc_array(KBASE_TRACE_SIZE, sizeof(*rbuf), GFP_KERNEL);
+	kbdev->trace_cpu = kcalloc(nr_cpu_ids, sizeof(*kbdev->trace_cpu),
+			GFP_KERNEL);
+	if (!kbdev->trace_cpu)
+		return -ENOMEM;
 
-	if (!rbuf)
-		return -EINVAL;
+	for_each_possible_cpu(cpu) {
+		struct kbase_trace_cpu *tcpu;
+
+		tcpu = kzalloc_node(sizeof(*tcpu), GFP_KERNEL,
+				cpu_to_node(cpu));
+		if (!tcpu)
+			goto fail;
+
+		local64_set(&tcpu->next_in, 0);
+		kbdev->trace_cpu[cpu] = tcpu;
+	}
 
-	kbdev->trace_rbuf = rbuf;
-	spin_lock_init(&kbdev->trace_lock);
 	return 0;
+
+fail:
+	for_each_possible_cpu(cpu)
+		kfree(kbdev->trace_cpu[cpu]);
+	kfree(kbdev->trace_cpu);
+	kbdev->trace_cpu = NULL;
+	return -ENOMEM;
 }
 
 static void kbasep_trace_term(struct kbase_device *kbdev)
 {
-	kfree(kbdev->trace_rbuf);
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(kbdev->trace_cpu[cpu]);
+	kfree(kbdev->trace_cpu);
+	kbdev->trace_cpu = NULL;
 }
 
 static void kbasep_trace_format_msg(struct kbase_trace *trace_msg, char *buffer, int len)
 {
 	s32 written = 0;
+	u32 nsec;
+	u64 sec = div_u64_rem(trace_msg->timestamp, NSEC_PER_SEC, &nsec);
 
 	/* Initial part of message */
-	written += MAX(snprintf(buffer + written, MAX(len - written, 0), "%d.%.6d,%d,%d,%s,%p,", (int)trace_msg->timestamp.tv_sec, (int)(trace_msg->timestamp.tv_nsec / 1000), trace_msg->thread_id, trace_msg->cpu, kbasep_trace_code_string[trace_msg->code], trace_msg->ctx), 0);
+	written += MAX(snprintf(buffer + written, MAX(len - written, 0), "%d.%.6d,%d,%d,%s,%p,", (int)sec, (int)(nsec / 1000), trace_msg->thread_id, trace_msg->cpu, kbasep_trace_code_string[trace_msg->code], (void *)(uintptr_t)trace_msg->ctx), 0);
 
 	if (trace_msg->katom)
 		written += MAX(snprintf(buffer + written, MAX(len - written, 0), "atom %d (ud: 0x%llx 0x%llx)", trace_msg->atom_number, trace_msg->atom_udata[0], trace_msg->atom_udata[1]), 0);
@@ -421,7 +480,7 @@ static void kbasep_trace_format_msg(struct kbase_trace *trace_msg, char *buffer,
 	written += MAX(snprintf(buffer + written, MAX(len - written, 0), ","), 0);
 
 	/* Rest of message */
-	written += MAX(snprintf(buffer + written, MAX(len - written, 0), "0x%.8lx", trace_msg->info_val), 0);
+	written += MAX(snprintf(buffer + written, MAX(len - written, 0), "0x%.8llx", trace_msg->info_val), 0);
 }
 
 static void kbasep_trace_dump_msg(struct kbase_device *kbdev, struct kbase_trace *trace_msg)
@@ -434,24 +493,36 @@ static void kbasep_trace_dump_msg(struct kbase_device *kbdev, struct kbase_trace
 
 void kbasep_trace_add(struct kbase_device *kbdev, enum kbase_trace_code code, void *ctx, struct kbase_jd_atom *katom, u64 gpu_addr, u8 flags, int refcount, int jobslot, unsigned long info_val)
 {
-	unsigned long irqflags;
+	struct kbase_trace_cpu *tcpu;
 	struct kbase_trace *trace_msg;
+	unsigned int cpu;
+	u64 seq;
 
-	spin_lock_irqsave(&kbdev->trace_lock, irqflags);
+	/* Records are only written by the CPU owning the ring. Interrupts
+	 * taken while the record is filled reserve slots of their own. */
+	cpu = get_cpu();
+	tcpu = kbdev->trace_cpu[cpu];
+	seq = local64_inc_return(&tcpu->next_in);
+	trace_msg = &tcpu->rbuf[seq & KBASE_TRACE_MASK];
 
-	trace_msg = &kbdev->trace_rbuf[kbdev->trace_next_in];
+	/* Invalidate the slot before overwriting it, so that readers can
+	 * detect a record torn by a concurrent write. */
+	WRITE_ONCE(trace_msg->seq, 0);
+	smp_wmb();
 
 	/* Fill the message */
 	trace_msg->thread_id = task_pid_nr(current);
-	trace_msg->cpu = task_cpu(current);
-
-	getnstimeofday(&trace_msg->timestamp);
+	trace_msg->cpu = cpu;
+	trace_msg->timestamp = ktime_to_ns(ktime_get());
 
 	trace_msg->code = code;
-	trace_msg->ctx = ctx;
+	trace_msg->ctx = (u64)(uintptr_t)ctx;
 
 	if (NULL == katom) {
 		trace_msg->katom = false;
+		trace_msg->atom_number = 0;
+		trace_msg->atom_udata[0] = 0;
+		trace_msg->atom_udata[1] = 0;
 	} else {
 		trace_msg->katom = true;
 		trace_msg->atom_number = kbase_jd_atom_id(katom->kctx, katom);
@@ -465,46 +536,94 @@ void kbasep_trace_add(struct kbase_device *kbdev, enum kbase_trace_code code, vo
 	trace_msg->info_val = info_val;
 	trace_msg->flags = flags;
 
-	/* Update the ringbuffer indices */
-	kbdev->trace_next_in = (kbdev->trace_next_in + 1) & KBASE_TRACE_MASK;
-	if (kbdev->trace_next_in == kbdev->trace_first_out)
-		kbdev->trace_first_out = (kbdev->trace_first_out + 1) & KBASE_TRACE_MASK;
+	/* Publish the record */
+	smp_wmb();
+	WRITE_ONCE(trace_msg->seq, seq);
 
-	/* Done */
+	put_cpu();
+}
 
-	spin_unlock_irqrestore(&kbdev->trace_lock, irqflags);
+/**
+ * kbasep_trace_read_msg - copy a record out of a trace ring
+ * @tcpu:      trace ring
+ * @seq:       sequence number of the record
+ * @trace_msg: destination of the copy
+ *
+ * Return: true if the record was copied, false if it was overwritten or is
+ *         being written
+ */
+static bool kbasep_trace_read_msg(struct kbase_trace_cpu *tcpu, u64 seq,
+		struct kbase_trace *trace_msg)
+{
+	struct kbase_trace *slot = &tcpu->rbuf[seq & KBASE_TRACE_MASK];
+
+	if (READ_ONCE(slot->seq) != seq)
+		return false;
+	smp_rmb();
+	*trace_msg = *slot;
+	smp_rmb();
+
+	return READ_ONCE(slot->seq) == seq;
+}
+
+/**
+ * kbasep_trace_ring_range - get the range of records to dump from a ring
+ * @tcpu:    trace ring
+ * @start:   sequence number of the first record to dump
+ * @dropped: incremented by the number of records overwritten since the
+ *           ring was last cleared
+ *
+ * Return: sequence number of the last record to dump
+ */
+static u64 kbasep_trace_ring_range(struct kbase_trace_cpu *tcpu, u64 *start,
+		u32 *dropped)
+{
+	u64 end = local64_read(&tcpu->next_in);
+
+	*start = READ_ONCE(tcpu->first_out) + 1;
+	if (end + 1 - *start > KBASE_TRACE_SIZE) {
+		*dropped += (u32)(end + 1 - *start - KBASE_TRACE_SIZE);
+		*start = end + 1 - KBASE_TRACE_SIZE;
+	}
+
+	return end;
 }
 
 void kbasep_trace_clear(struct kbase_device *kbdev)
 {
-	unsigned long flags;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct kbase_trace_cpu *tcpu = kbdev->trace_cpu[cpu];
 
-	spin_lock_irqsave(&kbdev->trace_lock, flags);
-	kbdev->trace_first_out = kbdev->trace_next_in;
-	spin_unlock_irqrestore(&kbdev->trace_lock, flags);
+		WRITE_ONCE(tcpu->first_out, local64_read(&tcpu->next_in));
+	}
 }
 
 void kbasep_trace_dump(struct kbase_device *kbdev)
 {
-	unsigned long flags;
-	u32 start;
-	u32 end;
+	unsigned int cpu;
+	u32 dropped = 0;
 
 	dev_dbg(kbdev->dev, "Dumping trace:\nsecs,nthread,cpu,code,ctx,katom,gpu_addr,jobslot,refcount,info_val");
-	spin_lock_irqsave(&kbdev->trace_lock, flags);
-	start = kbdev->trace_first_out;
-	end = kbdev->trace_next_in;
 
-	while (start != end) {
-		struct kbase_trace *trace_msg = &kbdev->trace_rbuf[start];
-
-		kbasep_trace_dump_msg(kbdev, trace_msg);
-
-		start = (start + 1) & KBASE_TRACE_MASK;
+	/* Rings are dumped one CPU after the other: this may be called from
+	 * atomic context, where the records cannot be gathered and sorted. */
+	for_each_possible_cpu(cpu) {
+		struct kbase_trace_cpu *tcpu = kbdev->trace_cpu[cpu];
+		struct kbase_trace trace_msg;
+		u64 start;
+		u64 end;
+
+		end = kbasep_trace_ring_range(tcpu, &start, &dropped);
+		for (; start != end + 1; start++) {
+			if (kbasep_trace_read_msg(tcpu, start, &trace_msg))
+				kbasep_trace_dump_msg(kbdev, &trace_msg);
+			else
+				dropped++;
+		}
 	}
-	dev_dbg(kbdev->dev, "TRACE_END");
-
-	spin_unlock_irqrestore(&kbdev->trace_lock, flags);
+	dev_dbg(kbdev->dev, "TRACE_END (%u dropped)", dropped);
 
 	KBASE_TRACE_CLEAR(kbdev);
 }
@@ -517,27 +636,64 @@ static void kbasep_trace_hook_wrapper(void *param)
 }
 
 #ifdef CONFIG_DEBUG_FS
+static int kbasep_trace_cmp(const void *a, const void *b)
+{
+	const struct kbase_trace *ta = a;
+	const struct kbase_trace *tb = b;
+
+	if (ta->timestamp < tb->timestamp)
+		return -1;
+	return ta->timestamp > tb->timestamp;
+}
+
+/**
+ * kbasep_trace_snapshot - gather the records of all trace rings
+ * @kbdev:   kbase device
+ * @buf:     destination of the records, must hold KBASE_TRACE_SIZE records
+ *           per possible CPU
+ * @dropped: set to the number of records that could not be read
+ *
+ * Return: number of records copied to @buf, ordered by timestamp
+ */
+static u32 kbasep_trace_snapshot(struct kbase_device *kbdev,
+		struct kbase_trace *buf, u32 *dropped)
+{
+	unsigned int cpu;
+	u32 count = 0;
+
+	*dropped = 0;
+	for_each_possible_cpu(cpu) {
+		struct kbase_trace_cpu *tcpu = kbdev->trace_cpu[cpu];
+		u64 start;
+		u64 end;
+
+		end = kbasep_trace_ring_range(tcpu, &start, dropped);
+		for (; start != end + 1; start++) {
+			if (kbasep_trace_read_msg(tcpu, start, &buf[count]))
+				count++;
+			else
+				(*dropped)++;
+		}
+	}
+
+	sort(buf, count, sizeof(*buf), kbasep_trace_cmp, NULL);
+
+	return count;
+}
+
 struct trace_seq_state {
-	struct kbase_trace trace_buf[KBASE_TRACE_SIZE];
-	u32 start;
-	u32 end;
+	struct kbase_trace *trace_buf;
+	u32 count;
 };
 
 static void *kbasep_trace_seq_start(struct seq_file *s, loff_t *pos)
 {
 	struct trace_seq_state *state = s->private;
-	int i;
 
-	if (*pos > KBASE_TRACE_SIZE)
+	if (*pos >= state->count)
 		return NULL;
-	i = state->start + *pos;
-	if ((state->end >= state->start && i >= state->end) ||
-			i >= state->end + KBASE_TRACE_SIZE)
-		return NULL;
-
-	i &= KBASE_TRACE_MASK;
 
-	return &state->trace_buf[i];
+	return &state->trace_buf[*pos];
 }
 
 static void kbasep_trace_seq_stop(struct seq_file *s, void *data)
@@ -547,15 +703,13 @@ static void kbasep_trace_seq_stop(struct seq_file *s, void *data)
 static void *kbasep_trace_seq_next(struct seq_file *s, void *data, loff_t *pos)
 {
 	struct trace_seq_state *state = s->private;
-	int i;
 
 	(*pos)++;
 
-	i = (state->start + *pos) & KBASE_TRACE_MASK;
-	if (i == state->end)
+	if (*pos >= state->count)
 		return NULL;
 
-	return &state->trace_buf[i];
+	return &state->trace_buf[*pos];
 }
 
 static int kbasep_trace_seq_show(struct seq_file *s, void *data)
@@ -578,28 +732,117 @@ static const struct seq_operations kbasep_trace_seq_ops = {
 static int kbasep_trace_debugfs_open(struct inode *inode, struct file *file)
 {
 	struct kbase_device *kbdev = inode->i_private;
-	unsigned long flags;
-
 	struct trace_seq_state *state;
+	u32 dropped;
 
 	state = __seq_open_private(file, &kbasep_trace_seq_ops, sizeof(*state));
 	if (!state)
 		return -ENOMEM;
 
-	spin_lock_irqsave(&kbdev->trace_lock, flags);
-	state->start = kbdev->trace_first_out;
-	state->end = kbdev->trace_next_in;
-	memcpy(state->trace_buf, kbdev->trace_rbuf, sizeof(state->trace_buf));
-	spin_unlock_irqrestore(&kbdev->trace_lock, flags);
+	state->trace_buf = vmalloc(nr_cpu_ids * KBASE_TRACE_SIZE *
+			sizeof(*state->trace_buf));
+	if (!state->trace_buf) {
+		seq_release_private(inode, file);
+		return -ENOMEM;
+	}
+
+	state->count = kbasep_trace_snapshot(kbdev, state->trace_buf, &dropped);
 
 	return 0;
 }
 
+static int kbasep_trace_debugfs_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *s = file->private_data;
+	struct trace_seq_state *state = s->private;
+
+	vfree(state->trace_buf);
+
+	return seq_release_private(inode, file);
+}
+
 static const struct file_operations kbasep_trace_debugfs_fops = {
 	.open = kbasep_trace_debugfs_open,
 	.read = seq_read,
 	.llseek = seq_lseek,
-	.release = seq_release_private,
+	.release = kbasep_trace_debugfs_release,
+};
+
+/**
+ * struct kbasep_trace_raw - binary trace export
+ * @size: size of @data in bytes
+ * @data: header, trace code names and records
+ */
+struct kbasep_trace_raw {
+	size_t size;
+	char data[];
+};
+
+static int kbasep_trace_raw_debugfs_open(struct inode *inode,
+		struct file *file)
+{
+	struct kbase_device *kbdev = inode->i_private;
+	struct kbase_trace_raw_header *header;
+	struct kbasep_trace_raw *raw;
+	size_t names_size = 0;
+	size_t size;
+	char *names;
+	u32 i;
+
+	for (i = 0; i < KBASE_TRACE_CODE_COUNT; i++)
+		names_size += strlen(kbasep_trace_code_string[i]) + 1;
+	names_size = ALIGN(names_size, sizeof(u64));
+
+	size = sizeof(*header) + names_size +
+		nr_cpu_ids * KBASE_TRACE_SIZE * sizeof(struct kbase_trace);
+	raw = vzalloc(sizeof(*raw) + size);
+	if (!raw)
+		return -ENOMEM;
+
+	header = (struct kbase_trace_raw_header *)raw->data;
+	header->magic = KBASE_TRACE_RAW_MAGIC;
+	header->version = KBASE_TRACE_RAW_VERSION;
+	header->record_size = sizeof(struct kbase_trace);
+	header->nr_codes = KBASE_TRACE_CODE_COUNT;
+	header->names_size = names_size;
+
+	names = raw->data + sizeof(*header);
+	for (i = 0; i < KBASE_TRACE_CODE_COUNT; i++)
+		names += strlen(strcpy(names, kbasep_trace_code_string[i])) + 1;
+
+	header->nr_records = kbasep_trace_snapshot(kbdev,
+			(struct kbase_trace *)(raw->data + sizeof(*header) +
+				names_size),
+			&header->dropped);
+
+	raw->size = sizeof(*header) + names_size +
+		header->nr_records * sizeof(struct kbase_trace);
+	file->private_data = raw;
+
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t kbasep_trace_raw_debugfs_read(struct file *file,
+		char __user *buf, size_t len, loff_t *ppos)
+{
+	struct kbasep_trace_raw *raw = file->private_data;
+
+	return simple_read_from_buffer(buf, len, ppos, raw->data, raw->size);
+}
+
+static int kbasep_trace_raw_debugfs_release(struct inode *inode,
+		struct file *file)
+{
+	vfree(file->private_data);
+
+	return 0;
+}
+
+static const struct file_operations kbasep_trace_raw_debugfs_fops = {
+	.open = kbasep_trace_raw_debugfs_open,
+	.read = kbasep_trace_raw_debugfs_read,
+	.llseek = no_llseek,
+	.release = kbasep_trace_raw_debugfs_release,
 };
 
 void kbasep_trace_debugfs_init(struct kbase_device *kbdev)
@@ -607,6 +850,9 @@ void kbasep_trace_debugfs_init(struct kbase_device *kbdev)
 	debugfs_create_file("mali_trace", S_IRUGO,
 			kbdev->mali_debugfs_directory, kbdev,
 			&kbasep_trace_debugfs_fops);
+	debugfs_create_file("mali_trace_raw", S_IRUSR,
+			kbdev->mali_debugfs_directory, kbdev,
+			&kbasep_trace_raw_debugfs_fops);
 }
 
 #else
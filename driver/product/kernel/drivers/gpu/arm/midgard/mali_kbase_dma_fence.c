@@ -23,6 +23,7 @@
 
 #include <linux/atomic.h>
 #include <linux/fence.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/lockdep.h>
 #include <linux/mutex.h>
@@ -33,10 +34,23 @@
 #include <linux/ww_mutex.h>
 
 #include <mali_kbase.h>
+#include <mali_kbase_tlstream.h>
 
 
-/* Spin lock protecting all Mali fences as fence->lock. */
-static DEFINE_SPINLOCK(kbase_dma_fence_lock);
+/**
+ * struct kbase_dma_fence - Mali fence with its own lock
+ * @base: the fence, must be first as the fence core frees it with kfree_rcu()
+ * @lock: fence->lock of @base
+ *
+ * Each fence has its own lock rather than all Mali fences sharing one, so
+ * signalling and callback handling on unrelated fences do not contend. The
+ * lock cannot live in the context, other drivers may still use a fence from
+ * a reservation object after the context that created it is gone.
+ */
+struct kbase_dma_fence {
+	struct fence base;
+	spinlock_t lock;
+};
 
 static void
 kbase_dma_fence_work(struct work_struct *pwork);
@@ -95,19 +109,20 @@ static const struct fence_ops kbase_dma_fence_ops = {
 static struct fence *
 kbase_dma_fence_new(unsigned int context, unsigned int seqno)
 {
-	struct fence *fence;
+	struct kbase_dma_fence *kfence;
 
-	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
-	if (!fence)
+	kfence = kzalloc(sizeof(*kfence), GFP_KERNEL);
+	if (!kfence)
 		return NULL;
 
-	fence_init(fence,
+	spin_lock_init(&kfence->lock);
+	fence_init(&kfence->base,
 		   &kbase_dma_fence_ops,
-		   &kbase_dma_fence_lock,
+		   &kfence->lock,
 		   context,
 		   seqno);
 
-	return fence;
+	return &kfence->base;
 }
 
 static int
@@ -295,6 +310,9 @@ kbase_dma_fence_work(struct work_struct *pwork)
 
 	atomic_set(&katom->dma_fence.dep_count, -1);
 
+	KBASE_TLSTREAM_AUX_FENCE_WAIT(katom, ktime_to_ns(ktime_sub(ktime_get(),
+			katom->dma_fence.wait_start)));
+
 	/* Remove atom from list of dma-fence waiting atoms. */
 	kbase_dma_fence_waiters_remove(katom);
 	/* Cleanup callbacks. */
@@ -335,6 +353,10 @@ kbase_dma_fence_add_callback(struct kbase_jd_atom *katom,
 	int err = 0;
 	struct kbase_dma_fence_cb *kbase_fence_cb;
 
+	/* Skip fences which have already signaled without allocating */
+	if (fence_is_signaled(fence))
+		return 0;
+
 	kbase_fence_cb = kmalloc(sizeof(*kbase_fence_cb), GFP_KERNEL);
 	if (!kbase_fence_cb)
 		return -ENOMEM;
@@ -537,6 +559,7 @@ end:
 			/* Add katom to the list of dma-buf fence waiting atoms
 			 * only if it is still waiting.
 			 */
+			katom->dma_fence.wait_start = ktime_get();
 			kbase_dma_fence_waiters_add(katom);
 		}
 	} else {
@@ -87,6 +87,7 @@ int kbase_event_dequeue(struct kbase_context *ctx, struct base_jd_event_v2 *ueve
 	mutex_unlock(&ctx->event_mutex);
 
 	dev_dbg(ctx->kbdev->dev, "event dequeuing %p\n", (void *)atom);
+	kbase_latency_atom_stage(atom, KBASE_LATENCY_EVENT);
 	uevent->event_code = atom->event_code;
 	uevent->atom_number = (atom - ctx->jctx.atoms);
 
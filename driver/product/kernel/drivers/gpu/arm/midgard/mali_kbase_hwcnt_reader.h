@@ -31,6 +31,7 @@
 #define KBASE_HWCNT_READER_SET_INTERVAL    _IOW(KBASE_HWCNT_READER, 0x30, u32)
 #define KBASE_HWCNT_READER_ENABLE_EVENT    _IOW(KBASE_HWCNT_READER, 0x40, u32)
 #define KBASE_HWCNT_READER_DISABLE_EVENT   _IOW(KBASE_HWCNT_READER, 0x41, u32)
+#define KBASE_HWCNT_READER_SET_MODE        _IOW(KBASE_HWCNT_READER, 0x50, u32)
 #define KBASE_HWCNT_READER_GET_API_VERSION _IOW(KBASE_HWCNT_READER, 0xFF, u32)
 
 /**
@@ -62,5 +63,99 @@ enum base_hwcnt_reader_event {
 	BASE_HWCNT_READER_EVENT_COUNT
 };
 
+/**
+ * enum base_hwcnt_reader_mode - hwcnt reader sample buffer formats
+ * @BASE_HWCNT_READER_MODE_COMPACT: sample buffers start with a block map and
+ *                                  only contain counters of enabled blocks
+ * @BASE_HWCNT_READER_MODE_DELTA:   in compact mode, counters of each block
+ *                                  are the difference from the previous
+ *                                  sample, and blocks that did not change are
+ *                                  omitted
+ *
+ * Modes are bit flags passed to KBASE_HWCNT_READER_SET_MODE. When no flag is
+ * set, sample buffers hold the full hardware counter dump. The mode is also
+ * recorded in the block map so each sample buffer describes itself.
+ */
+enum base_hwcnt_reader_mode {
+	BASE_HWCNT_READER_MODE_COMPACT = (1 << 0),
+	BASE_HWCNT_READER_MODE_DELTA   = (1 << 1)
+};
+
+/**
+ * enum base_hwcnt_reader_block_type - type of hardware counter block
+ * @BASE_HWCNT_READER_BLOCK_JM:       job manager block
+ * @BASE_HWCNT_READER_BLOCK_TILER:    tiler block
+ * @BASE_HWCNT_READER_BLOCK_MMU_L2:   MMU/L2 cache block
+ * @BASE_HWCNT_READER_BLOCK_SHADER:   shader core block
+ * @BASE_HWCNT_READER_BLOCK_RESERVED: block not backed by hardware
+ */
+enum base_hwcnt_reader_block_type {
+	BASE_HWCNT_READER_BLOCK_JM,
+	BASE_HWCNT_READER_BLOCK_TILER,
+	BASE_HWCNT_READER_BLOCK_MMU_L2,
+	BASE_HWCNT_READER_BLOCK_SHADER,
+	BASE_HWCNT_READER_BLOCK_RESERVED
+};
+
+/**
+ * enum base_hwcnt_reader_block_state - state of a block in a compact sample
+ * @BASE_HWCNT_READER_BLOCK_ABSENT:    no counters enabled, no payload
+ * @BASE_HWCNT_READER_BLOCK_PRESENT:   counters follow in the payload
+ * @BASE_HWCNT_READER_BLOCK_UNCHANGED: delta mode only, counters are the same
+ *                                     as in the previous sample, no payload
+ */
+enum base_hwcnt_reader_block_state {
+	BASE_HWCNT_READER_BLOCK_ABSENT,
+	BASE_HWCNT_READER_BLOCK_PRESENT,
+	BASE_HWCNT_READER_BLOCK_UNCHANGED
+};
+
+/* Number of counters in the payload of one block. The 16 bytes block header
+ * of the hardware dump is replaced by the block descriptor. */
+#define BASE_HWCNT_READER_BLOCK_PAYLOAD_CNT 60
+
+/**
+ * struct kbase_hwcnt_reader_block_map - header of a compact sample buffer
+ * @nr_blocks:   number of block descriptors following this header, equal to
+ *               the number of blocks in the full hardware counter dump
+ * @nr_payloads: number of block payloads following the block descriptors
+ * @mode:        mode the sample was produced with, see
+ *               enum base_hwcnt_reader_mode
+ * @reserved:    reserved, zero
+ *
+ * A compact sample buffer contains this header, @nr_blocks block descriptors
+ * in hardware dump order, then @nr_payloads payloads of
+ * BASE_HWCNT_READER_BLOCK_PAYLOAD_CNT u32 counters, one for each block in
+ * BASE_HWCNT_READER_BLOCK_PRESENT state, in the same order. A compact sample
+ * never exceeds the size returned by KBASE_HWCNT_READER_GET_BUFFER_SIZE.
+ *
+ * In delta mode, the payload counters must be added (modulo 2^32) to the
+ * counters of the same block in the previous sample, and unchanged blocks
+ * keep the counters of the previous sample. The previous sample of the first
+ * sample after KBASE_HWCNT_READER_SET_MODE is all zeros.
+ */
+struct kbase_hwcnt_reader_block_map {
+	u32 nr_blocks;
+	u32 nr_payloads;
+	u32 mode;
+	u32 reserved;
+};
+
+/**
+ * struct kbase_hwcnt_reader_block_desc - description of a block in a compact
+ *                                        sample buffer
+ * @type:        type of block, see enum base_hwcnt_reader_block_type
+ * @state:       state of block, see enum base_hwcnt_reader_block_state
+ * @reserved:    reserved, zero
+ * @enable_mask: counters enabled in the block, one bit per group of four
+ *               counters, as in the hardware block header
+ */
+struct kbase_hwcnt_reader_block_desc {
+	u8  type;
+	u8  state;
+	u16 reserved;
+	u32 enable_mask;
+};
+
 #endif /* _KBASE_HWCNT_READER_H_ */
 
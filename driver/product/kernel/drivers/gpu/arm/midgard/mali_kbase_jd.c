@@ -34,6 +34,11 @@
 #include <mali_kbase_tlstream.h>
 
 #include "mali_kbase_dma_fence.h"
+#ifdef CONFIG_SYNC
+#include <linux/syscalls.h>
+#include "sync.h"
+#include "mali_kbase_sync.h"
+#endif
 
 #define beenthere(kctx, f, a...)  dev_dbg(kctx->kbdev->dev, "%s:" f, __func__, ##a)
 
@@ -770,6 +775,68 @@ static void jd_try_submitting_deps(struct list_head *out_list,
 	}
 }
 
+#ifdef CONFIG_SYNC
+/*
+ * Create the fence exported by a BASE_JD_REQ_FENCE_EXPORT atom. Its
+ * struct base_fence follows the external resources in extres_list, the new
+ * fence fd is written back there.
+ */
+static int kbase_jd_fence_export_setup(struct kbase_jd_atom *katom,
+		const struct base_jd_atom_v2 *user_atom)
+{
+	struct base_external_resource __user *extres;
+	struct base_fence __user *ufence;
+	struct base_fence fence;
+	int fd;
+
+	if (katom->core_req & BASE_JD_REQ_SOFT_JOB)
+		return -EINVAL;
+
+	extres = get_compat_pointer(katom->kctx, &user_atom->extres_list);
+	if (!extres)
+		return -EINVAL;
+
+	/* A base_fence takes the place of one more external resource */
+	BUILD_BUG_ON(sizeof(struct base_fence) !=
+			sizeof(struct base_external_resource));
+	ufence = (struct base_fence __user *)(extres + user_atom->nr_extres);
+
+	if (copy_from_user(&fence, ufence, sizeof(fence)))
+		return -EINVAL;
+
+	fd = kbase_stream_create_fence(fence.basep.stream_fd);
+	if (fd < 0)
+		return -EINVAL;
+
+	katom->fence = sync_fence_fdget(fd);
+	if (!katom->fence) {
+		/* Userspace closed it already, nothing to clean up */
+		return -EINVAL;
+	}
+
+	fence.basep.fd = fd;
+	if (copy_to_user(ufence, &fence, sizeof(fence))) {
+		sync_fence_put(katom->fence);
+		katom->fence = NULL;
+		sys_close(fd);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void kbase_jd_fence_export_signal(struct kbase_jd_atom *katom)
+{
+	if (!katom->fence)
+		return;
+
+	kbase_sync_fence_trigger(katom->fence,
+			katom->event_code == BASE_JD_EVENT_DONE ? 0 : -EFAULT);
+	sync_fence_put(katom->fence);
+	katom->fence = NULL;
+}
+#endif /* CONFIG_SYNC */
+
 /*
  * Perform the necessary handling of an atom that has finished running
  * on the GPU.
@@ -838,6 +905,11 @@ bool jd_done_nolock(struct kbase_jd_atom *katom,
 		if (katom->core_req & BASE_JD_REQ_EXTERNAL_RESOURCES)
 			kbase_jd_post_external_resources(katom);
 
+#ifdef CONFIG_SYNC
+		if (katom->core_req & BASE_JD_REQ_FENCE_EXPORT)
+			kbase_jd_fence_export_signal(katom);
+#endif
+
 		while (!list_empty(&runnable_jobs)) {
 			struct kbase_jd_atom *node;
 
@@ -976,8 +1048,10 @@ bool jd_submit_atom(struct kbase_context *kctx, const struct base_jd_atom_v2 *us
 	jctx->job_nr++;
 
 	katom->start_timestamp.tv64 = 0;
+	katom->latency_ts = 0;
 	katom->udata = user_atom->udata;
 	katom->kctx = kctx;
+	kbase_latency_atom_submit(katom);
 	katom->nr_extres = user_atom->nr_extres;
 	katom->extres = NULL;
 	katom->device_nr = user_atom->device_nr;
@@ -1010,6 +1084,31 @@ bool jd_submit_atom(struct kbase_context *kctx, const struct base_jd_atom_v2 *us
 	atomic_set(&katom->dma_fence.dep_count, -1);
 #endif
 
+	/* Export the fence first, so it is signalled however the atom ends */
+	if (katom->core_req & BASE_JD_REQ_FENCE_EXPORT) {
+		int err = -EINVAL;
+
+#ifdef CONFIG_SYNC
+		katom->fence = NULL;
+		err = kbase_jd_fence_export_setup(katom, user_atom);
+#endif
+		if (err) {
+			katom->event_code = BASE_JD_EVENT_JOB_INVALID;
+			katom->core_req &= ~BASE_JD_REQ_FENCE_EXPORT;
+			katom->status = KBASE_JD_ATOM_STATE_COMPLETED;
+
+			KBASE_TLSTREAM_TL_NEW_ATOM(
+					katom,
+					kbase_jd_atom_id(kctx, katom));
+			KBASE_TLSTREAM_TL_RET_ATOM_CTX(katom, kctx);
+			KBASE_TLSTREAM_TL_ATTRIB_ATOM_STATE(katom,
+					TL_ATOM_STATE_IDLE);
+
+			ret = jd_done_nolock(katom, NULL);
+			goto out;
+		}
+	}
+
 	/* Don't do anything if there is a mess up with dependencies.
 	   This is done in a separate cycle to check both the dependencies at ones, otherwise
 	   it will be extra complexity to deal with 1st dependency ( just added to the list )
@@ -1473,6 +1572,8 @@ void kbase_jd_done_worker(struct work_struct *data)
 
 	KBASE_TRACE_ADD(kbdev, JD_DONE_WORKER, kctx, katom, katom->jc, 0);
 
+	kbase_latency_atom_stage(katom, KBASE_LATENCY_WORKER);
+
 	kbase_backend_complete_wq(kbdev, katom);
 
 	/*
@@ -62,6 +62,13 @@ static void kbase_jd_debugfs_fence_info(struct kbase_jd_atom *atom,
 			 fence, status);
 		break;
 	default:
+		if (!fence || (atom->core_req & BASE_JD_REQ_SOFT_JOB))
+			break;
+
+		status = kbase_fence_get_status(fence);
+
+		seq_printf(sfile, "Se([%p]%d) ",
+			 fence, status);
 		break;
 	}
 #endif /* CONFIG_SYNC */
@@ -0,0 +1,310 @@
+/*
+ *
+ * (C) COPYRIGHT 2017 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+/*
+ * Job latency histograms
+ */
+
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <mali_kbase.h>
+#include <mali_kbase_latency.h>
+
+/* Enabled while collection is turned on for at least one device. */
+struct static_key kbase_latency_key = STATIC_KEY_INIT_FALSE;
+
+/* Serializes changes of kbase_device::latency_enabled. */
+static DEFINE_MUTEX(kbase_latency_lock);
+
+void kbase_latency_hist_add(struct kbase_latency_hist *hist, u64 ns)
+{
+	unsigned int bucket = min_t(unsigned int, fls64(ns),
+			KBASE_LATENCY_NR_BUCKETS - 1);
+
+	atomic_inc(&hist->bucket[bucket]);
+	atomic64_add(ns, &hist->sum_ns);
+}
+
+void kbase_latency_hist_reset(struct kbase_latency_hist *hist)
+{
+	unsigned int i;
+
+	for (i = 0; i < KBASE_LATENCY_NR_BUCKETS; i++)
+		atomic_set(&hist->bucket[i], 0);
+	atomic64_set(&hist->sum_ns, 0);
+}
+
+static void kbasep_latency_reset(struct kbase_latency *latency)
+{
+	unsigned int i;
+
+	for (i = 0; i < KBASE_LATENCY_STAGE_COUNT; i++)
+		kbase_latency_hist_reset(&latency->stage[i]);
+}
+
+void kbasep_latency_atom_submit(struct kbase_jd_atom *katom)
+{
+	/* The static key is shared by all devices, only track atoms of the
+	 * devices collecting histograms. */
+	if (!READ_ONCE(katom->kctx->kbdev->latency_enabled)) {
+		katom->latency_ts = 0;
+		return;
+	}
+
+	katom->latency_ts = ktime_to_ns(ktime_get());
+	katom->latency_next = KBASE_LATENCY_DEP_RESOLVED;
+}
+
+void kbasep_latency_atom_stage(struct kbase_jd_atom *katom,
+		enum kbase_latency_stage stage)
+{
+	struct kbase_context *kctx = katom->kctx;
+	u64 now;
+
+	if (!katom->latency_ts)
+		return;
+
+	/* Stop tracking atoms once the device stops collecting histograms. */
+	if (!READ_ONCE(kctx->kbdev->latency_enabled)) {
+		katom->latency_ts = 0;
+		return;
+	}
+
+	/* Stages are expected in order, except for the submission to the
+	 * hardware which is repeated when an atom is stopped and run again.
+	 * Atoms taking any other path, e.g. soft jobs or atoms cancelled
+	 * before running, are no longer tracked. */
+	if (stage != katom->latency_next &&
+			!(stage == KBASE_LATENCY_HW_START &&
+			katom->latency_next > KBASE_LATENCY_DEP_RESOLVED)) {
+		katom->latency_ts = 0;
+		return;
+	}
+
+	now = ktime_to_ns(ktime_get());
+	kbase_latency_hist_add(&kctx->latency.stage[stage],
+			now - katom->latency_ts);
+	kbase_latency_hist_add(
+			&kctx->kbdev->latency_slot[katom->slot_nr].stage[stage],
+			now - katom->latency_ts);
+
+	katom->latency_ts = now;
+	katom->latency_next = stage + 1;
+}
+
+void kbase_latency_term(struct kbase_device *kbdev)
+{
+	mutex_lock(&kbase_latency_lock);
+	if (kbdev->latency_enabled) {
+		static_key_slow_dec(&kbase_latency_key);
+		WRITE_ONCE(kbdev->latency_enabled, false);
+	}
+	mutex_unlock(&kbase_latency_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static const char * const kbasep_latency_stage_name[] = {
+	"dep_resolved",
+	"hw_start",
+	"hw_duration",
+	"worker",
+	"event"
+};
+
+void kbase_latency_hist_show(struct seq_file *sfile, const char *name,
+		struct kbase_latency_hist *hist)
+{
+	u32 count[KBASE_LATENCY_NR_BUCKETS];
+	u32 total = 0;
+	u64 sum = atomic64_read(&hist->sum_ns);
+	unsigned int i;
+
+	for (i = 0; i < KBASE_LATENCY_NR_BUCKETS; i++) {
+		count[i] = atomic_read(&hist->bucket[i]);
+		total += count[i];
+	}
+
+	seq_printf(sfile, "%s: count %u mean %llu ns\n", name, total,
+			total ? div_u64(sum, total) : 0);
+
+	for (i = 0; i < KBASE_LATENCY_NR_BUCKETS; i++) {
+		u64 low = i ? 1ull << (i - 1) : 0;
+
+		if (!count[i])
+			continue;
+
+		if (i == KBASE_LATENCY_NR_BUCKETS - 1)
+			seq_printf(sfile, "  [%llu, inf) %u\n", low, count[i]);
+		else
+			seq_printf(sfile, "  [%llu, %llu) %u\n",
+					low, 1ull << i, count[i]);
+	}
+}
+
+static void kbasep_latency_show(struct seq_file *sfile,
+		struct kbase_latency *latency)
+{
+	unsigned int i;
+
+	for (i = 0; i < KBASE_LATENCY_STAGE_COUNT; i++)
+		kbase_latency_hist_show(sfile, kbasep_latency_stage_name[i],
+				&latency->stage[i]);
+}
+
+static int kbasep_latency_slot_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_device *kbdev = sfile->private;
+	int js;
+
+	for (js = 0; js < kbdev->gpu_props.num_job_slots; js++) {
+		seq_printf(sfile, "slot %d\n", js);
+		kbasep_latency_show(sfile, &kbdev->latency_slot[js]);
+	}
+
+	return 0;
+}
+
+static int kbasep_latency_slot_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_latency_slot_show, in->i_private);
+}
+
+static ssize_t kbasep_latency_slot_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_device *kbdev = sfile->private;
+	int js;
+
+	for (js = 0; js < BASE_JM_MAX_NR_SLOTS; js++)
+		kbasep_latency_reset(&kbdev->latency_slot[js]);
+
+	return count;
+}
+
+static const struct file_operations kbasep_latency_slot_fops = {
+	.open = kbasep_latency_slot_open,
+	.read = seq_read,
+	.write = kbasep_latency_slot_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int kbasep_latency_enable_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_device *kbdev = sfile->private;
+
+	seq_printf(sfile, "%d\n", kbdev->latency_enabled);
+
+	return 0;
+}
+
+static int kbasep_latency_enable_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_latency_enable_show, in->i_private);
+}
+
+static ssize_t kbasep_latency_enable_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_device *kbdev = sfile->private;
+	unsigned int enable;
+	int err;
+
+	err = kstrtouint_from_user(ubuf, count, 0, &enable);
+	if (err)
+		return err;
+
+	mutex_lock(&kbase_latency_lock);
+	if (enable && !kbdev->latency_enabled)
+		static_key_slow_inc(&kbase_latency_key);
+	else if (!enable && kbdev->latency_enabled)
+		static_key_slow_dec(&kbase_latency_key);
+	WRITE_ONCE(kbdev->latency_enabled, enable != 0);
+	mutex_unlock(&kbase_latency_lock);
+
+	return count;
+}
+
+static const struct file_operations kbasep_latency_enable_fops = {
+	.open = kbasep_latency_enable_open,
+	.read = seq_read,
+	.write = kbasep_latency_enable_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int kbasep_latency_ctx_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_context *kctx = sfile->private;
+
+	kbasep_latency_show(sfile, &kctx->latency);
+
+	return 0;
+}
+
+static int kbasep_latency_ctx_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_latency_ctx_show, in->i_private);
+}
+
+static ssize_t kbasep_latency_ctx_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_context *kctx = sfile->private;
+
+	kbasep_latency_reset(&kctx->latency);
+
+	return count;
+}
+
+static const struct file_operations kbasep_latency_ctx_fops = {
+	.open = kbasep_latency_ctx_open,
+	.read = seq_read,
+	.write = kbasep_latency_ctx_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kbase_latency_debugfs_init(struct kbase_device *kbdev)
+{
+	debugfs_create_file("job_latency", S_IRUGO | S_IWUSR,
+			kbdev->mali_debugfs_directory, kbdev,
+			&kbasep_latency_slot_fops);
+	debugfs_create_file("job_latency_enable", S_IRUGO | S_IWUSR,
+			kbdev->mali_debugfs_directory, kbdev,
+			&kbasep_latency_enable_fops);
+}
+
+void kbase_latency_debugfs_ctx_init(struct kbase_context *kctx)
+{
+	debugfs_create_file("job_latency", S_IRUGO | S_IWUSR,
+			kctx->kctx_dentry, kctx,
+			&kbasep_latency_ctx_fops);
+}
+#else
+void kbase_latency_debugfs_init(struct kbase_device *kbdev)
+{
+}
+
+void kbase_latency_debugfs_ctx_init(struct kbase_context *kctx)
+{
+}
+#endif /* CONFIG_DEBUG_FS */
@@ -0,0 +1,152 @@
+/*
+ *
+ * (C) COPYRIGHT 2017 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+#ifndef _KBASE_LATENCY_H_
+#define _KBASE_LATENCY_H_
+
+#include <linux/atomic.h>
+#include <linux/jump_label.h>
+
+struct kbase_device;
+struct kbase_context;
+struct kbase_jd_atom;
+struct seq_file;
+
+/**
+ * enum kbase_latency_stage - stages of the life of an atom
+ * @KBASE_LATENCY_DEP_RESOLVED: from submission to dependencies resolved
+ * @KBASE_LATENCY_HW_START:     from dependencies resolved, or from the end
+ *                              of the previous run, to submission to the
+ *                              hardware
+ * @KBASE_LATENCY_HW_DURATION:  time spent on the hardware
+ * @KBASE_LATENCY_WORKER:       from hardware completion to the job done
+ *                              worker
+ * @KBASE_LATENCY_EVENT:        from the job done worker to the event being
+ *                              dequeued by userspace
+ * @KBASE_LATENCY_STAGE_COUNT:  number of stages
+ */
+enum kbase_latency_stage {
+	KBASE_LATENCY_DEP_RESOLVED,
+	KBASE_LATENCY_HW_START,
+	KBASE_LATENCY_HW_DURATION,
+	KBASE_LATENCY_WORKER,
+	KBASE_LATENCY_EVENT,
+	KBASE_LATENCY_STAGE_COUNT
+};
+
+/* Bucket i counts latencies in [2^(i-1), 2^i) ns, the last bucket counts
+ * everything above. */
+#define KBASE_LATENCY_NR_BUCKETS 32
+
+/**
+ * struct kbase_latency_hist - log2 histogram of latencies
+ * @bucket: number of samples in each bucket
+ * @sum_ns: sum of all the samples
+ */
+struct kbase_latency_hist {
+	atomic_t bucket[KBASE_LATENCY_NR_BUCKETS];
+	atomic64_t sum_ns;
+};
+
+/**
+ * struct kbase_latency - latency histograms of each stage
+ * @stage: histogram of each stage, indexed by enum kbase_latency_stage
+ */
+struct kbase_latency {
+	struct kbase_latency_hist stage[KBASE_LATENCY_STAGE_COUNT];
+};
+
+/**
+ * kbase_latency_hist_add - add a sample to a histogram
+ * @hist: histogram
+ * @ns:   sample, in nanoseconds
+ */
+void kbase_latency_hist_add(struct kbase_latency_hist *hist, u64 ns);
+
+/**
+ * kbase_latency_hist_reset - clear a histogram
+ * @hist: histogram
+ */
+void kbase_latency_hist_reset(struct kbase_latency_hist *hist);
+
+/**
+ * kbase_latency_hist_show - print a histogram
+ * @sfile: destination
+ * @name:  name of the histogram
+ * @hist:  histogram
+ *
+ * Prints the number of samples and their mean, followed by the non empty
+ * buckets.
+ */
+void kbase_latency_hist_show(struct seq_file *sfile, const char *name,
+		struct kbase_latency_hist *hist);
+
+extern struct static_key kbase_latency_key;
+
+void kbasep_latency_atom_submit(struct kbase_jd_atom *katom);
+void kbasep_latency_atom_stage(struct kbase_jd_atom *katom,
+		enum kbase_latency_stage stage);
+
+/**
+ * kbase_latency_atom_submit - start tracking the latency of an atom
+ * @katom: atom being submitted
+ *
+ * Atoms submitted while collection is disabled are not tracked.
+ */
+static inline void kbase_latency_atom_submit(struct kbase_jd_atom *katom)
+{
+	if (static_key_false(&kbase_latency_key))
+		kbasep_latency_atom_submit(katom);
+}
+
+/**
+ * kbase_latency_atom_stage - record the end of a stage of an atom
+ * @katom: atom reaching the end of @stage
+ * @stage: stage ending
+ *
+ * The time since the end of the previous stage is added to the histograms
+ * of the context and of the job slot of the atom.
+ */
+static inline void kbase_latency_atom_stage(struct kbase_jd_atom *katom,
+		enum kbase_latency_stage stage)
+{
+	if (static_key_false(&kbase_latency_key))
+		kbasep_latency_atom_stage(katom, stage);
+}
+
+/**
+ * kbase_latency_debugfs_init - add the device latency debugfs files
+ * @kbdev: kbase device
+ *
+ * job_latency shows the histograms of each job slot, job_latency_enable
+ * turns collection on and off. Writing to job_latency resets the
+ * histograms.
+ */
+void kbase_latency_debugfs_init(struct kbase_device *kbdev);
+
+/**
+ * kbase_latency_debugfs_ctx_init - add the context latency debugfs file
+ * @kctx: kbase context
+ */
+void kbase_latency_debugfs_ctx_init(struct kbase_context *kctx);
+
+/**
+ * kbase_latency_term - stop collection enabled by a device
+ * @kbdev: kbase device
+ */
+void kbase_latency_term(struct kbase_device *kbdev);
+
+#endif /* _KBASE_LATENCY_H_ */
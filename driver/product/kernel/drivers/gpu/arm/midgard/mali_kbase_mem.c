@@ -23,6 +23,7 @@
  */
 #ifdef CONFIG_DMA_SHARED_BUFFER
 #include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
 #endif				/* CONFIG_DMA_SHARED_BUFFER */
 #ifdef CONFIG_UMP
 #include <linux/ump.h>
@@ -31,6 +32,9 @@
 #include <linux/bug.h>
 #include <linux/compat.h>
 #include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/mmu_notifier.h>
 
 #include <mali_kbase_config.h>
 #include <mali_kbase.h>
@@ -738,6 +742,9 @@ fail_unlock:
 int kbase_mem_init(struct kbase_device *kbdev)
 {
 	struct kbasep_mem_device *memdev;
+	int node;
+	int i;
+	int err;
 
 	KBASE_DEBUG_ASSERT(kbdev);
 
@@ -747,8 +754,32 @@ int kbase_mem_init(struct kbase_device *kbdev)
 	/* Initialize memory usage */
 	atomic_set(&memdev->used_pages, 0);
 
-	return kbase_mem_pool_init(&kbdev->mem_pool,
-			KBASE_MEM_POOL_MAX_SIZE_KBDEV, kbdev, NULL);
+	kbdev->mem_pool_node = dev_to_node(kbdev->dev);
+	kbdev->mem_pools = kcalloc(nr_node_ids, sizeof(*kbdev->mem_pools),
+			GFP_KERNEL);
+	if (!kbdev->mem_pools)
+		return -ENOMEM;
+
+	for_each_node(node) {
+		err = kbase_mem_pool_init(&kbdev->mem_pools[node],
+				KBASE_MEM_POOL_MAX_SIZE_KBDEV, node, kbdev, NULL);
+		if (err)
+			goto term_pools;
+	}
+
+	kbase_mem_pool_tuner_init(kbdev);
+
+	return 0;
+
+term_pools:
+	for_each_node(i) {
+		if (i == node)
+			break;
+		kbase_mem_pool_term(&kbdev->mem_pools[i]);
+	}
+	kfree(kbdev->mem_pools);
+	kbdev->mem_pools = NULL;
+	return err;
 }
 
 void kbase_mem_halt(struct kbase_device *kbdev)
@@ -760,6 +791,7 @@ void kbase_mem_term(struct kbase_device *kbdev)
 {
 	struct kbasep_mem_device *memdev;
 	int pages;
+	int node;
 
 	KBASE_DEBUG_ASSERT(kbdev);
 
@@ -769,7 +801,12 @@ void kbase_mem_term(struct kbase_device *kbdev)
 	if (pages != 0)
 		dev_warn(kbdev->dev, "%s: %d pages in use!\n", __func__, pages);
 
-	kbase_mem_pool_term(&kbdev->mem_pool);
+	kbase_mem_pool_tuner_term(kbdev);
+
+	for_each_node(node)
+		kbase_mem_pool_term(&kbdev->mem_pools[node]);
+	kfree(kbdev->mem_pools);
+	kbdev->mem_pools = NULL;
 }
 
 KBASE_EXPORT_TEST_API(kbase_mem_term);
@@ -977,6 +1014,12 @@ int kbase_gpu_munmap(struct kbase_context *kctx, struct kbase_va_region *reg)
 			if (reg->gpu_alloc->imported.alias.aliased[i].alloc)
 				kbase_mem_phy_alloc_gpu_unmapped(reg->gpu_alloc->imported.alias.aliased[i].alloc);
 	} else {
+#ifdef CONFIG_DMA_SHARED_BUFFER
+		if (reg->gpu_alloc->type == KBASE_MEM_TYPE_IMPORTED_UMM)
+			kbase_umm_cache_evict(kctx, reg->gpu_alloc);
+#endif /* CONFIG_DMA_SHARED_BUFFER */
+		if (reg->gpu_alloc->type == KBASE_MEM_TYPE_IMPORTED_USER_BUF)
+			kbase_user_buf_cache_evict(kctx, reg->gpu_alloc);
 		err = kbase_mmu_teardown_pages(kctx, reg->start_pfn, kbase_reg_current_backed_size(reg));
 		kbase_mem_phy_alloc_gpu_unmapped(reg->gpu_alloc);
 	}
@@ -2132,6 +2175,7 @@ static int kbase_jd_user_buf_map(struct kbase_context *kctx,
 	struct device *dev;
 	unsigned long offset;
 	unsigned long local_size;
+	u64 start;
 
 	alloc = reg->gpu_alloc;
 	pa = kbase_get_gpu_phy_pages(reg);
@@ -2142,6 +2186,8 @@ static int kbase_jd_user_buf_map(struct kbase_context *kctx,
 
 	pages = alloc->imported.user_buf.pages;
 
+	start = ktime_to_ns(ktime_get());
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 6, 0)
 	pinned_pages = get_user_pages(NULL, mm,
 			address,
@@ -2195,6 +2241,11 @@ static int kbase_jd_user_buf_map(struct kbase_context *kctx,
 
 	alloc->nents = pinned_pages;
 
+	atomic_inc(&kctx->user_buf_cache.nr_pins);
+	atomic64_add(pinned_pages, &kctx->user_buf_cache.nr_pinned_pages);
+	atomic64_add(ktime_to_ns(ktime_get()) - start,
+			&kctx->user_buf_cache.pin_ns);
+
 	err = kbase_mmu_insert_pages(kctx, reg->start_pfn, pa,
 			kbase_reg_current_backed_size(reg),
 			reg->flags);
@@ -2239,8 +2290,404 @@ static void kbase_jd_user_buf_unmap(struct kbase_context *kctx,
 		size -= local_size;
 	}
 	alloc->nents = 0;
+	atomic_inc(&kctx->user_buf_cache.nr_unpins);
 }
 
+#ifdef CONFIG_MMU_NOTIFIER
+static void kbase_user_buf_cache_sync(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc, bool for_device)
+{
+	struct device *dev = kctx->kbdev->dev;
+	unsigned long size = alloc->imported.user_buf.size;
+	long i;
+
+	for (i = 0; i < alloc->imported.user_buf.nr_pages; i++) {
+		dma_addr_t dma_addr = alloc->imported.user_buf.dma_addrs[i];
+		unsigned long local_size;
+
+		local_size = MIN(size, PAGE_SIZE - (dma_addr & ~PAGE_MASK));
+		if (for_device)
+			dma_sync_single_for_device(dev, dma_addr, local_size,
+					DMA_BIDIRECTIONAL);
+		else
+			dma_sync_single_for_cpu(dev, dma_addr, local_size,
+					DMA_BIDIRECTIONAL);
+
+		size -= local_size;
+	}
+}
+
+/*
+ * Unpin an idle buffer, the cache lock must be held. The MMU notifier may be
+ * called with the lock of a page held, so it marks pages dirty without
+ * taking it.
+ */
+static void kbase_user_buf_cache_drop_locked(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc, bool in_notifier)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+	struct kbase_va_region *reg = alloc->imported.user_buf.cache_reg;
+	bool writeable = (reg->flags & KBASE_REG_GPU_WR) != 0;
+
+	lockdep_assert_held(&cache->lock);
+
+	list_del_init(&alloc->imported.user_buf.cache_node);
+	alloc->imported.user_buf.cache_reg = NULL;
+	cache->nr_idle--;
+	cache->nr_pages -= alloc->nents;
+
+	/* The region is only freed after kbase_user_buf_cache_evict() */
+	kbase_mmu_teardown_pages(kctx, reg->start_pfn, alloc->nents);
+
+	if (writeable && in_notifier) {
+		long i;
+
+		for (i = 0; i < alloc->imported.user_buf.nr_pages; i++)
+			set_page_dirty(alloc->imported.user_buf.pages[i]);
+		writeable = false;
+	}
+	kbase_jd_user_buf_unmap(kctx, alloc, writeable);
+}
+
+static void kbase_user_buf_cache_shrink_locked(struct kbase_context *kctx,
+		size_t budget)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+
+	lockdep_assert_held(&cache->lock);
+
+	while (cache->nr_pages > budget) {
+		kbase_user_buf_cache_drop_locked(kctx, list_last_entry(
+				&cache->idle_list, struct kbase_mem_phy_alloc,
+				imported.user_buf.cache_node), false);
+		atomic_inc(&cache->nr_evictions);
+	}
+}
+
+/**
+ * kbase_user_buf_cache_get - Reuse an idle pinned user buffer
+ * @kctx:  kbase context
+ * @alloc: The imported allocation about to be used by an atom
+ *
+ * Return: true if @alloc was still pinned, false if it needs to be pinned
+ */
+static bool kbase_user_buf_cache_get(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+	bool hit = false;
+
+	mutex_lock(&cache->lock);
+	if (!list_empty(&alloc->imported.user_buf.cache_node)) {
+		list_del_init(&alloc->imported.user_buf.cache_node);
+		alloc->imported.user_buf.cache_reg = NULL;
+		cache->nr_idle--;
+		cache->nr_pages -= alloc->nents;
+		hit = true;
+	}
+	mutex_unlock(&cache->lock);
+
+	if (!hit)
+		return false;
+
+	/* Hand the pages to the device as mapping them would have */
+	kbase_user_buf_cache_sync(kctx, alloc, true);
+	atomic_inc(&cache->nr_hits);
+
+	return true;
+}
+
+/**
+ * kbase_user_buf_cache_put - Keep a user buffer no atom uses pinned
+ * @kctx: kbase context
+ * @reg:  The region of the import
+ *
+ * Return: true if the buffer was kept, false if it must be unpinned
+ */
+static bool kbase_user_buf_cache_put(struct kbase_context *kctx,
+		struct kbase_va_region *reg)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+	struct kbase_mem_phy_alloc *alloc = reg->gpu_alloc;
+
+	if (alloc->imported.user_buf.mm != READ_ONCE(cache->mm) ||
+			alloc->nents > READ_ONCE(cache->budget))
+		return false;
+
+	/* Hand the pages back to the CPU as unmapping them would have */
+	kbase_user_buf_cache_sync(kctx, alloc, false);
+
+	mutex_lock(&cache->lock);
+	if (alloc->nents > cache->budget) {
+		mutex_unlock(&cache->lock);
+		return false;
+	}
+
+	kbase_user_buf_cache_shrink_locked(kctx, cache->budget - alloc->nents);
+
+	alloc->imported.user_buf.cache_reg = reg;
+	list_add(&alloc->imported.user_buf.cache_node, &cache->idle_list);
+	cache->nr_idle++;
+	cache->nr_pages += alloc->nents;
+	mutex_unlock(&cache->lock);
+
+	return true;
+}
+
+void kbase_user_buf_cache_evict(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+
+	lockdep_assert_held(&kctx->reg_lock);
+
+	mutex_lock(&cache->lock);
+	if (!list_empty(&alloc->imported.user_buf.cache_node))
+		kbase_user_buf_cache_drop_locked(kctx, alloc, false);
+	mutex_unlock(&cache->lock);
+}
+
+/*
+ * Drop the idle buffers overlapping [start, end). The CPU mapping of their
+ * pages is about to change, on munmap, mprotect or when a copy on write is
+ * broken after fork, so the pinned pages would no longer be the ones the
+ * process sees. Buffers in use by an atom are left alone, as they were
+ * before the cache existed.
+ */
+static void kbase_user_buf_cache_invalidate(struct kbase_context *kctx,
+		unsigned long start, unsigned long end)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+	struct kbase_mem_phy_alloc *alloc, *tmp;
+
+	mutex_lock(&cache->lock);
+	list_for_each_entry_safe(alloc, tmp, &cache->idle_list,
+			imported.user_buf.cache_node) {
+		unsigned long address = alloc->imported.user_buf.address;
+
+		if (address >= end ||
+				address + alloc->imported.user_buf.size <= start)
+			continue;
+
+		kbase_user_buf_cache_drop_locked(kctx, alloc, true);
+		atomic_inc(&cache->nr_invalidations);
+	}
+	mutex_unlock(&cache->lock);
+}
+
+static void kbase_user_buf_cache_release(struct mmu_notifier *mn,
+		struct mm_struct *mm)
+{
+	struct kbase_context *kctx = container_of(mn, struct kbase_context,
+			user_buf_cache.notifier);
+
+	kbase_user_buf_cache_invalidate(kctx, 0, ULONG_MAX);
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 19, 0)
+static void kbase_user_buf_cache_invalidate_range_start(
+		struct mmu_notifier *mn, struct mm_struct *mm,
+		unsigned long start, unsigned long end)
+{
+	struct kbase_context *kctx = container_of(mn, struct kbase_context,
+			user_buf_cache.notifier);
+
+	kbase_user_buf_cache_invalidate(kctx, start, end);
+}
+#elif LINUX_VERSION_CODE < KERNEL_VERSION(5, 0, 0)
+static int kbase_user_buf_cache_invalidate_range_start(
+		struct mmu_notifier *mn, struct mm_struct *mm,
+		unsigned long start, unsigned long end, bool blockable)
+{
+	struct kbase_context *kctx = container_of(mn, struct kbase_context,
+			user_buf_cache.notifier);
+
+	if (!blockable)
+		return -EAGAIN;
+
+	kbase_user_buf_cache_invalidate(kctx, start, end);
+
+	return 0;
+}
+#else
+static int kbase_user_buf_cache_invalidate_range_start(
+		struct mmu_notifier *mn,
+		const struct mmu_notifier_range *range)
+{
+	struct kbase_context *kctx = container_of(mn, struct kbase_context,
+			user_buf_cache.notifier);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 2, 0)
+	if (!range->blockable)
+#else
+	if (!mmu_notifier_range_blockable(range))
+#endif
+		return -EAGAIN;
+
+	kbase_user_buf_cache_invalidate(kctx, range->start, range->end);
+
+	return 0;
+}
+#endif
+
+static const struct mmu_notifier_ops kbase_user_buf_cache_notifier_ops = {
+	.release = kbase_user_buf_cache_release,
+	.invalidate_range_start = kbase_user_buf_cache_invalidate_range_start,
+};
+
+int kbase_user_buf_cache_init(struct kbase_context *kctx)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->idle_list);
+	cache->nr_idle = 0;
+	cache->nr_pages = 0;
+	cache->budget = KBASE_USER_BUF_CACHE_BUDGET;
+	mutex_init(&cache->register_lock);
+	cache->mm = NULL;
+	cache->notifier.ops = &kbase_user_buf_cache_notifier_ops;
+	atomic_set(&cache->nr_pins, 0);
+	atomic64_set(&cache->nr_pinned_pages, 0);
+	atomic64_set(&cache->pin_ns, 0);
+	atomic_set(&cache->nr_unpins, 0);
+	atomic_set(&cache->nr_hits, 0);
+	atomic_set(&cache->nr_evictions, 0);
+	atomic_set(&cache->nr_invalidations, 0);
+
+	return 0;
+}
+
+void kbase_user_buf_cache_attach(struct kbase_context *kctx,
+		struct mm_struct *mm)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+
+	if (READ_ONCE(cache->mm))
+		return;
+
+	mutex_lock(&cache->register_lock);
+	if (!cache->mm) {
+		if (!mmu_notifier_register(&cache->notifier, mm)) {
+			atomic_inc(&mm->mm_count);
+			WRITE_ONCE(cache->mm, mm);
+		} else {
+			dev_warn(kctx->kbdev->dev,
+				"Failed to register MMU notifier, user buffers will not be cached\n");
+		}
+	}
+	mutex_unlock(&cache->register_lock);
+}
+
+void kbase_user_buf_cache_term(struct kbase_context *kctx)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+
+	lockdep_assert_held(&kctx->reg_lock);
+
+	mutex_lock(&cache->lock);
+	kbase_user_buf_cache_shrink_locked(kctx, 0);
+	mutex_unlock(&cache->lock);
+}
+
+void kbase_user_buf_cache_detach(struct kbase_context *kctx)
+{
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+
+	if (!cache->mm)
+		return;
+
+	mmu_notifier_unregister(&cache->notifier, cache->mm);
+	mmdrop(cache->mm);
+	cache->mm = NULL;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int kbase_user_buf_cache_debugfs_show(struct seq_file *sfile,
+		void *data)
+{
+	struct kbase_context *kctx = sfile->private;
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+	u64 pages = atomic64_read(&cache->nr_pinned_pages);
+	u64 ns = atomic64_read(&cache->pin_ns);
+
+	mutex_lock(&cache->lock);
+	seq_printf(sfile, "pins: %d (%llu pages in %llu us, %llu MB/s)\n",
+			atomic_read(&cache->nr_pins), pages,
+			div_u64(ns, NSEC_PER_USEC),
+			ns ? div64_u64(pages * PAGE_SIZE * (NSEC_PER_SEC >> 10),
+					ns << 10) : 0);
+	seq_printf(sfile, "unpins: %d\n", atomic_read(&cache->nr_unpins));
+	seq_printf(sfile, "hits: %d\n", atomic_read(&cache->nr_hits));
+	seq_printf(sfile, "evictions: %d\n",
+			atomic_read(&cache->nr_evictions));
+	seq_printf(sfile, "invalidations: %d\n",
+			atomic_read(&cache->nr_invalidations));
+	seq_printf(sfile, "idle: %u (%zu/%zu pages)\n", cache->nr_idle,
+			cache->nr_pages, cache->budget);
+	mutex_unlock(&cache->lock);
+
+	return 0;
+}
+
+static int kbase_user_buf_cache_debugfs_open(struct inode *in,
+		struct file *file)
+{
+	return single_open(file, kbase_user_buf_cache_debugfs_show,
+			in->i_private);
+}
+
+/* Writing sets the budget in pages, 0 disables the cache */
+static ssize_t kbase_user_buf_cache_debugfs_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_context *kctx = sfile->private;
+	struct kbase_user_buf_cache *cache = &kctx->user_buf_cache;
+	unsigned long budget;
+	int err;
+
+	err = kstrtoul_from_user(ubuf, count, 0, &budget);
+	if (err)
+		return err;
+
+	mutex_lock(&cache->lock);
+	WRITE_ONCE(cache->budget, budget);
+	kbase_user_buf_cache_shrink_locked(kctx, budget);
+	mutex_unlock(&cache->lock);
+
+	return count;
+}
+
+static const struct file_operations kbase_user_buf_cache_debugfs_fops = {
+	.open = kbase_user_buf_cache_debugfs_open,
+	.read = seq_read,
+	.write = kbase_user_buf_cache_debugfs_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kbase_user_buf_cache_debugfs_init(struct kbase_context *kctx)
+{
+	debugfs_create_file("user_buf_cache", S_IRUGO | S_IWUSR,
+			kctx->kctx_dentry, kctx,
+			&kbase_user_buf_cache_debugfs_fops);
+}
+#endif /* CONFIG_DEBUG_FS */
+#else
+static inline bool kbase_user_buf_cache_get(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc)
+{
+	return false;
+}
+
+static inline bool kbase_user_buf_cache_put(struct kbase_context *kctx,
+		struct kbase_va_region *reg)
+{
+	return false;
+}
+#endif /* CONFIG_MMU_NOTIFIER */
+
 #ifdef CONFIG_DMA_SHARED_BUFFER
 static int kbase_jd_umm_map(struct kbase_context *kctx,
 		struct kbase_va_region *reg)
@@ -2309,6 +2756,8 @@ out:
 		dma_buf_unmap_attachment(alloc->imported.umm.dma_attachment,
 				alloc->imported.umm.sgt, DMA_BIDIRECTIONAL);
 		alloc->imported.umm.sgt = NULL;
+	} else {
+		atomic_inc(&kctx->umm_cache.nr_maps);
 	}
 
 	return err;
@@ -2325,7 +2774,287 @@ static void kbase_jd_umm_unmap(struct kbase_context *kctx,
 	    alloc->imported.umm.sgt, DMA_BIDIRECTIONAL);
 	alloc->imported.umm.sgt = NULL;
 	alloc->nents = 0;
+	atomic_inc(&kctx->umm_cache.nr_unmaps);
+}
+
+/* Tear down an idle mapping, the cache lock must be held */
+static void kbase_umm_cache_drop_locked(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc)
+{
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+	struct kbase_va_region *reg = alloc->imported.umm.cache_reg;
+
+	lockdep_assert_held(&cache->lock);
+
+	list_del_init(&alloc->imported.umm.cache_node);
+	alloc->imported.umm.cache_reg = NULL;
+	cache->nr_idle--;
+	cache->nr_pages -= alloc->nents;
+
+	/* The region is only freed after kbase_umm_cache_evict() */
+	kbase_mmu_teardown_pages(kctx, reg->start_pfn, alloc->nents);
+	kbase_jd_umm_unmap(kctx, alloc);
+	atomic_inc(&cache->nr_evictions);
+}
+
+static void kbase_umm_cache_shrink_locked(struct kbase_context *kctx,
+		unsigned int max_idle)
+{
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+
+	lockdep_assert_held(&cache->lock);
+
+	while (cache->nr_idle > max_idle)
+		kbase_umm_cache_drop_locked(kctx, list_last_entry(
+				&cache->idle_list, struct kbase_mem_phy_alloc,
+				imported.umm.cache_node));
+}
+
+/**
+ * kbase_umm_cache_get - Reuse the idle GPU mapping of an import
+ * @kctx:  kbase context
+ * @alloc: The imported allocation about to be used by an atom
+ *
+ * Return: true if @alloc was still mapped, false if it needs to be mapped
+ */
+static bool kbase_umm_cache_get(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc)
+{
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+	struct sg_table *sgt;
+	bool hit = false;
+
+	mutex_lock(&cache->lock);
+	if (!list_empty(&alloc->imported.umm.cache_node)) {
+		list_del_init(&alloc->imported.umm.cache_node);
+		alloc->imported.umm.cache_reg = NULL;
+		cache->nr_idle--;
+		cache->nr_pages -= alloc->nents;
+		hit = true;
+	}
+	mutex_unlock(&cache->lock);
+
+	if (!hit)
+		return false;
+
+	/* Hand the buffer to the device as mapping it would have */
+	sgt = alloc->imported.umm.sgt;
+	dma_sync_sg_for_device(kctx->kbdev->dev, sgt->sgl, sgt->orig_nents,
+			DMA_BIDIRECTIONAL);
+	atomic_inc(&cache->nr_hits);
+
+	return true;
+}
+
+/**
+ * kbase_umm_cache_put - Keep the GPU mapping of an import no atom uses
+ * @kctx: kbase context
+ * @reg:  The region of the import
+ *
+ * Return: true if the mapping was kept, false if it must be torn down
+ */
+static bool kbase_umm_cache_put(struct kbase_context *kctx,
+		struct kbase_va_region *reg)
+{
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+	struct kbase_mem_phy_alloc *alloc = reg->gpu_alloc;
+	struct sg_table *sgt = alloc->imported.umm.sgt;
+
+	if (!READ_ONCE(cache->max_idle))
+		return false;
+
+	/* Hand the buffer back to the CPU as unmapping it would have */
+	dma_sync_sg_for_cpu(kctx->kbdev->dev, sgt->sgl, sgt->orig_nents,
+			DMA_BIDIRECTIONAL);
+
+	mutex_lock(&cache->lock);
+	if (!cache->max_idle) {
+		mutex_unlock(&cache->lock);
+		return false;
+	}
+
+	kbase_umm_cache_shrink_locked(kctx, cache->max_idle - 1);
+
+	alloc->imported.umm.cache_reg = reg;
+	list_add(&alloc->imported.umm.cache_node, &cache->idle_list);
+	cache->nr_idle++;
+	cache->nr_pages += alloc->nents;
+	mutex_unlock(&cache->lock);
+
+	return true;
 }
+
+void kbase_umm_cache_evict(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc)
+{
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+
+	lockdep_assert_held(&kctx->reg_lock);
+
+	mutex_lock(&cache->lock);
+	if (!list_empty(&alloc->imported.umm.cache_node))
+		kbase_umm_cache_drop_locked(kctx, alloc);
+	mutex_unlock(&cache->lock);
+}
+
+static unsigned long kbase_umm_cache_reclaim_count_objects(struct shrinker *s,
+		struct shrink_control *sc)
+{
+	struct kbase_context *kctx;
+
+	kctx = container_of(s, struct kbase_context, umm_cache.reclaim);
+
+	return READ_ONCE(kctx->umm_cache.nr_pages);
+}
+
+/*
+ * Dropping an idle mapping releases the sg table and any IOMMU mapping of
+ * the exporter. Like the eviction shrinker this runs without the region
+ * lock, which is safe as regions are only freed after kbase_gpu_munmap()
+ * has evicted them under the cache lock.
+ */
+static unsigned long kbase_umm_cache_reclaim_scan_objects(struct shrinker *s,
+		struct shrink_control *sc)
+{
+	struct kbase_context *kctx;
+	struct kbase_umm_cache *cache;
+	unsigned long freed = 0;
+
+	kctx = container_of(s, struct kbase_context, umm_cache.reclaim);
+	cache = &kctx->umm_cache;
+
+	if (!mutex_trylock(&cache->lock))
+		return 0;
+
+	while (cache->nr_idle && freed < sc->nr_to_scan) {
+		struct kbase_mem_phy_alloc *alloc;
+
+		alloc = list_last_entry(&cache->idle_list,
+				struct kbase_mem_phy_alloc,
+				imported.umm.cache_node);
+		freed += alloc->nents;
+		kbase_umm_cache_drop_locked(kctx, alloc);
+	}
+
+	mutex_unlock(&cache->lock);
+
+	return freed;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 12, 0)
+static int kbase_umm_cache_reclaim_shrink(struct shrinker *s,
+		struct shrink_control *sc)
+{
+	if (sc->nr_to_scan == 0)
+		return kbase_umm_cache_reclaim_count_objects(s, sc);
+
+	return kbase_umm_cache_reclaim_scan_objects(s, sc);
+}
+#endif
+
+int kbase_umm_cache_init(struct kbase_context *kctx)
+{
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->idle_list);
+	cache->nr_idle = 0;
+	cache->nr_pages = 0;
+	cache->max_idle = KBASE_UMM_CACHE_MAX_IDLE;
+	atomic_set(&cache->nr_maps, 0);
+	atomic_set(&cache->nr_unmaps, 0);
+	atomic_set(&cache->nr_hits, 0);
+	atomic_set(&cache->nr_evictions, 0);
+
+	/* Register shrinker */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 12, 0)
+	cache->reclaim.shrink = kbase_umm_cache_reclaim_shrink;
+#else
+	cache->reclaim.count_objects = kbase_umm_cache_reclaim_count_objects;
+	cache->reclaim.scan_objects = kbase_umm_cache_reclaim_scan_objects;
+#endif
+	cache->reclaim.seeks = DEFAULT_SEEKS;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 1, 0)
+	cache->reclaim.batch = 0;
+#endif
+	register_shrinker(&cache->reclaim);
+
+	return 0;
+}
+
+void kbase_umm_cache_term(struct kbase_context *kctx)
+{
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+
+	lockdep_assert_held(&kctx->reg_lock);
+
+	unregister_shrinker(&cache->reclaim);
+
+	mutex_lock(&cache->lock);
+	kbase_umm_cache_shrink_locked(kctx, 0);
+	mutex_unlock(&cache->lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int kbase_umm_cache_debugfs_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_context *kctx = sfile->private;
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+
+	mutex_lock(&cache->lock);
+	seq_printf(sfile, "maps: %d\n", atomic_read(&cache->nr_maps));
+	seq_printf(sfile, "unmaps: %d\n", atomic_read(&cache->nr_unmaps));
+	seq_printf(sfile, "hits: %d\n", atomic_read(&cache->nr_hits));
+	seq_printf(sfile, "evictions: %d\n",
+			atomic_read(&cache->nr_evictions));
+	seq_printf(sfile, "idle: %u/%u (%zu pages)\n", cache->nr_idle,
+			cache->max_idle, cache->nr_pages);
+	mutex_unlock(&cache->lock);
+
+	return 0;
+}
+
+static int kbase_umm_cache_debugfs_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbase_umm_cache_debugfs_show, in->i_private);
+}
+
+/* Writing sets the max number of idle mappings, 0 disables the cache */
+static ssize_t kbase_umm_cache_debugfs_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_context *kctx = sfile->private;
+	struct kbase_umm_cache *cache = &kctx->umm_cache;
+	unsigned int max_idle;
+	int err;
+
+	err = kstrtouint_from_user(ubuf, count, 0, &max_idle);
+	if (err)
+		return err;
+
+	mutex_lock(&cache->lock);
+	WRITE_ONCE(cache->max_idle, max_idle);
+	kbase_umm_cache_shrink_locked(kctx, max_idle);
+	mutex_unlock(&cache->lock);
+
+	return count;
+}
+
+static const struct file_operations kbase_umm_cache_debugfs_fops = {
+	.open = kbase_umm_cache_debugfs_open,
+	.read = seq_read,
+	.write = kbase_umm_cache_debugfs_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kbase_umm_cache_debugfs_init(struct kbase_context *kctx)
+{
+	debugfs_create_file("umm_cache", S_IRUGO | S_IWUSR, kctx->kctx_dentry,
+			kctx, &kbase_umm_cache_debugfs_fops);
+}
+#endif /* CONFIG_DEBUG_FS */
 #endif				/* CONFIG_DMA_SHARED_BUFFER */
 
 #if (defined(CONFIG_KDS) && defined(CONFIG_UMP)) \
@@ -2367,7 +3096,8 @@ struct kbase_mem_phy_alloc *kbase_map_external_resource(
 			goto exit;
 
 		reg->gpu_alloc->imported.user_buf.current_mapping_usage_count++;
-		if (1 == reg->gpu_alloc->imported.user_buf.current_mapping_usage_count) {
+		if (1 == reg->gpu_alloc->imported.user_buf.current_mapping_usage_count &&
+				!kbase_user_buf_cache_get(kctx, reg->gpu_alloc)) {
 			err = kbase_jd_user_buf_map(kctx, reg);
 			if (err) {
 				reg->gpu_alloc->imported.user_buf.current_mapping_usage_count--;
@@ -2406,7 +3136,8 @@ struct kbase_mem_phy_alloc *kbase_map_external_resource(
 		}
 #endif
 		reg->gpu_alloc->imported.umm.current_mapping_usage_count++;
-		if (1 == reg->gpu_alloc->imported.umm.current_mapping_usage_count) {
+		if (1 == reg->gpu_alloc->imported.umm.current_mapping_usage_count &&
+				!kbase_umm_cache_get(kctx, reg->gpu_alloc)) {
 			err = kbase_jd_umm_map(kctx, reg);
 			if (err) {
 				reg->gpu_alloc->imported.umm.current_mapping_usage_count--;
@@ -2434,6 +3165,10 @@ void kbase_unmap_external_resource(struct kbase_context *kctx,
 		alloc->imported.umm.current_mapping_usage_count--;
 
 		if (0 == alloc->imported.umm.current_mapping_usage_count) {
+			if (reg && reg->gpu_alloc == alloc &&
+					kbase_umm_cache_put(kctx, reg))
+				break;
+
 			if (reg && reg->gpu_alloc == alloc)
 				kbase_mmu_teardown_pages(
 						kctx,
@@ -2451,6 +3186,10 @@ void kbase_unmap_external_resource(struct kbase_context *kctx,
 		if (0 == alloc->imported.user_buf.current_mapping_usage_count) {
 			bool writeable = true;
 
+			if (reg && reg->gpu_alloc == alloc &&
+					kbase_user_buf_cache_put(kctx, reg))
+				break;
+
 			if (reg && reg->gpu_alloc == alloc)
 				kbase_mmu_teardown_pages(
 						kctx,
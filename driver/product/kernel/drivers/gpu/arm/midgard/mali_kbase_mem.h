@@ -142,6 +142,10 @@ struct kbase_mem_phy_alloc {
 			struct dma_buf_attachment *dma_attachment;
 			unsigned int current_mapping_usage_count;
 			struct sg_table *sgt;
+			/* Link in kbase_umm_cache::idle_list and the region
+			 * the idle mapping belongs to */
+			struct list_head cache_node;
+			struct kbase_va_region *cache_reg;
 		} umm;
 #endif /* defined(CONFIG_DMA_SHARED_BUFFER) */
 		struct {
@@ -159,6 +163,10 @@ struct kbase_mem_phy_alloc {
 			unsigned int current_mapping_usage_count;
 			struct mm_struct *mm;
 			dma_addr_t *dma_addrs;
+			/* Link in kbase_user_buf_cache::idle_list and the
+			 * region the idle mapping belongs to */
+			struct list_head cache_node;
+			struct kbase_va_region *cache_reg;
 		} user_buf;
 	} imported;
 };
@@ -291,8 +299,21 @@ struct kbase_va_region {
 
 	/* List head used to store the region in the JIT allocation pool */
 	struct list_head jit_node;
+
+	/* Number of page faults that grew the region, and pages added by
+	 * them. Protected by kbase_gpu_vm_lock(). */
+	u32 nr_grow_faults;
+	size_t nr_grow_pages;
+
+	/* Number of pages to grow the region by on the next sequential page
+	 * fault, zero after a non sequential fault. Protected by
+	 * kbase_gpu_vm_lock(). */
+	size_t pf_window;
 };
 
+/* Maximum number of pages a region is grown by on a sequential page fault */
+#define KBASE_PF_GROW_MAX_PAGES (512)
+
 /* Common functions */
 static inline phys_addr_t *kbase_get_cpu_phy_pages(struct kbase_va_region *reg)
 {
@@ -438,10 +459,50 @@ static inline int kbase_atomic_sub_pages(int num_pages, atomic_t *used_pages)
  */
 #define KBASE_MEM_POOL_MAX_SIZE_KCTX  (SZ_64M >> PAGE_SHIFT)
 
+/*
+ * Number of dirty pages in the kbdev memory pool above which they are zeroed
+ * in the background
+ */
+#define KBASE_MEM_POOL_DIRTY_WMARK    (SZ_256K >> PAGE_SHIFT)
+
+/*
+ * Max number of dirty pages in the kbdev memory pool, pages spilled above
+ * this are zeroed by the freeing thread
+ */
+#define KBASE_MEM_POOL_DIRTY_MAX      (SZ_16M >> PAGE_SHIFT)
+
+/*
+ * Default period of the memory pool autotuner, in milliseconds
+ */
+#define KBASE_MEM_POOL_TUNE_PERIOD_MS 100
+
+/*
+ * Number of periods without allocations after which a pool is considered idle
+ * and shrunk down to its target size
+ */
+#define KBASE_MEM_POOL_TUNE_IDLE_PERIODS 10
+
+/*
+ * The target size of a pool decays by 1/KBASE_MEM_POOL_TUNE_DECAY of itself
+ * every period
+ */
+#define KBASE_MEM_POOL_TUNE_DECAY     8
+
+/*
+ * Max number of pages added to a pool by the autotuner in one go
+ */
+#define KBASE_MEM_POOL_TUNE_BATCH     (SZ_4M >> PAGE_SHIFT)
+
+/*
+ * Default number of pages the pool of a new context is grown to
+ */
+#define KBASE_MEM_POOL_WARMUP_PAGES   (SZ_1M >> PAGE_SHIFT)
+
 /**
  * kbase_mem_pool_init - Create a memory pool for a kbase device
  * @pool:      Memory pool to initialize
  * @max_size:  Maximum number of free pages the pool can hold
+ * @node:      NUMA node to allocate new pages from, or NUMA_NO_NODE
  * @kbdev:     Kbase device where memory is used
  * @next_pool: Pointer to the next pool or NULL.
  *
@@ -453,8 +514,12 @@ static inline int kbase_atomic_sub_pages(int num_pages, atomic_t *used_pages)
  *
  * If @next_pool is not NULL, we will allocate from @next_pool before going to
  * the kernel allocator. Similarily pages can spill over to @next_pool when
- * @pool is full. Pages are zeroed before they spill over to another pool, to
- * prevent leaking information between applications.
+ * @pool is full. Pages are zeroed before they are allocated from another pool,
+ * to prevent leaking information between applications.
+ *
+ * If @next_pool is NULL, pages spilled into @pool are queued on a dirty list
+ * and zeroed by a low priority thread, so that neither the freeing nor the
+ * allocating thread usually has to zero them.
  *
  * A shrinker is registered so that Linux mm can reclaim pages from the pool as
  * needed.
@@ -463,6 +528,7 @@ static inline int kbase_atomic_sub_pages(int num_pages, atomic_t *used_pages)
  */
 int kbase_mem_pool_init(struct kbase_mem_pool *pool,
 		size_t max_size,
+		int node,
 		struct kbase_device *kbdev,
 		struct kbase_mem_pool *next_pool);
 
@@ -568,6 +634,45 @@ static inline size_t kbase_mem_pool_max_size(struct kbase_mem_pool *pool)
  */
 void kbase_mem_pool_set_max_size(struct kbase_mem_pool *pool, size_t max_size);
 
+/**
+ * kbase_mem_pool_dirty_wmark - Get the background zeroing watermark
+ * @pool:  Memory pool to inspect
+ *
+ * Return: Number of dirty pages above which the pool zeroes them in the
+ *         background
+ */
+static inline size_t kbase_mem_pool_dirty_wmark(struct kbase_mem_pool *pool)
+{
+	return pool->dirty_wmark;
+}
+
+/**
+ * kbase_mem_pool_set_dirty_wmark - Set the background zeroing watermark
+ * @pool:  Memory pool to configure
+ * @wmark: Number of dirty pages above which they are zeroed in the background
+ */
+void kbase_mem_pool_set_dirty_wmark(struct kbase_mem_pool *pool, size_t wmark);
+
+/**
+ * kbase_mem_pool_dirty_max - Get the maximum number of dirty pages
+ * @pool:  Memory pool to inspect
+ *
+ * Return: Maximum number of pages waiting to be zeroed
+ */
+static inline size_t kbase_mem_pool_dirty_max(struct kbase_mem_pool *pool)
+{
+	return pool->dirty_max;
+}
+
+/**
+ * kbase_mem_pool_set_dirty_max - Set the maximum number of dirty pages
+ * @pool:      Memory pool to configure
+ * @dirty_max: Maximum number of pages waiting to be zeroed. Pages spilled
+ *             into a pool holding that many dirty pages are zeroed right away.
+ */
+void kbase_mem_pool_set_dirty_max(struct kbase_mem_pool *pool,
+		size_t dirty_max);
+
 /**
  * kbase_mem_pool_grow - Grow the pool
  * @pool:       Memory pool to grow
@@ -591,16 +696,118 @@ int kbase_mem_pool_grow(struct kbase_mem_pool *pool, size_t nr_to_grow);
  */
 void kbase_mem_pool_trim(struct kbase_mem_pool *pool, size_t new_size);
 
+/**
+ * kbase_mem_pool_tune - Resize a pool to follow its recent demand
+ * @pool: Memory pool to tune
+ *
+ * Samples the number of pages requested from @pool since the last call and
+ * updates its target size, which follows bursts up at once and decays
+ * slowly. While the pool is in use it is grown towards its target, once it
+ * has been idle for KBASE_MEM_POOL_TUNE_IDLE_PERIODS calls it is shrunk down
+ * to it, spilling pages into the next pool where there is room.
+ *
+ * Must be called with the tuner lock held.
+ *
+ * Return: true if @pool needs to be tuned again, false once it is idle and
+ *         its target has decayed to zero
+ */
+bool kbase_mem_pool_tune(struct kbase_mem_pool *pool);
+
+/**
+ * kbase_mem_pool_refill - Grow a pool towards its target size
+ * @pool: Memory pool to refill
+ *
+ * Adds up to KBASE_MEM_POOL_TUNE_BATCH pages to @pool, taking them from the
+ * next pool first and from the kernel otherwise.
+ *
+ * Must be called with the tuner lock held.
+ */
+void kbase_mem_pool_refill(struct kbase_mem_pool *pool);
+
+/**
+ * kbase_mem_pool_tuner_init - Initialize the memory pool autotuner
+ * @kbdev: The kbase device
+ */
+void kbase_mem_pool_tuner_init(struct kbase_device *kbdev);
+
+/**
+ * kbase_mem_pool_tuner_term - Stop the memory pool autotuner
+ * @kbdev: The kbase device
+ *
+ * Must be called before the device memory pools are terminated.
+ */
+void kbase_mem_pool_tuner_term(struct kbase_device *kbdev);
+
+/**
+ * kbase_mem_pool_tuner_kick - Make sure the autotuner is running
+ * @kbdev: The kbase device
+ *
+ * Called on allocation from a pool. Cheap when the autotuner is already
+ * queued.
+ */
+void kbase_mem_pool_tuner_kick(struct kbase_device *kbdev);
+
+/**
+ * kbase_mem_pool_tuner_refill - Refill the pools ahead of an expected burst
+ * @kbdev: The kbase device
+ *
+ * Queues a work growing every pool of @kbdev back to its target size.
+ */
+void kbase_mem_pool_tuner_refill(struct kbase_device *kbdev);
+
+/**
+ * kbase_mem_pool_tuner_warmup - Pre-grow the pool of a new context
+ * @kctx: The new kbase context
+ *
+ * Raises the target size of the context pool to the configured warm-up size
+ * and refills it in the background.
+ */
+void kbase_mem_pool_tuner_warmup(struct kbase_context *kctx);
+
+/**
+ * kbase_mem_pool_tuner_remove_ctx - Stop tuning the pool of a context
+ * @kctx: The kbase context
+ *
+ * Must be called after @kctx is removed from the context list of its device
+ * and before its pool is terminated. Waits for the autotuner to be done with
+ * the pool.
+ */
+void kbase_mem_pool_tuner_remove_ctx(struct kbase_context *kctx);
+
+/**
+ * kbase_mem_pool_tuner_set_period - Set the autotuner sampling period
+ * @kbdev:     The kbase device
+ * @period_ms: Sampling period in milliseconds, 0 disables autotuning
+ */
+void kbase_mem_pool_tuner_set_period(struct kbase_device *kbdev,
+		unsigned int period_ms);
+
 /*
  * kbase_mem_alloc_page - Allocate a new page for a device
  * @kbdev: The kbase device
+ * @node:  NUMA node to allocate the page from, or NUMA_NO_NODE for the node
+ *         of the calling CPU
  *
  * Most uses should use kbase_mem_pool_alloc to allocate a page. However that
  * function can fail in the event the pool is empty.
  *
  * Return: A new page or NULL if no memory
  */
-struct page *kbase_mem_alloc_page(struct kbase_device *kbdev);
+struct page *kbase_mem_alloc_page(struct kbase_device *kbdev, int node);
+
+/**
+ * kbase_mem_preferred_node - Get the NUMA node a new context should use
+ * @kbdev: The kbase device
+ *
+ * Return: the node configured for the device, or the node of the calling CPU
+ *         if none is configured
+ */
+static inline int kbase_mem_preferred_node(struct kbase_device *kbdev)
+{
+	int node = ACCESS_ONCE(kbdev->mem_pool_node);
+
+	return node == NUMA_NO_NODE ? numa_node_id() : node;
+}
 
 int kbase_region_tracker_init(struct kbase_context *kctx);
 int kbase_region_tracker_init_jit(struct kbase_context *kctx, u64 jit_va_pages);
@@ -1043,6 +1250,167 @@ bool kbase_sticky_resource_release(struct kbase_context *kctx,
  */
 void kbase_sticky_resource_term(struct kbase_context *kctx);
 
+/*
+ * Max number of imported dma-bufs a context keeps mapped on the GPU while no
+ * atom uses them
+ */
+#define KBASE_UMM_CACHE_MAX_IDLE 32
+
+/*
+ * Default max number of pages of imported user buffers a context keeps pinned
+ * while no atom uses them
+ */
+#define KBASE_USER_BUF_CACHE_BUDGET (SZ_64M >> PAGE_SHIFT)
+
+#ifdef CONFIG_MMU_NOTIFIER
+/**
+ * kbase_user_buf_cache_init - Initialize the user buffer pin cache of a
+ *                             context.
+ * @kctx: kbase context
+ *
+ * When the last atom using an imported user buffer completes, its pages are
+ * kept pinned and mapped on the GPU rather than released, so the next atom
+ * listing the same buffer skips get_user_pages() and the DMA mapping. An MMU
+ * notifier drops idle buffers whose pages are unmapped or copied on write,
+ * and the least recently used ones are dropped to stay within the budget.
+ *
+ * Returns zero on success or negative error number on failure.
+ */
+int kbase_user_buf_cache_init(struct kbase_context *kctx);
+
+/**
+ * kbase_user_buf_cache_attach - Track the address space of an importer.
+ * @kctx: kbase context
+ * @mm:   Address space user buffers are being imported from
+ *
+ * Registers the MMU notifier of the cache with @mm on the first import. Must
+ * be called without the region lock or @mm's mmap_sem held.
+ */
+void kbase_user_buf_cache_attach(struct kbase_context *kctx,
+		struct mm_struct *mm);
+
+/**
+ * kbase_user_buf_cache_term - Unpin all idle user buffers of a context.
+ * @kctx: kbase context
+ *
+ * Must be called with the region lock held, after the sticky resources have
+ * been released.
+ */
+void kbase_user_buf_cache_term(struct kbase_context *kctx);
+
+/**
+ * kbase_user_buf_cache_detach - Unregister the MMU notifier of the cache.
+ * @kctx: kbase context
+ *
+ * Must be called after kbase_user_buf_cache_term(), without the region lock
+ * held.
+ */
+void kbase_user_buf_cache_detach(struct kbase_context *kctx);
+
+/**
+ * kbase_user_buf_cache_evict - Unpin an idle user buffer, if cached.
+ * @kctx:  kbase context
+ * @alloc: The imported allocation
+ *
+ * Must be called with the region lock held.
+ */
+void kbase_user_buf_cache_evict(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc);
+
+#ifdef CONFIG_DEBUG_FS
+/**
+ * kbase_user_buf_cache_debugfs_init - Add per context debugfs entry for the
+ *                                     user buffer pin cache.
+ * @kctx: kbase context
+ */
+void kbase_user_buf_cache_debugfs_init(struct kbase_context *kctx);
+#endif /* CONFIG_DEBUG_FS */
+#else
+static inline int kbase_user_buf_cache_init(struct kbase_context *kctx)
+{
+	return 0;
+}
+
+static inline void kbase_user_buf_cache_attach(struct kbase_context *kctx,
+		struct mm_struct *mm)
+{
+}
+
+static inline void kbase_user_buf_cache_term(struct kbase_context *kctx)
+{
+}
+
+static inline void kbase_user_buf_cache_detach(struct kbase_context *kctx)
+{
+}
+
+static inline void kbase_user_buf_cache_evict(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc)
+{
+}
+
+static inline void kbase_user_buf_cache_debugfs_init(
+		struct kbase_context *kctx)
+{
+}
+#endif /* CONFIG_MMU_NOTIFIER */
+
+#ifdef CONFIG_DMA_SHARED_BUFFER
+/**
+ * kbase_umm_cache_init - Initialize the dma-buf mapping cache of a context.
+ * @kctx: kbase context
+ *
+ * When the last atom using an imported dma-buf completes, its GPU mapping and
+ * sg table are kept rather than torn down, so the next atom listing the same
+ * buffer reuses them. Idle mappings are dropped when the cache is full, when
+ * the region is freed or its flags change, and under memory pressure.
+ *
+ * Returns zero on success or negative error number on failure.
+ */
+int kbase_umm_cache_init(struct kbase_context *kctx);
+
+/**
+ * kbase_umm_cache_term - Drop all idle dma-buf mappings of a context.
+ * @kctx: kbase context
+ *
+ * Must be called with the region lock held, after the sticky resources have
+ * been released.
+ */
+void kbase_umm_cache_term(struct kbase_context *kctx);
+
+/**
+ * kbase_umm_cache_evict - Drop the idle GPU mapping of an import, if any.
+ * @kctx:  kbase context
+ * @alloc: The imported allocation
+ *
+ * Must be called with the region lock held.
+ */
+void kbase_umm_cache_evict(struct kbase_context *kctx,
+		struct kbase_mem_phy_alloc *alloc);
+
+#ifdef CONFIG_DEBUG_FS
+/**
+ * kbase_umm_cache_debugfs_init - Add per context debugfs entry for the
+ *                                dma-buf mapping cache.
+ * @kctx: kbase context
+ */
+void kbase_umm_cache_debugfs_init(struct kbase_context *kctx);
+#endif /* CONFIG_DEBUG_FS */
+#else
+static inline int kbase_umm_cache_init(struct kbase_context *kctx)
+{
+	return 0;
+}
+
+static inline void kbase_umm_cache_term(struct kbase_context *kctx)
+{
+}
+
+static inline void kbase_umm_cache_debugfs_init(struct kbase_context *kctx)
+{
+}
+#endif /* CONFIG_DMA_SHARED_BUFFER */
+
 /**
  * kbase_zone_cache_update - Update the memory zone cache after new pages have
  * been added.
@@ -801,6 +801,7 @@ int kbase_mem_flags_change(struct kbase_context *kctx, u64 gpu_addr, unsigned in
 		 */
 		ret = 0;
 		WARN_ON(reg->gpu_alloc->imported.umm.current_mapping_usage_count);
+		kbase_umm_cache_evict(kctx, reg->gpu_alloc);
 		break;
 #endif
 	default:
@@ -1013,6 +1014,8 @@ static struct kbase_va_region *kbase_mem_from_umm(struct kbase_context *kctx, in
 	reg->gpu_alloc->imported.umm.dma_buf = dma_buf;
 	reg->gpu_alloc->imported.umm.dma_attachment = dma_attachment;
 	reg->gpu_alloc->imported.umm.current_mapping_usage_count = 0;
+	INIT_LIST_HEAD(&reg->gpu_alloc->imported.umm.cache_node);
+	reg->gpu_alloc->imported.umm.cache_reg = NULL;
 	reg->extent = 0;
 
 	return reg;
@@ -1156,6 +1159,10 @@ static struct kbase_va_region *kbase_mem_from_user_buffer(
 	reg->gpu_alloc->nents = 0;
 	reg->extent = 0;
 
+	INIT_LIST_HEAD(&reg->gpu_alloc->imported.user_buf.cache_node);
+	reg->gpu_alloc->imported.user_buf.cache_reg = NULL;
+	kbase_user_buf_cache_attach(kctx, current->mm);
+
 	return reg;
 
 no_page_array:
@@ -22,6 +22,7 @@
 #include <linux/spinlock.h>
 #include <linux/shrinker.h>
 #include <linux/atomic.h>
+#include <linux/kthread.h>
 #include <linux/version.h>
 
 #define pool_dbg(pool, format, ...) \
@@ -113,7 +114,7 @@ static struct page *kbase_mem_pool_remove_locked(struct kbase_mem_pool *pool)
 
 	lockdep_assert_held(&pool->pool_lock);
 
-	if (kbase_mem_pool_is_empty(pool))
+	if (list_empty(&pool->page_list))
 		return NULL;
 
 	p = list_first_entry(&pool->page_list, struct page, lru);
@@ -127,17 +128,48 @@ static struct page *kbase_mem_pool_remove_locked(struct kbase_mem_pool *pool)
 	return p;
 }
 
-static struct page *kbase_mem_pool_remove(struct kbase_mem_pool *pool)
+static struct page *kbase_mem_pool_remove_dirty_locked(
+		struct kbase_mem_pool *pool)
 {
 	struct page *p;
 
-	kbase_mem_pool_lock(pool);
-	p = kbase_mem_pool_remove_locked(pool);
-	kbase_mem_pool_unlock(pool);
+	lockdep_assert_held(&pool->pool_lock);
+
+	if (list_empty(&pool->dirty_list))
+		return NULL;
+
+	p = list_first_entry(&pool->dirty_list, struct page, lru);
+	list_del_init(&p->lru);
+	pool->dirty_size--;
+	pool->cur_size--;
+
+	zone_page_state_add(-1, page_zone(p), NR_SLAB_RECLAIMABLE);
+
+	pool_dbg(pool, "removed dirty page\n");
+
+	return p;
+}
+
+/* Dirty pages are removed first as they are the cheapest to give back */
+static struct page *kbase_mem_pool_remove_any_locked(
+		struct kbase_mem_pool *pool)
+{
+	struct page *p = kbase_mem_pool_remove_dirty_locked(pool);
+
+	if (!p)
+		p = kbase_mem_pool_remove_locked(pool);
 
 	return p;
 }
 
+static bool kbase_mem_pool_zero_needed(struct kbase_mem_pool *pool)
+{
+	size_t dirty_size = ACCESS_ONCE(pool->dirty_size);
+
+	return dirty_size && (dirty_size >= pool->dirty_wmark ||
+			kbase_mem_pool_size(pool) == dirty_size);
+}
+
 static void kbase_mem_pool_sync_page(struct kbase_mem_pool *pool,
 		struct page *p)
 {
@@ -154,16 +186,135 @@ static void kbase_mem_pool_zero_page(struct kbase_mem_pool *pool,
 	kbase_mem_pool_sync_page(pool, p);
 }
 
+/**
+ * kbase_mem_pool_add_dirty_list - spill pages that must be zeroed to a pool
+ * @pool:      Pool receiving the pages
+ * @page_list: Pages to add
+ * @nr_pages:  Number of pages in @page_list
+ *
+ * Pages are queued on the dirty list of @pool, up to its maximum number of
+ * dirty pages. Pages above that, or all of them if @pool has no zeroing
+ * thread, are zeroed before being added.
+ */
+static void kbase_mem_pool_add_dirty_list(struct kbase_mem_pool *pool,
+		struct list_head *page_list, size_t nr_pages)
+{
+	struct page *p, *tmp;
+	size_t dirty_size = ACCESS_ONCE(pool->dirty_size);
+	size_t nr_dirty = 0;
+	size_t room = 0;
+	LIST_HEAD(dirty_list);
+
+	if (!nr_pages)
+		return;
+
+	if (pool->zero_thread && pool->dirty_max > dirty_size)
+		room = pool->dirty_max - dirty_size;
+
+	/* Zero pages that do not fit without holding the pool lock */
+	list_for_each_entry_safe(p, tmp, page_list, lru) {
+		if (nr_dirty < room) {
+			list_move(&p->lru, &dirty_list);
+			nr_dirty++;
+		} else {
+			kbase_mem_pool_zero_page(pool, p);
+		}
+	}
+
+	kbase_mem_pool_lock(pool);
+	kbase_mem_pool_add_list_locked(pool, page_list, nr_pages - nr_dirty);
+	if (nr_dirty) {
+		list_for_each_entry(p, &dirty_list, lru) {
+			zone_page_state_add(1, page_zone(p),
+					NR_SLAB_RECLAIMABLE);
+		}
+		list_splice(&dirty_list, &pool->dirty_list);
+		pool->dirty_size += nr_dirty;
+		pool->cur_size += nr_dirty;
+	}
+	kbase_mem_pool_unlock(pool);
+
+	pool_dbg(pool, "added %zu pages, %zu dirty\n", nr_pages, nr_dirty);
+
+	if (kbase_mem_pool_zero_needed(pool))
+		wake_up(&pool->zero_wait);
+}
+
 static void kbase_mem_pool_spill(struct kbase_mem_pool *next_pool,
 		struct page *p)
 {
-	/* Zero page before spilling */
-	kbase_mem_pool_zero_page(next_pool, p);
+	LIST_HEAD(spill_list);
+
+	list_add(&p->lru, &spill_list);
+	kbase_mem_pool_add_dirty_list(next_pool, &spill_list, 1);
+}
+
+static struct page *kbase_mem_pool_remove(struct kbase_mem_pool *pool)
+{
+	struct page *p;
+	bool dirty = false;
+
+	kbase_mem_pool_lock(pool);
+	p = kbase_mem_pool_remove_locked(pool);
+	if (!p) {
+		p = kbase_mem_pool_remove_dirty_locked(pool);
+		dirty = p != NULL;
+	}
+	kbase_mem_pool_unlock(pool);
+
+	if (dirty) {
+		/* The zeroing thread is lagging behind */
+		kbase_mem_pool_zero_page(pool, p);
+		wake_up(&pool->zero_wait);
+	}
+
+	return p;
+}
+
+static int kbase_mem_pool_zero_thread(void *data)
+{
+	struct kbase_mem_pool *pool = data;
+
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		struct page *p;
+
+		wait_event_interruptible(pool->zero_wait,
+				kthread_should_stop() ||
+				kbase_mem_pool_zero_needed(pool));
+
+		while (!kthread_should_stop()) {
+			kbase_mem_pool_lock(pool);
+			p = kbase_mem_pool_remove_dirty_locked(pool);
+			kbase_mem_pool_unlock(pool);
+			if (!p)
+				break;
+
+			kbase_mem_pool_zero_page(pool, p);
+			kbase_mem_pool_add(pool, p);
+
+			cond_resched();
+		}
+	}
+
+	return 0;
+}
+
+void kbase_mem_pool_set_dirty_wmark(struct kbase_mem_pool *pool, size_t wmark)
+{
+	pool->dirty_wmark = wmark;
+	if (kbase_mem_pool_zero_needed(pool))
+		wake_up(&pool->zero_wait);
+}
 
-	kbase_mem_pool_add(next_pool, p);
+void kbase_mem_pool_set_dirty_max(struct kbase_mem_pool *pool,
+		size_t dirty_max)
+{
+	pool->dirty_max = dirty_max;
 }
 
-struct page *kbase_mem_alloc_page(struct kbase_device *kbdev)
+struct page *kbase_mem_alloc_page(struct kbase_device *kbdev, int node)
 {
 	struct page *p;
 	gfp_t gfp;
@@ -184,7 +335,7 @@ struct page *kbase_mem_alloc_page(struct kbase_device *kbdev)
 		gfp |= __GFP_NORETRY;
 	}
 
-	p = alloc_page(gfp);
+	p = alloc_pages_node(node, gfp, 0);
 	if (!p)
 		return NULL;
 
@@ -223,7 +374,7 @@ static size_t kbase_mem_pool_shrink_locked(struct kbase_mem_pool *pool,
 	lockdep_assert_held(&pool->pool_lock);
 
 	for (i = 0; i < nr_to_shrink && !kbase_mem_pool_is_empty(pool); i++) {
-		p = kbase_mem_pool_remove_locked(pool);
+		p = kbase_mem_pool_remove_any_locked(pool);
 		kbase_mem_pool_free_page(pool, p);
 	}
 
@@ -249,7 +400,7 @@ int kbase_mem_pool_grow(struct kbase_mem_pool *pool,
 	size_t i;
 
 	for (i = 0; i < nr_to_grow; i++) {
-		p = kbase_mem_alloc_page(pool->kbdev);
+		p = kbase_mem_alloc_page(pool->kbdev, pool->node);
 		if (!p)
 			return -ENOMEM;
 		kbase_mem_pool_add(pool, p);
@@ -273,6 +424,100 @@ void kbase_mem_pool_trim(struct kbase_mem_pool *pool, size_t new_size)
 		kbase_mem_pool_grow(pool, new_size - cur_size);
 }
 
+/* Shrink the pool, spilling as many pages as fit into the next pool */
+static void kbase_mem_pool_tune_shrink(struct kbase_mem_pool *pool,
+		size_t nr_to_shrink)
+{
+	struct kbase_mem_pool *next_pool = pool->next_pool;
+	struct page *p;
+	size_t nr_to_spill = 0;
+	LIST_HEAD(spill_list);
+	size_t i;
+
+	kbase_mem_pool_lock(pool);
+
+	nr_to_shrink = min(nr_to_shrink, kbase_mem_pool_size(pool));
+	if (next_pool)
+		nr_to_spill = min(nr_to_shrink,
+				kbase_mem_pool_capacity(next_pool));
+
+	for (i = 0; i < nr_to_spill; i++) {
+		p = kbase_mem_pool_remove_any_locked(pool);
+		list_add(&p->lru, &spill_list);
+	}
+	kbase_mem_pool_shrink_locked(pool, nr_to_shrink - nr_to_spill);
+
+	kbase_mem_pool_unlock(pool);
+
+	if (nr_to_spill)
+		kbase_mem_pool_add_dirty_list(next_pool, &spill_list,
+				nr_to_spill);
+
+	pool_dbg(pool, "tune shrunk %zu pages, spilled %zu\n",
+			nr_to_shrink, nr_to_spill);
+}
+
+void kbase_mem_pool_refill(struct kbase_mem_pool *pool)
+{
+	size_t target = min(pool->target, kbase_mem_pool_max_size(pool));
+	size_t cur_size = kbase_mem_pool_size(pool);
+	size_t nr_to_grow;
+	struct page *p;
+	size_t i;
+
+	if (cur_size >= target)
+		return;
+
+	nr_to_grow = min_t(size_t, target - cur_size,
+			KBASE_MEM_POOL_TUNE_BATCH);
+
+	for (i = 0; i < nr_to_grow; i++) {
+		p = NULL;
+		if (pool->next_pool)
+			p = kbase_mem_pool_remove(pool->next_pool);
+		if (!p)
+			p = kbase_mem_alloc_page(pool->kbdev, pool->node);
+		if (!p)
+			break;
+
+		kbase_mem_pool_add(pool, p);
+		cond_resched();
+	}
+
+	pool_dbg(pool, "tune refilled %zu pages\n", i);
+}
+
+bool kbase_mem_pool_tune(struct kbase_mem_pool *pool)
+{
+	size_t demand = atomic_xchg(&pool->nr_alloc, 0);
+	size_t target = pool->target;
+	size_t cur_size;
+
+	/* Follow bursts up at once, decay geometrically otherwise */
+	target -= DIV_ROUND_UP(target, KBASE_MEM_POOL_TUNE_DECAY);
+	target = max(target, demand);
+	target = min(target, kbase_mem_pool_max_size(pool));
+	pool->target = target;
+
+	if (demand)
+		pool->idle_periods = 0;
+	else if (pool->idle_periods < KBASE_MEM_POOL_TUNE_IDLE_PERIODS)
+		pool->idle_periods++;
+
+	if (pool->idle_periods < KBASE_MEM_POOL_TUNE_IDLE_PERIODS) {
+		kbase_mem_pool_refill(pool);
+		return true;
+	}
+
+	/* Idle, give back what we no longer expect to need before the
+	 * kernel has to ask for it */
+	cur_size = kbase_mem_pool_size(pool);
+	if (cur_size > target)
+		kbase_mem_pool_tune_shrink(pool, cur_size - target);
+
+	return target != 0;
+}
+
 void kbase_mem_pool_set_max_size(struct kbase_mem_pool *pool, size_t max_size)
 {
 	size_t cur_size;
@@ -332,6 +577,7 @@ static int kbase_mem_pool_reclaim_shrink(struct shrinker *s,
 
 int kbase_mem_pool_init(struct kbase_mem_pool *pool,
 		size_t max_size,
+		int node,
 		struct kbase_device *kbdev,
 		struct kbase_mem_pool *next_pool)
 {
@@ -339,10 +585,37 @@ int kbase_mem_pool_init(struct kbase_mem_pool *pool,
 	pool->max_size = max_size;
 	pool->kbdev = kbdev;
 	pool->next_pool = next_pool;
+	pool->node = node;
 
 	spin_lock_init(&pool->pool_lock);
 	INIT_LIST_HEAD(&pool->page_list);
 
+	INIT_LIST_HEAD(&pool->dirty_list);
+	INIT_LIST_HEAD(&pool->tune_link);
+	pool->dirty_size = 0;
+	pool->dirty_wmark = KBASE_MEM_POOL_DIRTY_WMARK;
+	pool->dirty_max = KBASE_MEM_POOL_DIRTY_MAX;
+	init_waitqueue_head(&pool->zero_wait);
+	pool->zero_thread = NULL;
+
+	atomic_set(&pool->nr_alloc, 0);
+	pool->target = 0;
+	pool->idle_periods = 0;
+
+	if (!next_pool) {
+		/* Only pools at the end of the chain receive spilled pages */
+		pool->zero_thread = kthread_create_on_node(
+				kbase_mem_pool_zero_thread, pool, node,
+				"mali_pool_zero/%d", node);
+		if (IS_ERR(pool->zero_thread)) {
+			dev_warn(kbdev->dev,
+				"Failed to start pool zeroing thread, pages will be zeroed when spilled\n");
+			pool->zero_thread = NULL;
+		} else {
+			wake_up_process(pool->zero_thread);
+		}
+	}
+
 	/* Register shrinker */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3, 12, 0)
 	pool->reclaim.shrink = kbase_mem_pool_reclaim_shrink;
@@ -373,6 +646,9 @@ void kbase_mem_pool_term(struct kbase_mem_pool *pool)
 
 	pool_dbg(pool, "terminate()\n");
 
+	if (pool->zero_thread)
+		kthread_stop(pool->zero_thread);
+
 	unregister_shrinker(&pool->reclaim);
 
 	kbase_mem_pool_lock(pool);
@@ -383,17 +659,16 @@ void kbase_mem_pool_term(struct kbase_mem_pool *pool)
 		nr_to_spill = kbase_mem_pool_capacity(next_pool);
 		nr_to_spill = min(kbase_mem_pool_size(pool), nr_to_spill);
 
-		/* Zero pages first without holding the next_pool lock */
+		/* Pages are zeroed by next_pool, without holding our lock */
 		for (i = 0; i < nr_to_spill; i++) {
-			p = kbase_mem_pool_remove_locked(pool);
-			kbase_mem_pool_zero_page(pool, p);
+			p = kbase_mem_pool_remove_any_locked(pool);
 			list_add(&p->lru, &spill_list);
 		}
 	}
 
 	while (!kbase_mem_pool_is_empty(pool)) {
 		/* Free remaining pages to kernel */
-		p = kbase_mem_pool_remove_locked(pool);
+		p = kbase_mem_pool_remove_any_locked(pool);
 		kbase_mem_pool_free_page(pool, p);
 	}
 
@@ -401,7 +676,8 @@ void kbase_mem_pool_term(struct kbase_mem_pool *pool)
 
 	if (next_pool && nr_to_spill) {
 		/* Add new page list to next_pool */
-		kbase_mem_pool_add_list(next_pool, &spill_list, nr_to_spill);
+		kbase_mem_pool_add_dirty_list(next_pool, &spill_list,
+				nr_to_spill);
 
 		pool_dbg(pool, "terminate() spilled %zu pages\n", nr_to_spill);
 	}
@@ -413,8 +689,11 @@ struct page *kbase_mem_pool_alloc(struct kbase_mem_pool *pool)
 {
 	struct page *p;
 
+	kbase_mem_pool_tuner_kick(pool->kbdev);
+
 	do {
 		pool_dbg(pool, "alloc()\n");
+		atomic_inc(&pool->nr_alloc);
 		p = kbase_mem_pool_remove(pool);
 
 		if (p)
@@ -455,18 +734,43 @@ int kbase_mem_pool_alloc_pages(struct kbase_mem_pool *pool, size_t nr_pages,
 	size_t nr_from_pool;
 	size_t i;
 	int err = -ENOMEM;
+	LIST_HEAD(dirty_list);
 
 	pool_dbg(pool, "alloc_pages(%zu):\n", nr_pages);
 
-	/* Get pages from this pool */
+	atomic_add(nr_pages, &pool->nr_alloc);
+	kbase_mem_pool_tuner_kick(pool->kbdev);
+
+	/* Get pages from this pool, clean ones first */
 	kbase_mem_pool_lock(pool);
 	nr_from_pool = min(nr_pages, kbase_mem_pool_size(pool));
 	for (i = 0; i < nr_from_pool; i++) {
 		p = kbase_mem_pool_remove_locked(pool);
+		if (!p) {
+			p = kbase_mem_pool_remove_dirty_locked(pool);
+			list_add(&p->lru, &dirty_list);
+			continue;
+		}
 		pages[i] = page_to_phys(p);
 	}
 	kbase_mem_pool_unlock(pool);
 
+	if (!list_empty(&dirty_list)) {
+		/* The zeroing thread is lagging behind, zero the remaining
+		 * pages ourselves. They were taken once the clean pages ran
+		 * out, so they fill the end of the range. */
+		struct page *tmp;
+
+		i = nr_from_pool;
+		list_for_each_entry_safe(p, tmp, &dirty_list, lru) {
+			list_del_init(&p->lru);
+			kbase_mem_pool_zero_page(pool, p);
+			pages[--i] = page_to_phys(p);
+		}
+		i = nr_from_pool;
+		wake_up(&pool->zero_wait);
+	}
+
 	if (i != nr_pages && pool->next_pool) {
 		/* Allocate via next pool */
 		err = kbase_mem_pool_alloc_pages(pool->next_pool,
@@ -480,7 +784,7 @@ int kbase_mem_pool_alloc_pages(struct kbase_mem_pool *pool, size_t nr_pages,
 
 	/* Get any remaining pages from kernel */
 	for (; i < nr_pages; i++) {
-		p = kbase_mem_alloc_page(pool->kbdev);
+		p = kbase_mem_alloc_page(pool->kbdev, pool->node);
 		if (!p)
 			goto err_rollback;
 		pages[i] = page_to_phys(p);
@@ -509,16 +813,14 @@ static void kbase_mem_pool_add_array(struct kbase_mem_pool *pool,
 	pool_dbg(pool, "add_array(%zu, zero=%d, sync=%d):\n",
 			nr_pages, zero, sync);
 
-	/* Zero/sync pages first without holding the pool lock */
+	/* Sync pages first without holding the pool lock */
 	for (i = 0; i < nr_pages; i++) {
 		if (unlikely(!pages[i]))
 			continue;
 
 		p = phys_to_page(pages[i]);
 
-		if (zero)
-			kbase_mem_pool_zero_page(pool, p);
-		else if (sync)
+		if (!zero && sync)
 			kbase_mem_pool_sync_page(pool, p);
 
 		list_add(&p->lru, &new_page_list);
@@ -526,8 +828,11 @@ static void kbase_mem_pool_add_array(struct kbase_mem_pool *pool,
 		pages[i] = 0;
 	}
 
-	/* Add new page list to pool */
-	kbase_mem_pool_add_list(pool, &new_page_list, nr_to_pool);
+	/* Add new page list to pool, pages to zero are left to the pool */
+	if (zero)
+		kbase_mem_pool_add_dirty_list(pool, &new_page_list, nr_to_pool);
+	else
+		kbase_mem_pool_add_list(pool, &new_page_list, nr_to_pool);
 
 	pool_dbg(pool, "add_array(%zu) added %zu pages\n",
 			nr_pages, nr_to_pool);
@@ -78,4 +78,47 @@ void kbase_mem_pool_debugfs_init(struct dentry *parent,
 			pool, &kbase_mem_pool_debugfs_max_size_fops);
 }
 
+static int kbase_mem_pool_nodes_debugfs_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_device *kbdev = sfile->private;
+	int node;
+
+	seq_printf(sfile, "preferred node: %d\n",
+			kbase_mem_preferred_node(kbdev));
+	seq_puts(sfile, "node       size   max_size      dirty     target\n");
+
+	for_each_node(node) {
+		struct kbase_mem_pool *pool = &kbdev->mem_pools[node];
+
+		seq_printf(sfile, "%4d %10zu %10zu %10zu %10zu\n", node,
+				kbase_mem_pool_size(pool),
+				kbase_mem_pool_max_size(pool),
+				READ_ONCE(pool->dirty_size),
+				READ_ONCE(pool->target));
+	}
+
+	return 0;
+}
+
+static int kbase_mem_pool_nodes_debugfs_open(struct inode *in,
+		struct file *file)
+{
+	return single_open(file, kbase_mem_pool_nodes_debugfs_show,
+			in->i_private);
+}
+
+static const struct file_operations kbase_mem_pool_nodes_debugfs_fops = {
+	.open = kbase_mem_pool_nodes_debugfs_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kbase_mem_pool_nodes_debugfs_init(struct dentry *parent,
+		struct kbase_device *kbdev)
+{
+	debugfs_create_file("mem_pools", S_IRUGO, parent, kbdev,
+			&kbase_mem_pool_nodes_debugfs_fops);
+}
+
 #endif /* CONFIG_DEBUG_FS */
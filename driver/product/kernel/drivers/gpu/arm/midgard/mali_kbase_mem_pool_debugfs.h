@@ -32,5 +32,17 @@
 void kbase_mem_pool_debugfs_init(struct dentry *parent,
 		struct kbase_mem_pool *pool);
 
+/**
+ * kbase_mem_pool_nodes_debugfs_init - add debugfs file for the device pools
+ * @parent: Parent debugfs dentry
+ * @kbdev:  Kbase device owning one memory pool per NUMA node
+ *
+ * Adds a read-only debugfs file mem_pools under @parent listing, per node, the
+ * size, max size, number of pages still waiting to be zeroed and autotuned
+ * target size.
+ */
+void kbase_mem_pool_nodes_debugfs_init(struct dentry *parent,
+		struct kbase_device *kbdev);
+
 #endif  /*_KBASE_MEM_POOL_DEBUGFS_H*/
 
@@ -0,0 +1,216 @@
+/*
+ *
+ * (C) COPYRIGHT 2017 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+/*
+ * Memory pool autotuner
+ *
+ * Pools normally only grow on demand, so a burst of allocations is served by
+ * the kernel page allocator. The autotuner samples the demand on the device
+ * and context pools every period, keeps them filled up to their recent peak
+ * while they are in use, and gives pages back once they have gone idle.
+ */
+
+#include <linux/workqueue.h>
+
+#include <mali_kbase.h>
+
+/**
+ * kbase_mem_pool_tuner_collect - Gather the pools to tune
+ * @kbdev: The kbase device
+ * @pools: List the pools are added to, through their tune_link
+ *
+ * Device pools come first, context pools refill from them. The context list
+ * lock is only held while the pools are gathered, so pages are not allocated
+ * under it. Contexts removed from the list wait for the tuner lock before
+ * terminating their pool, see kbase_mem_pool_tuner_remove_ctx().
+ */
+static void kbase_mem_pool_tuner_collect(struct kbase_device *kbdev,
+		struct list_head *pools)
+{
+	struct kbasep_kctx_list_element *element;
+	int node;
+
+	lockdep_assert_held(&kbdev->mem_pool_tuner.lock);
+
+	for_each_node(node)
+		list_add_tail(&kbdev->mem_pools[node].tune_link, pools);
+
+	mutex_lock(&kbdev->kctx_list_lock);
+	list_for_each_entry(element, &kbdev->kctx_list, link)
+		list_add_tail(&element->kctx->mem_pool.tune_link, pools);
+	mutex_unlock(&kbdev->kctx_list_lock);
+}
+
+static void kbase_mem_pool_tuner_worker(struct work_struct *data)
+{
+	struct kbase_mem_pool_tuner *tuner = container_of(data,
+			struct kbase_mem_pool_tuner, work.work);
+	struct kbase_device *kbdev = container_of(tuner,
+			struct kbase_device, mem_pool_tuner);
+	struct kbase_mem_pool *pool, *tmp;
+	LIST_HEAD(pools);
+	bool active = false;
+
+	/* Allocations from now on queue the next sample */
+	atomic_set(&tuner->armed, 0);
+
+	mutex_lock(&tuner->lock);
+
+	kbase_mem_pool_tuner_collect(kbdev, &pools);
+	list_for_each_entry_safe(pool, tmp, &pools, tune_link) {
+		active |= kbase_mem_pool_tune(pool);
+		list_del_init(&pool->tune_link);
+	}
+
+	mutex_unlock(&tuner->lock);
+
+	/* Stop sampling once every pool has settled */
+	if (active)
+		kbase_mem_pool_tuner_kick(kbdev);
+}
+
+static void kbase_mem_pool_tuner_refill_worker(struct work_struct *data)
+{
+	struct kbase_mem_pool_tuner *tuner = container_of(data,
+			struct kbase_mem_pool_tuner, refill_work);
+	struct kbase_device *kbdev = container_of(tuner,
+			struct kbase_device, mem_pool_tuner);
+	struct kbase_mem_pool *pool, *tmp;
+	LIST_HEAD(pools);
+
+	mutex_lock(&tuner->lock);
+
+	kbase_mem_pool_tuner_collect(kbdev, &pools);
+	list_for_each_entry_safe(pool, tmp, &pools, tune_link) {
+		kbase_mem_pool_refill(pool);
+		list_del_init(&pool->tune_link);
+	}
+
+	mutex_unlock(&tuner->lock);
+}
+
+void kbase_mem_pool_tuner_init(struct kbase_device *kbdev)
+{
+	struct kbase_mem_pool_tuner *tuner = &kbdev->mem_pool_tuner;
+
+	mutex_init(&tuner->lock);
+	INIT_DELAYED_WORK(&tuner->work, kbase_mem_pool_tuner_worker);
+	INIT_WORK(&tuner->refill_work, kbase_mem_pool_tuner_refill_worker);
+	atomic_set(&tuner->armed, 0);
+	spin_lock_init(&tuner->queue_lock);
+	tuner->stopping = false;
+	tuner->period_ms = KBASE_MEM_POOL_TUNE_PERIOD_MS;
+	tuner->warmup_pages = KBASE_MEM_POOL_WARMUP_PAGES;
+}
+
+void kbase_mem_pool_tuner_term(struct kbase_device *kbdev)
+{
+	struct kbase_mem_pool_tuner *tuner = &kbdev->mem_pool_tuner;
+	unsigned long flags;
+
+	/* Works can not be queued again once stopping is set */
+	spin_lock_irqsave(&tuner->queue_lock, flags);
+	tuner->stopping = true;
+	WRITE_ONCE(tuner->period_ms, 0);
+	spin_unlock_irqrestore(&tuner->queue_lock, flags);
+
+	cancel_delayed_work_sync(&tuner->work);
+	cancel_work_sync(&tuner->refill_work);
+}
+
+void kbase_mem_pool_tuner_kick(struct kbase_device *kbdev)
+{
+	struct kbase_mem_pool_tuner *tuner = &kbdev->mem_pool_tuner;
+	unsigned long flags;
+
+	if (atomic_read(&tuner->armed) || !READ_ONCE(tuner->period_ms))
+		return;
+
+	spin_lock_irqsave(&tuner->queue_lock, flags);
+	if (!tuner->stopping && tuner->period_ms &&
+			!atomic_xchg(&tuner->armed, 1))
+		queue_delayed_work(system_unbound_wq, &tuner->work,
+				msecs_to_jiffies(tuner->period_ms));
+	spin_unlock_irqrestore(&tuner->queue_lock, flags);
+}
+
+void kbase_mem_pool_tuner_refill(struct kbase_device *kbdev)
+{
+	struct kbase_mem_pool_tuner *tuner = &kbdev->mem_pool_tuner;
+	unsigned long flags;
+
+	if (!READ_ONCE(tuner->period_ms))
+		return;
+
+	spin_lock_irqsave(&tuner->queue_lock, flags);
+	if (!tuner->stopping && tuner->period_ms)
+		queue_work(system_unbound_wq, &tuner->refill_work);
+	spin_unlock_irqrestore(&tuner->queue_lock, flags);
+}
+
+void kbase_mem_pool_tuner_warmup(struct kbase_context *kctx)
+{
+	struct kbase_device *kbdev = kctx->kbdev;
+	struct kbase_mem_pool_tuner *tuner = &kbdev->mem_pool_tuner;
+	struct kbase_mem_pool *pool = &kctx->mem_pool;
+	size_t nr_pages = READ_ONCE(tuner->warmup_pages);
+
+	if (!READ_ONCE(tuner->period_ms) || !nr_pages)
+		return;
+
+	mutex_lock(&tuner->lock);
+	pool->target = max(pool->target, nr_pages);
+	pool->idle_periods = 0;
+	mutex_unlock(&tuner->lock);
+
+	kbase_mem_pool_tuner_refill(kbdev);
+	kbase_mem_pool_tuner_kick(kbdev);
+}
+
+void kbase_mem_pool_tuner_remove_ctx(struct kbase_context *kctx)
+{
+	struct kbase_mem_pool_tuner *tuner = &kctx->kbdev->mem_pool_tuner;
+
+	/* A work that gathered the pool before the context left the list
+	 * still holds the lock */
+	mutex_lock(&tuner->lock);
+	WARN_ON(!list_empty(&kctx->mem_pool.tune_link));
+	mutex_unlock(&tuner->lock);
+}
+
+void kbase_mem_pool_tuner_set_period(struct kbase_device *kbdev,
+		unsigned int period_ms)
+{
+	struct kbase_mem_pool_tuner *tuner = &kbdev->mem_pool_tuner;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tuner->queue_lock, flags);
+	if (!tuner->stopping)
+		WRITE_ONCE(tuner->period_ms, period_ms);
+	spin_unlock_irqrestore(&tuner->queue_lock, flags);
+
+	if (period_ms) {
+		kbase_mem_pool_tuner_kick(kbdev);
+		return;
+	}
+
+	/* Disabled, pools are left as they are and only shrink under
+	 * memory pressure again */
+	cancel_delayed_work_sync(&tuner->work);
+	cancel_work_sync(&tuner->refill_work);
+	atomic_set(&tuner->armed, 0);
+}
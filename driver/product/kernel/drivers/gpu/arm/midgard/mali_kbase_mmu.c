@@ -109,17 +109,100 @@ static size_t make_multiple(size_t minimum, size_t multiple)
 	return minimum + multiple - remainder;
 }
 
+/**
+ * kbase_mmu_pf_grow_size - compute the number of pages to grow a region by
+ * @kctx:          context owning the region
+ * @reg:           growable region that faulted
+ * @fault_rel_pfn: faulting page, relative to the start of @reg
+ * @min_pages:     set to the number of pages needed to back the fault, in
+ *                 multiples of the extent of @reg
+ *
+ * Faults landing in the extent right after the backed pages are considered
+ * part of a sequential walk of the region. The prefetch window of the region
+ * doubles on each of them, up to KBASE_PF_GROW_MAX_PAGES, and is reset by any
+ * other fault. Pages beyond @min_pages are only prefetched if the memory pools
+ * hold enough free pages to provide them, counting both allocations of @reg
+ * when its CPU and GPU allocations differ.
+ *
+ * Return: number of pages to grow @reg by, a multiple of its extent unless
+ *         capped by its size, and never less than @min_pages
+ */
+static size_t kbase_mmu_pf_grow_size(struct kbase_context *kctx,
+		struct kbase_va_region *reg, size_t fault_rel_pfn,
+		size_t *min_pages)
+{
+	size_t backed = kbase_reg_current_backed_size(reg);
+	size_t max_pages = reg->nr_pages - backed;
+	struct kbase_mem_pool *pool;
+	size_t new_pages;
+	size_t available = 0;
+	size_t nr_allocs = (reg->cpu_alloc != reg->gpu_alloc) ? 2 : 1;
+	size_t grow;
+
+	new_pages = make_multiple(fault_rel_pfn - backed + 1, reg->extent);
+	new_pages = min(new_pages, max_pages);
+	*min_pages = new_pages;
+
+	if (fault_rel_pfn - backed < reg->extent)
+		reg->pf_window = max_t(size_t, reg->extent,
+				min_t(size_t, reg->pf_window * 2,
+					KBASE_PF_GROW_MAX_PAGES));
+	else
+		reg->pf_window = 0;
+
+	if (reg->pf_window <= new_pages)
+		return new_pages;
+
+	for (pool = &kctx->mem_pool; pool; pool = pool->next_pool)
+		available += kbase_mem_pool_size(pool);
+	available /= nr_allocs;
+	if (available <= new_pages)
+		return new_pages;
+
+	grow = min3(make_multiple(reg->pf_window, reg->extent), max_pages,
+			available);
+	grow -= grow % reg->extent;
+
+	return max(grow, new_pages);
+}
+
+/**
+ * kbase_mmu_pf_alloc_pages - back more pages of a growable region
+ * @reg:       region to grow
+ * @nr_pages:  number of pages to add
+ *
+ * Return: true on success
+ */
+static bool kbase_mmu_pf_alloc_pages(struct kbase_va_region *reg,
+		size_t nr_pages)
+{
+	if (kbase_alloc_phy_pages_helper(reg->gpu_alloc, nr_pages) != 0)
+		return false;
+
+	if (reg->gpu_alloc != reg->cpu_alloc &&
+			kbase_alloc_phy_pages_helper(reg->cpu_alloc,
+				nr_pages) != 0) {
+		kbase_free_phy_pages_helper(reg->gpu_alloc, nr_pages);
+		return false;
+	}
+
+	return true;
+}
+
 void page_fault_worker(struct work_struct *data)
 {
 	u64 fault_pfn;
 	u32 fault_status;
 	size_t new_pages;
+	size_t min_pages;
 	size_t fault_rel_pfn;
 	struct kbase_as *faulting_as;
 	int as_no;
 	struct kbase_context *kctx;
 	struct kbase_device *kbdev;
 	struct kbase_va_region *region;
+	struct kbase_fault_stats *stats;
+	u64 start;
 	int err;
 	bool grown = false;
 
@@ -140,6 +223,12 @@ void page_fault_worker(struct work_struct *data)
 
 	KBASE_DEBUG_ASSERT(kctx->kbdev == kbdev);
 
+	stats = &kctx->fault_stats;
+	start = ktime_to_ns(ktime_get());
+	atomic_inc(&stats->nr_faults);
+	kbase_latency_hist_add(&stats->irq_to_worker,
+			start - faulting_as->fault_ts);
+
 	if (unlikely(faulting_as->protected_mode))
 	{
 		kbase_mmu_report_fault_and_kill(kctx, faulting_as,
@@ -237,6 +326,8 @@ void page_fault_worker(struct work_struct *data)
 				region->start_pfn +
 				kbase_reg_current_backed_size(region));
 
+		atomic_inc(&stats->nr_spurious);
+
 		mutex_lock(&kbdev->mmu_hw_mutex);
 
 		kbase_mmu_hw_clear_fault(kbdev, faulting_as, kctx,
@@ -261,17 +352,12 @@ void page_fault_worker(struct work_struct *data)
 		goto fault_done;
 	}
 
-	new_pages = make_multiple(fault_rel_pfn -
-			kbase_reg_current_backed_size(region) + 1,
-			region->extent);
-
-	/* cap to max vsize */
-	if (new_pages + kbase_reg_current_backed_size(region) >
-			region->nr_pages)
-		new_pages = region->nr_pages -
-				kbase_reg_current_backed_size(region);
+	new_pages = kbase_mmu_pf_grow_size(kctx, region, fault_rel_pfn,
+			&min_pages);
 
 	if (0 == new_pages) {
+		atomic_inc(&stats->nr_spurious);
+
 		mutex_lock(&kbdev->mmu_hw_mutex);
 
 		/* Duplicate of a fault we've already handled, nothing to do */
@@ -289,20 +375,15 @@ void page_fault_worker(struct work_struct *data)
 		goto fault_done;
 	}
 
-	if (kbase_alloc_phy_pages_helper(region->gpu_alloc, new_pages) == 0) {
-		if (region->gpu_alloc != region->cpu_alloc) {
-			if (kbase_alloc_phy_pages_helper(
-					region->cpu_alloc, new_pages) == 0) {
-				grown = true;
-			} else {
-				kbase_free_phy_pages_helper(region->gpu_alloc,
-						new_pages);
-			}
-		} else {
-			grown = true;
-		}
+	start = ktime_to_ns(ktime_get());
+	grown = kbase_mmu_pf_alloc_pages(region, new_pages);
+	if (!grown && new_pages > min_pages) {
+		/* Fall back to growing by the extent */
+		region->pf_window = 0;
+		new_pages = min_pages;
+		grown = kbase_mmu_pf_alloc_pages(region, new_pages);
 	}
-
+	kbase_latency_hist_add(&stats->alloc, ktime_to_ns(ktime_get()) - start);
 
 	if (grown) {
 		u64 pfn_offset;
@@ -313,6 +394,7 @@ void page_fault_worker(struct work_struct *data)
 
 		/* set up the new pages */
 		pfn_offset = kbase_reg_current_backed_size(region) - new_pages;
+		start = ktime_to_ns(ktime_get());
 		/*
 		 * Note:
 		 * Issuing an MMU operation will unlock the MMU and cause the
@@ -325,6 +407,8 @@ void page_fault_worker(struct work_struct *data)
 				region->start_pfn + pfn_offset,
 				&kbase_get_gpu_phy_pages(region)[pfn_offset],
 				new_pages, region->flags);
+		kbase_latency_hist_add(&stats->insert,
+				ktime_to_ns(ktime_get()) - start);
 		if (err) {
 			kbase_free_phy_pages_helper(region->gpu_alloc, new_pages);
 			if (region->gpu_alloc != region->cpu_alloc)
@@ -341,7 +425,13 @@ void page_fault_worker(struct work_struct *data)
 #endif
 		KBASE_TLSTREAM_AUX_PAGEFAULT(kctx->id, (u64)new_pages);
 
+		region->nr_grow_faults++;
+		region->nr_grow_pages += new_pages;
+		atomic_inc(&stats->nr_grown);
+		atomic64_add(new_pages, &stats->nr_pages_grown);
+
 		/* AS transaction begin */
+		start = ktime_to_ns(ktime_get());
 		mutex_lock(&kbdev->mmu_hw_mutex);
 
 		/* flush L2 and unlock the VA (resumes the MMU) */
@@ -368,6 +458,8 @@ void page_fault_worker(struct work_struct *data)
 
 		mutex_unlock(&kbdev->mmu_hw_mutex);
 		/* AS transaction end */
+		kbase_latency_hist_add(&stats->unlock,
+				ktime_to_ns(ktime_get()) - start);
 
 		/* reenable this in the mask */
 		kbase_mmu_hw_enable_fault(kbdev, faulting_as, kctx,
@@ -2056,6 +2148,7 @@ void kbase_mmu_interrupt_process(struct kbase_device *kbdev, struct kbase_contex
 	} else {
 		KBASE_DEBUG_ASSERT(0 == object_is_on_stack(&as->work_pagefault));
 		WARN_ON(work_pending(&as->work_pagefault));
+		as->fault_ts = ktime_to_ns(ktime_get());
 		queue_work(as->pf_wq, &as->work_pagefault);
 		atomic_inc(&kbdev->faults_pending);
 	}
@@ -36,6 +36,7 @@
 #include <linux/ktime.h>
 #include <linux/pfn.h>
 #include <linux/sched.h>
+#include <linux/hash.h>
 
 /* Mask to check cache alignment of data structures */
 #define KBASE_CACHE_ALIGNMENT_MASK		((1<<L1_CACHE_SHIFT)-1)
@@ -128,6 +129,102 @@ static int kbasep_write_soft_event_status(
 	return 0;
 }
 
+static int kbasep_read_timeline(
+		struct kbase_context *kctx, u64 timeline, u64 *value)
+{
+	u64 *mapped_timeline;
+	struct kbase_vmap_struct map;
+
+	mapped_timeline = kbase_vmap(kctx, timeline, sizeof(*mapped_timeline),
+			&map);
+	if (!mapped_timeline)
+		return -EFAULT;
+
+	*value = *mapped_timeline;
+
+	kbase_vunmap(kctx, &map);
+
+	return 0;
+}
+
+/*
+ * Move the timeline forward to @point. A timeline never goes backwards, so
+ * if it is already past @point it is left alone. The resulting value of the
+ * timeline is returned through @value.
+ */
+static int kbasep_advance_timeline(
+		struct kbase_context *kctx, u64 timeline, u64 point, u64 *value)
+{
+	u64 *mapped_timeline;
+	struct kbase_vmap_struct map;
+
+	mapped_timeline = kbase_vmap(kctx, timeline, sizeof(*mapped_timeline),
+			&map);
+	if (!mapped_timeline)
+		return -EFAULT;
+
+	if (*mapped_timeline < point)
+		*mapped_timeline = point;
+	*value = *mapped_timeline;
+
+	kbase_vunmap(kctx, &map);
+
+	return 0;
+}
+
+static struct hlist_head *kbasep_soft_event_bucket(
+		struct kbase_context *kctx, u64 addr)
+{
+	return &kctx->soft_event_waiters[hash_64(addr,
+			KBASEP_SOFT_EVENT_HASH_BITS)];
+}
+
+static void kbasep_soft_event_unindex_locked(struct kbase_jd_atom *katom)
+{
+	lockdep_assert_held(&katom->kctx->waiting_soft_jobs_lock);
+
+	if (!hlist_unhashed(&katom->soft_event.node)) {
+		hlist_del_init(&katom->soft_event.node);
+		katom->kctx->soft_event_nr_waiters--;
+	}
+}
+
+/*
+ * Block a soft job until the event or timeline at @addr reaches @point. The
+ * atom is hashed by @addr so that a signal only has to look at the jobs
+ * waiting on that address, and the value each of them needs is kept in the
+ * atom rather than re-read from GPU memory. @timeline tells whether @addr is
+ * a timeline or an event, so that signals only release waiters of their kind.
+ */
+static void kbasep_add_soft_event_waiter(struct kbase_jd_atom *katom,
+		u64 addr, u64 point, bool timeline)
+{
+	struct kbase_context *kctx = katom->kctx;
+	unsigned long lflags;
+
+	/* Waiters check the event or timeline and are added here under
+	 * jctx.lock, which every signal also holds: soft jobs are processed
+	 * with it held, and kbase_soft_event_update() and
+	 * kbase_timeline_batch() take it. A signal can therefore not slip in
+	 * between the check and this. The timeout worker only finds the atom
+	 * once it is on the waiting list, so it does not matter that the two
+	 * are updated separately.
+	 */
+	lockdep_assert_held(&kctx->jctx.lock);
+
+	katom->soft_event.addr = addr;
+	katom->soft_event.point = point;
+	katom->soft_event.timeline = timeline;
+
+	spin_lock_irqsave(&kctx->waiting_soft_jobs_lock, lflags);
+	hlist_add_head(&katom->soft_event.node,
+			kbasep_soft_event_bucket(kctx, addr));
+	kctx->soft_event_nr_waiters++;
+	spin_unlock_irqrestore(&kctx->waiting_soft_jobs_lock, lflags);
+
+	kbasep_add_waiting_with_timeout(katom);
+}
+
 static int kbase_dump_cpu_gpu_time(struct kbase_jd_atom *katom)
 {
 	struct kbase_vmap_struct map;
@@ -198,33 +295,8 @@ static int kbase_dump_cpu_gpu_time(struct kbase_jd_atom *katom)
 
 static enum base_jd_event_code kbase_fence_trigger(struct kbase_jd_atom *katom, int result)
 {
-	struct sync_pt *pt;
-	struct sync_timeline *timeline;
-
-#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 17, 0)
-	if (!list_is_singular(&katom->fence->pt_list_head)) {
-#else
-	if (katom->fence->num_fences != 1) {
-#endif
-		/* Not exactly one item in the list - so it didn't (directly) come from us */
+	if (kbase_sync_fence_trigger(katom->fence, result))
 		return BASE_JD_EVENT_JOB_CANCELLED;
-	}
-
-#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 17, 0)
-	pt = list_first_entry(&katom->fence->pt_list_head, struct sync_pt, pt_list);
-#else
-	pt = container_of(katom->fence->cbs[0].sync_pt, struct sync_pt, base);
-#endif
-	timeline = sync_pt_parent(pt);
-
-	if (!kbase_sync_timeline_is_ours(timeline)) {
-		/* Fence has a sync_pt which isn't ours! */
-		return BASE_JD_EVENT_JOB_CANCELLED;
-	}
-
-	kbase_sync_signal_pt(pt, result);
-
-	sync_timeline_signal(timeline);
 
 	return (result < 0) ? BASE_JD_EVENT_JOB_CANCELLED : BASE_JD_EVENT_DONE;
 }
@@ -342,50 +414,52 @@ static void kbasep_soft_event_complete_job(struct work_struct *work)
 		kbase_js_sched_all(kctx->kbdev);
 }
 
-void kbasep_complete_triggered_soft_events(struct kbase_context *kctx, u64 evt)
+static void kbasep_complete_soft_event_waiters(struct kbase_context *kctx,
+		u64 addr, u64 value, bool timeline)
 {
-	int cancel_timer = 1;
-	struct list_head *entry, *tmp;
+	struct kbase_jd_atom *katom;
+	struct hlist_node *tmp;
 	unsigned long lflags;
+	bool cancel_timer;
+
+	lockdep_assert_held(&kctx->jctx.lock);
 
 	spin_lock_irqsave(&kctx->waiting_soft_jobs_lock, lflags);
-	list_for_each_safe(entry, tmp, &kctx->waiting_soft_jobs) {
-		struct kbase_jd_atom *katom = list_entry(
-				entry, struct kbase_jd_atom, queue);
+	hlist_for_each_entry_safe(katom, tmp,
+			kbasep_soft_event_bucket(kctx, addr), soft_event.node) {
+		if (katom->soft_event.addr != addr ||
+				katom->soft_event.timeline != timeline ||
+				katom->soft_event.point > value)
+			continue;
 
-		switch (katom->core_req & BASE_JD_REQ_SOFT_JOB_TYPE) {
-		case BASE_JD_REQ_SOFT_EVENT_WAIT:
-			if (katom->jc == evt) {
-				list_del(&katom->queue);
-
-				katom->event_code = BASE_JD_EVENT_DONE;
-				INIT_WORK(&katom->work,
-					  kbasep_soft_event_complete_job);
-				queue_work(kctx->jctx.job_done_wq,
-					   &katom->work);
-			} else {
-				/* There are still other waiting jobs, we cannot
-				 * cancel the timer yet.
-				 */
-				cancel_timer = 0;
-			}
-			break;
-#ifdef CONFIG_MALI_FENCE_DEBUG
-		case BASE_JD_REQ_SOFT_FENCE_WAIT:
-			/* Keep the timer running if fence debug is enabled and
-			 * there are waiting fence jobs.
-			 */
-			cancel_timer = 0;
-			break;
-#endif
-		}
+		kbasep_soft_event_unindex_locked(katom);
+		list_del(&katom->queue);
+
+		katom->event_code = BASE_JD_EVENT_DONE;
+		INIT_WORK(&katom->work, kbasep_soft_event_complete_job);
+		queue_work(kctx->jctx.job_done_wq, &katom->work);
 	}
 
+#ifdef CONFIG_MALI_FENCE_DEBUG
+	/* Keep the timer running if fence debug is enabled and there are
+	 * waiting fence jobs.
+	 */
+	cancel_timer = list_empty(&kctx->waiting_soft_jobs);
+#else
+	/* Only event and timeline waits need the timer */
+	cancel_timer = !kctx->soft_event_nr_waiters;
+#endif
 	if (cancel_timer)
 		del_timer(&kctx->soft_job_timeout);
 	spin_unlock_irqrestore(&kctx->waiting_soft_jobs_lock, lflags);
 }
 
+void kbasep_complete_triggered_soft_events(struct kbase_context *kctx, u64 evt)
+{
+	/* A set event releases every job waiting on it */
+	kbasep_complete_soft_event_waiters(kctx, evt, U64_MAX, false);
+}
+
 #ifdef CONFIG_MALI_FENCE_DEBUG
 static void kbase_fence_debug_check_atom(struct kbase_jd_atom *katom)
 {
@@ -512,9 +586,11 @@ void kbasep_soft_job_timeout_worker(unsigned long data)
 
 		switch (katom->core_req & BASE_JD_REQ_SOFT_JOB_TYPE) {
 		case BASE_JD_REQ_SOFT_EVENT_WAIT:
+		case BASE_JD_REQ_SOFT_TIMELINE_WAIT:
 			/* Take it out of the list to ensure that it
 			 * will be cancelled in all cases
 			 */
+			kbasep_soft_event_unindex_locked(katom);
 			list_del(&katom->queue);
 
 			katom->event_code = BASE_JD_EVENT_JOB_CANCELLED;
@@ -548,7 +624,7 @@ static int kbasep_soft_event_wait(struct kbase_jd_atom *katom)
 	if (status == BASE_JD_SOFT_EVENT_SET)
 		return 0; /* Event already set, nothing to do */
 
-	kbasep_add_waiting_with_timeout(katom);
+	kbasep_add_soft_event_waiter(katom, katom->jc, 0, false);
 
 	return 1;
 }
@@ -600,8 +676,181 @@ out:
 	return err;
 }
 
+/*
+ * Advance a timeline and complete the jobs waiting for the points it has
+ * reached. Must be called with jctx.lock held, which serialises it against
+ * jobs starting to wait on the timeline.
+ */
+static int kbasep_timeline_signal_locked(struct kbase_context *kctx,
+		u64 timeline, u64 point)
+{
+	u64 value;
+	int err;
+
+	lockdep_assert_held(&kctx->jctx.lock);
+
+	err = kbasep_advance_timeline(kctx, timeline, point, &value);
+	if (err)
+		return err;
+
+	kbasep_complete_soft_event_waiters(kctx, timeline, value, true);
+
+	atomic_inc(&kctx->timeline_seq);
+	wake_up_all(&kctx->timeline_wait);
+
+	return 0;
+}
+
+static int kbasep_timeline_wait(struct kbase_jd_atom *katom)
+{
+	struct kbase_context *kctx = katom->kctx;
+	u64 value;
+
+	if (kbasep_read_timeline(kctx, katom->soft_event.addr, &value)) {
+		katom->event_code = BASE_JD_EVENT_JOB_CANCELLED;
+		return 0;
+	}
+
+	if (value >= katom->soft_event.point)
+		return 0; /* Point already reached, nothing to do */
+
+	kbasep_add_soft_event_waiter(katom, katom->soft_event.addr,
+			katom->soft_event.point, true);
+
+	return 1;
+}
+
+static void kbasep_timeline_signal(struct kbase_jd_atom *katom)
+{
+	if (kbasep_timeline_signal_locked(katom->kctx, katom->soft_event.addr,
+			katom->soft_event.point))
+		katom->event_code = BASE_JD_EVENT_JOB_CANCELLED;
+}
+
+static int kbasep_timeline_prepare(struct kbase_jd_atom *katom)
+{
+	struct base_jd_timeline_point point;
+
+	if (copy_from_user(&point, (__user void *)(uintptr_t)katom->jc,
+			sizeof(point)))
+		return -EINVAL;
+
+	/* Keep the timeline within one page for kbase_vmap() */
+	if (point.timeline & (sizeof(u64) - 1))
+		return -EINVAL;
+
+	katom->soft_event.addr = point.timeline;
+	katom->soft_event.point = point.value;
+
+	return 0;
+}
+
+/*
+ * Returns 1 once all (or, with @any, one) of the timelines have reached their
+ * points, 0 if they have not yet and a negative error code if a timeline
+ * could not be read.
+ */
+static int kbasep_timeline_points_reached(struct kbase_context *kctx,
+		const struct base_jd_timeline_point *points, u32 count, bool any)
+{
+	u32 i;
+
+	for (i = 0; i < count; i++) {
+		u64 value;
+		int err;
+
+		err = kbasep_read_timeline(kctx, points[i].timeline, &value);
+		if (err)
+			return err;
+
+		if ((value >= points[i].value) == any)
+			return any;
+	}
+
+	return !any;
+}
+
+/**
+ * kbase_timeline_batch() - Signal or wait on several timelines at once
+ * @kctx:       Pointer to context
+ * @points:     Timelines and the points on them
+ * @count:      Number of entries in @points
+ * @op:         One of the KBASE_TIMELINE_BATCH_* operations
+ * @timeout_ns: How long a wait may block for
+ *
+ * A signal advances each timeline in turn, completing the jobs waiting on
+ * it, and stops at the first timeline that cannot be accessed. A wait only
+ * notices timelines advanced by the driver, either by this call or by a
+ * BASE_JD_REQ_SOFT_TIMELINE_SIGNAL job; other updates are picked up when it
+ * next wakes or times out.
+ *
+ * Return: 0 on success, -ETIMEDOUT if a wait timed out, -ERESTARTSYS if it
+ * was interrupted by a signal, or another negative error code on failure.
+ */
+int kbase_timeline_batch(struct kbase_context *kctx,
+			 const struct base_jd_timeline_point *points,
+			 u32 count, u32 op, u64 timeout_ns)
+{
+	unsigned long remaining;
+	u32 i;
+	int err = 0;
+
+	for (i = 0; i < count; i++)
+		if (points[i].timeline & (sizeof(u64) - 1))
+			return -EINVAL;
+
+	switch (op) {
+	case KBASE_TIMELINE_BATCH_SIGNAL:
+		mutex_lock(&kctx->jctx.lock);
+		for (i = 0; i < count && !err; i++)
+			err = kbasep_timeline_signal_locked(kctx,
+					points[i].timeline, points[i].value);
+		mutex_unlock(&kctx->jctx.lock);
+		return err;
+	case KBASE_TIMELINE_BATCH_WAIT_ALL:
+	case KBASE_TIMELINE_BATCH_WAIT_ANY:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	remaining = msecs_to_jiffies(min_t(u64,
+			DIV_ROUND_UP_ULL(timeout_ns, NSEC_PER_MSEC), UINT_MAX));
+
+	for (;;) {
+		int seq = atomic_read(&kctx->timeline_seq);
+		long ret;
+
+		/* kbase_vmap() may sleep, so the timelines are checked
+		 * outside of wait_event and a change of timeline_seq is
+		 * waited for instead.
+		 */
+		err = kbasep_timeline_points_reached(kctx, points, count,
+				op == KBASE_TIMELINE_BATCH_WAIT_ANY);
+		if (err)
+			return err < 0 ? err : 0;
+
+		if (!remaining)
+			return -ETIMEDOUT;
+
+		ret = wait_event_interruptible_timeout(kctx->timeline_wait,
+				atomic_read(&kctx->timeline_seq) != seq,
+				remaining);
+		if (ret < 0)
+			return ret;
+		remaining = ret;
+	}
+}
+
 static void kbasep_soft_event_cancel_job(struct kbase_jd_atom *katom)
 {
+	struct kbase_context *kctx = katom->kctx;
+	unsigned long lflags;
+
+	spin_lock_irqsave(&kctx->waiting_soft_jobs_lock, lflags);
+	kbasep_soft_event_unindex_locked(katom);
+	spin_unlock_irqrestore(&kctx->waiting_soft_jobs_lock, lflags);
+
 	katom->event_code = BASE_JD_EVENT_JOB_CANCELLED;
 	if (jd_done_nolock(katom, NULL))
 		kbase_js_sched_all(katom->kctx->kbdev);
@@ -1128,6 +1377,9 @@ static int kbase_jit_allocate_process(struct kbase_jd_atom *katom)
 		return 1;
 	}
 
+	/* A frame has started allocating, top the pools up for the rest */
+	kbase_mem_pool_tuner_refill(kctx->kbdev);
+
 	/*
 	 * Write the address of the JIT allocation to the user provided
 	 * GPU allocation.
@@ -1401,6 +1653,11 @@ int kbase_process_soft_job(struct kbase_jd_atom *katom)
 	case BASE_JD_REQ_SOFT_EVENT_RESET:
 		kbasep_soft_event_update_locked(katom, BASE_JD_SOFT_EVENT_RESET);
 		break;
+	case BASE_JD_REQ_SOFT_TIMELINE_WAIT:
+		return kbasep_timeline_wait(katom);
+	case BASE_JD_REQ_SOFT_TIMELINE_SIGNAL:
+		kbasep_timeline_signal(katom);
+		break;
 	case BASE_JD_REQ_SOFT_DEBUG_COPY:
 	{
 		int res = kbase_debug_copy(katom);
@@ -1435,6 +1692,7 @@ void kbase_cancel_soft_job(struct kbase_jd_atom *katom)
 		break;
 #endif
 	case BASE_JD_REQ_SOFT_EVENT_WAIT:
+	case BASE_JD_REQ_SOFT_TIMELINE_WAIT:
 		kbasep_soft_event_cancel_job(katom);
 		break;
 	default:
@@ -1517,6 +1775,9 @@ int kbase_prepare_soft_job(struct kbase_jd_atom *katom)
 		if (katom->jc == 0)
 			return -EINVAL;
 		break;
+	case BASE_JD_REQ_SOFT_TIMELINE_WAIT:
+	case BASE_JD_REQ_SOFT_TIMELINE_SIGNAL:
+		return kbasep_timeline_prepare(katom);
 	case BASE_JD_REQ_SOFT_DEBUG_COPY:
 		return kbase_debug_copy_prepare(katom);
 	case BASE_JD_REQ_SOFT_EXT_RES_MAP:
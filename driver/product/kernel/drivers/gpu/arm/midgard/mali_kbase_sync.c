@@ -179,6 +179,39 @@ void kbase_sync_signal_pt(struct sync_pt *pt, int result)
 	} while (atomic_cmpxchg(&mtl->signalled, signalled, mpt->order) != signalled);
 }
 
+int kbase_sync_fence_trigger(struct sync_fence *fence, int result)
+{
+	struct sync_pt *pt;
+	struct sync_timeline *timeline;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 17, 0)
+	if (!list_is_singular(&fence->pt_list_head)) {
+#else
+	if (fence->num_fences != 1) {
+#endif
+		/* Not exactly one item in the list - so it didn't (directly) come from us */
+		return -EINVAL;
+	}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3, 17, 0)
+	pt = list_first_entry(&fence->pt_list_head, struct sync_pt, pt_list);
+#else
+	pt = container_of(fence->cbs[0].sync_pt, struct sync_pt, base);
+#endif
+	timeline = sync_pt_parent(pt);
+
+	if (!kbase_sync_timeline_is_ours(timeline)) {
+		/* Fence has a sync_pt which isn't ours! */
+		return -EINVAL;
+	}
+
+	kbase_sync_signal_pt(pt, result);
+
+	sync_timeline_signal(timeline);
+
+	return 0;
+}
+
 const char *kbase_sync_status_string(int status)
 {
 	if (status == 0)
@@ -97,6 +97,16 @@ struct sync_pt *kbase_sync_pt_alloc(struct sync_timeline *parent);
  */
 void kbase_sync_signal_pt(struct sync_pt *pt, int result);
 
+/**
+ * kbase_sync_fence_trigger() - Signal the sync point of a fence
+ * @fence:  Fence created by kbase_stream_create_fence()
+ * @result: Negative to signal an error, success otherwise
+ *
+ * Return: 0 on success, -EINVAL if @fence does not hold exactly one sync
+ * point on one of our timelines.
+ */
+int kbase_sync_fence_trigger(struct sync_fence *fence, int result);
+
 /**
  * kbase_sync_status_string() - Get string matching @status
  * @status: Value of fence status.
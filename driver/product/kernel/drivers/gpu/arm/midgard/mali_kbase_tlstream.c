@@ -17,13 +17,19 @@
 
 #include <linux/anon_inodes.h>
 #include <linux/atomic.h>
+#include <linux/cpumask.h>
 #include <linux/file.h>
+#include <linux/jump_label.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/smp.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/stringify.h>
 #include <linux/timer.h>
+#include <linux/vmalloc.h>
 #include <linux/wait.h>
 
 #include <mali_kbase.h>
@@ -58,6 +64,10 @@
  * These value must be defined according to MIPE documentation. */
 #define PACKET_NUMBER_SIZE 4 /* bytes */
 
+/* The offset of the timestamp of the first message in a body packet. */
+#define PACKET_TIMESTAMP_POS \
+	(PACKET_HEADER_SIZE + PACKET_NUMBER_SIZE + sizeof(u32))
+
 /* Packet header - first word.
  * These values must be defined according to MIPE documentation. */
 #define PACKET_STREAMID_POS  0
@@ -163,7 +173,9 @@ enum tl_msg_id_aux {
 	KBASE_AUX_PROTECTED_ENTER_START,
 	KBASE_AUX_PROTECTED_ENTER_END,
 	KBASE_AUX_PROTECTED_LEAVE_START,
-	KBASE_AUX_PROTECTED_LEAVE_END
+	KBASE_AUX_PROTECTED_LEAVE_END,
+	KBASE_AUX_JOB_SAMPLE,
+	KBASE_AUX_FENCE_WAIT
 };
 
 /*****************************************************************************/
@@ -174,6 +186,9 @@ enum tl_msg_id_aux {
  * @buffer: array of buffers
  * @wbi: write buffer index
  * @rbi: read buffer index
+ * @rnext: read buffer index expected by the reader, used to detect packets
+ *         lost in overflows. Only accessed by the reader.
+ * @stype: type of the stream
  * @numbered: if non-zero stream's packets are sequentially numbered
  * @autoflush_counter: counter tracking stream's autoflush state
  *
@@ -191,6 +206,10 @@ enum tl_msg_id_aux {
  * timer will increment the counter by one on every expiry. In case there will
  * be no activity on the buffer during two consecutive timer expiries, stream
  * buffer will be flushed.
+ * Body streams have one instance of this structure per CPU. Messages are
+ * written to the instance of the CPU emitting them, so the lock is only
+ * contended by the autoflush timer and the reader. Packets are numbered by
+ * the reader as they are handed to user space.
  */
 struct tl_stream {
 	spinlock_t lock;
@@ -202,7 +221,9 @@ struct tl_stream {
 
 	atomic_t wbi;
 	atomic_t rbi;
+	unsigned int rnext;
 
+	enum tl_stream_type stype;
 	int      numbered;
 	atomic_t autoflush_counter;
 };
@@ -242,8 +263,45 @@ static const struct {
 	{TL_PACKET_FAMILY_TL, TL_PACKET_CLASS_AUX, TL_PACKET_TYPE_BODY,    1}
 };
 
-/* The timeline streams generated by kernel. */
-static struct tl_stream *tl_stream[TL_STREAM_TYPE_COUNT];
+/* The timeline streams generated by kernel. Body streams have one instance
+ * per CPU, other streams a single instance. */
+static struct tl_stream **tl_stream[TL_STREAM_TYPE_COUNT];
+
+/* The number of instances of each timeline stream. */
+static unsigned int tl_stream_count[TL_STREAM_TYPE_COUNT];
+
+/* Sequence number of the next body packet handed to the reader. */
+static u32 tl_stream_read_seq[TL_STREAM_TYPE_COUNT];
+
+static void kbasep_tlstream_ring_drain_worker(struct work_struct *work);
+
+/**
+ * struct tl_ring - packet ring shared with user space
+ * @mem:        ring memory, control page followed by the packet slots
+ * @ctrl:       control page
+ * @slots:      packet slots
+ * @count:      number of packet slots
+ * @active:     non-zero if submitted packets are moved to the ring
+ * @drain_work: moves submitted packets to the ring
+ *
+ * When the timeline stream descriptor is mapped, submitting a packet kicks
+ * @drain_work, which moves the packets to the ring so user space can consume
+ * them in place without a system call or copy to user. The worker is the
+ * only consumer of the streams, as read() is while the ring is not mapped,
+ * so producers never contend on a shared lock. All fields but @active and
+ * @drain_work are protected by tl_reader_lock.
+ */
+static struct tl_ring {
+	void                           *mem;
+	struct base_tlstream_ring_ctrl *ctrl;
+	char                           *slots;
+	u32                            count;
+	atomic_t                       active;
+	struct work_struct             drain_work;
+} tl_ring = {
+	.drain_work = __WORK_INITIALIZER(tl_ring.drain_work,
+			kbasep_tlstream_ring_drain_worker),
+};
 
 /* Autoflush timer. */
 static struct timer_list autoflush_timer;
@@ -265,6 +323,11 @@ static ssize_t kbasep_tlstream_read(
 		size_t      size,
 		loff_t      *f_pos);
 static unsigned int kbasep_tlstream_poll(struct file *filp, poll_table *wait);
+static int kbasep_tlstream_mmap(struct file *filp, struct vm_area_struct *vma);
+static long kbasep_tlstream_ioctl(
+		struct file   *filp,
+		unsigned int  cmd,
+		unsigned long arg);
 static int kbasep_tlstream_release(struct inode *inode, struct file *filp);
 
 /* The timeline stream file operations structure. */
@@ -272,6 +335,9 @@ static const struct file_operations kbasep_tlstream_fops = {
 	.release = kbasep_tlstream_release,
 	.read    = kbasep_tlstream_read,
 	.poll    = kbasep_tlstream_poll,
+	.mmap    = kbasep_tlstream_mmap,
+	.unlocked_ioctl = kbasep_tlstream_ioctl,
+	.compat_ioctl   = kbasep_tlstream_ioctl,
 };
 
 /* Descriptors of timeline messages transmitted in object events stream. */
@@ -552,6 +618,20 @@ static const struct tp_desc tp_desc_aux[] = {
 		"leave protected mode end",
 		"@p",
 		"gpu"
+	},
+	{
+		KBASE_AUX_JOB_SAMPLE,
+		__stringify(KBASE_AUX_JOB_SAMPLE),
+		"hw counters counted while atom was running",
+		"@pLLLLLLLL",
+		"atom,value0,value1,value2,value3,value4,value5,value6,value7"
+	},
+	{
+		KBASE_AUX_FENCE_WAIT,
+		__stringify(KBASE_AUX_FENCE_WAIT),
+		"atom waited for dma-buf fences",
+		"@pL",
+		"atom,wait_ns"
 	}
 };
 
@@ -568,6 +648,54 @@ static atomic_t tlstream_bytes_generated = {0};
 /* Indicator of whether the timeline stream file descriptor is used. */
 atomic_t kbase_tlstream_enabled = {0};
 
+/* Serializes acquiring, reconfiguring and releasing the timeline stream
+ * descriptor, which all update kbase_tlstream_enabled. */
+static DEFINE_MUTEX(tl_enable_lock);
+
+/* Static keys enabling each class of events. */
+struct static_key kbase_tlstream_key[TL_CLASS_COUNT] = {
+	[0 ... TL_CLASS_COUNT - 1] = STATIC_KEY_INIT_FALSE
+};
+
+/* Classes whose static key is currently enabled, protected by
+ * tl_class_lock. */
+static u32 tl_class_enabled;
+static DEFINE_MUTEX(tl_class_lock);
+
+/**
+ * kbasep_tlstream_set_classes - enable classes of events
+ * @flags: timeline stream flags selecting the classes, zero disables all
+ *         classes
+ */
+static void kbasep_tlstream_set_classes(u32 flags)
+{
+	u32          classes = 0;
+	unsigned int i;
+
+	if (flags & TLSTREAM_ENABLED) {
+		classes = (flags & BASE_TLSTREAM_CLASS_MASK) >>
+			BASE_TLSTREAM_CLASS_SHIFT;
+		if (!classes)
+			classes = BASE_TLSTREAM_CLASS_MASK >>
+				BASE_TLSTREAM_CLASS_SHIFT;
+		if (flags & BASE_TLSTREAM_ENABLE_LATENCY_TRACEPOINTS)
+			classes |= 1u << TL_CLASS_LATENCY;
+	}
+
+	mutex_lock(&tl_class_lock);
+	for (i = 0; i < TL_CLASS_COUNT; i++) {
+		bool want = classes & (1u << i);
+		bool have = tl_class_enabled & (1u << i);
+
+		if (want && !have)
+			static_key_slow_inc(&kbase_tlstream_key[i]);
+		else if (!want && have)
+			static_key_slow_dec(&kbase_tlstream_key[i]);
+	}
+	tl_class_enabled = classes;
+	mutex_unlock(&tl_class_lock);
+}
+
 /*****************************************************************************/
 
 /**
@@ -806,6 +934,20 @@ static void kbasep_timeline_stream_reset(struct tl_stream *stream)
 
 	atomic_set(&stream->wbi, 0);
 	atomic_set(&stream->rbi, 0);
+	stream->rnext = 0;
+}
+
+/**
+ * kbasep_timeline_stream_reset_all - reset all instances of a stream
+ * @stream_type: stream type
+ */
+static void kbasep_timeline_stream_reset_all(enum tl_stream_type stream_type)
+{
+	unsigned int i;
+
+	for (i = 0; i < tl_stream_count[stream_type]; i++)
+		kbasep_timeline_stream_reset(tl_stream[stream_type][i]);
+	tl_stream_read_seq[stream_type] = 0;
 }
 
 /**
@@ -823,6 +965,7 @@ static void kbasep_timeline_stream_init(
 	KBASE_DEBUG_ASSERT(TL_STREAM_TYPE_COUNT > stream_type);
 
 	spin_lock_init(&stream->lock);
+	stream->stype = stream_type;
 
 	/* All packets carrying tracepoints shall be numbered. */
 	if (TL_PACKET_TYPE_BODY == tl_stream_cfg[stream_type].pkt_type)
@@ -839,7 +982,7 @@ static void kbasep_timeline_stream_init(
 				tl_stream_cfg[stream_type].stream_id,
 				stream->numbered);
 
-	kbasep_timeline_stream_reset(tl_stream[stream_type]);
+	kbasep_timeline_stream_reset(stream);
 }
 
 /**
@@ -851,6 +994,25 @@ static void kbasep_timeline_stream_term(struct tl_stream *stream)
 	KBASE_DEBUG_ASSERT(stream);
 }
 
+/**
+ * kbasep_tlstream_packet_seq - return the number of a packet handed to user
+ * @stream:     pointer to the stream structure
+ * @rb_idx_raw: read buffer index of the packet
+ *
+ * Packets are numbered in the order they are handed to user space, leaving
+ * a gap for packets of this stream instance lost in overflows so that the
+ * user can still detect them.
+ *
+ * Return: packet number
+ */
+static u32 kbasep_tlstream_packet_seq(
+		struct tl_stream *stream,
+		unsigned int     rb_idx_raw)
+{
+	return tl_stream_read_seq[stream->stype] +
+		(rb_idx_raw - stream->rnext);
+}
+
 /**
  * kbasep_tlstream_msgbuf_submit - submit packet to the user space
  * @stream:     pointer to the stream structure
@@ -892,8 +1054,12 @@ static size_t kbasep_tlstream_msgbuf_submit(
 	wb_idx_raw++;
 	atomic_set(&stream->wbi, wb_idx_raw);
 
-	/* Inform user that packets are ready for reading. */
-	wake_up_interruptible(&tl_event_queue);
+	if (atomic_read(&tl_ring.active))
+		/* Hand the packet over through the mapped ring. */
+		schedule_work(&tl_ring.drain_work);
+	else
+		/* Inform user that packets are ready for reading. */
+		wake_up_interruptible(&tl_event_queue);
 
 	/* Detect and mark overflow in this stream. */
 	if (PACKET_COUNT == wb_idx_raw - rb_idx_raw) {
@@ -913,14 +1079,29 @@ static size_t kbasep_tlstream_msgbuf_submit(
 	return wb_size;
 }
 
+/**
+ * kbasep_tlstream_local - return the stream instance used by this CPU
+ * @stream_type: type of the stream
+ *
+ * Return: the stream instance, stable until interrupts are enabled again
+ */
+static struct tl_stream *kbasep_tlstream_local(enum tl_stream_type stream_type)
+{
+	if (tl_stream_count[stream_type] == 1)
+		return tl_stream[stream_type][0];
+
+	return tl_stream[stream_type][smp_processor_id()];
+}
+
 /**
  * kbasep_tlstream_msgbuf_acquire - lock selected stream and reserves buffer
  * @stream_type: type of the stream that shall be locked
  * @msg_size:    message size
  * @flags:       pointer to store flags passed back on stream release
  *
- * Function will lock the stream and reserve the number of bytes requested
- * in msg_size for the user.
+ * Function will lock this CPU's instance of the stream and reserve the number
+ * of bytes requested in msg_size for the user. Interrupts are disabled until
+ * the stream is released so the instance can not change.
  *
  * Return: pointer to the buffer where message can be stored
  *
@@ -943,9 +1124,9 @@ static char *kbasep_tlstream_msgbuf_acquire(
 			PACKET_SIZE - PACKET_HEADER_SIZE - PACKET_NUMBER_SIZE >=
 			msg_size);
 
-	stream = tl_stream[stream_type];
-
-	spin_lock_irqsave(&stream->lock, *flags);
+	local_irq_save(*flags);
+	stream = kbasep_tlstream_local(stream_type);
+	spin_lock(&stream->lock);
 
 	wb_idx_raw = atomic_read(&stream->wbi);
 	wb_idx     = wb_idx_raw % PACKET_COUNT;
@@ -984,25 +1165,25 @@ static void kbasep_tlstream_msgbuf_release(
 
 	KBASE_DEBUG_ASSERT(TL_STREAM_TYPE_COUNT > stream_type);
 
-	stream = tl_stream[stream_type];
+	stream = kbasep_tlstream_local(stream_type);
 
 	/* Mark stream as containing unflushed data. */
 	atomic_set(&stream->autoflush_counter, 0);
 
-	spin_unlock_irqrestore(&stream->lock, flags);
+	spin_unlock(&stream->lock);
+	local_irq_restore(flags);
 }
 
 /*****************************************************************************/
 
 /**
- * kbasep_tlstream_flush_stream - flush stream
- * @stype:  type of stream to be flushed
+ * kbasep_tlstream_flush_instance - flush one instance of a stream
+ * @stream: stream instance to be flushed
  *
- * Flush pending data in timeline stream.
+ * Flush pending data in timeline stream instance.
  */
-static void kbasep_tlstream_flush_stream(enum tl_stream_type stype)
+static void kbasep_tlstream_flush_instance(struct tl_stream *stream)
 {
-	struct tl_stream *stream = tl_stream[stype];
 	unsigned long    flags;
 	unsigned int     wb_idx_raw;
 	unsigned int     wb_idx;
@@ -1027,6 +1208,20 @@ static void kbasep_tlstream_flush_stream(enum tl_stream_type stype)
 	spin_unlock_irqrestore(&stream->lock, flags);
 }
 
+/**
+ * kbasep_tlstream_flush_stream - flush stream
+ * @stype:  type of stream to be flushed
+ *
+ * Flush pending data in all instances of timeline stream.
+ */
+static void kbasep_tlstream_flush_stream(enum tl_stream_type stype)
+{
+	unsigned int i;
+
+	for (i = 0; i < tl_stream_count[stype]; i++)
+		kbasep_tlstream_flush_instance(tl_stream[stype][i]);
+}
+
 /**
  * kbasep_tlstream_autoflush_timer_callback - autoflush timer callback
  * @data:  unused
@@ -1042,46 +1237,28 @@ static void kbasep_tlstream_autoflush_timer_callback(unsigned long data)
 	CSTD_UNUSED(data);
 
 	for (stype = 0; stype < TL_STREAM_TYPE_COUNT; stype++) {
-		struct tl_stream *stream = tl_stream[stype];
-		unsigned long    flags;
-		unsigned int     wb_idx_raw;
-		unsigned int     wb_idx;
-		size_t           wb_size;
-		size_t           min_size = PACKET_HEADER_SIZE;
-
-		int af_cnt = atomic_read(&stream->autoflush_counter);
-
-		/* Check if stream contain unflushed data. */
-		if (0 > af_cnt)
-			continue;
-
-		/* Check if stream should be flushed now. */
-		if (af_cnt != atomic_cmpxchg(
-					&stream->autoflush_counter,
-					af_cnt,
-					af_cnt + 1))
-			continue;
-		if (!af_cnt)
-			continue;
-
-		/* Autoflush this stream. */
-		if (stream->numbered)
-			min_size += PACKET_NUMBER_SIZE;
-
-		spin_lock_irqsave(&stream->lock, flags);
-
-		wb_idx_raw = atomic_read(&stream->wbi);
-		wb_idx     = wb_idx_raw % PACKET_COUNT;
-		wb_size    = atomic_read(&stream->buffer[wb_idx].size);
-
-		if (wb_size > min_size) {
-			wb_size = kbasep_tlstream_msgbuf_submit(
-					stream, wb_idx_raw, wb_size);
-			wb_idx = (wb_idx_raw + 1) % PACKET_COUNT;
-			atomic_set(&stream->buffer[wb_idx].size,
-					wb_size);
+		unsigned int i;
+
+		for (i = 0; i < tl_stream_count[stype]; i++) {
+			struct tl_stream *stream = tl_stream[stype][i];
+			int af_cnt = atomic_read(&stream->autoflush_counter);
+
+			/* Check if stream contain unflushed data. */
+			if (0 > af_cnt)
+				continue;
+
+			/* Check if stream should be flushed now. */
+			if (af_cnt != atomic_cmpxchg(
+						&stream->autoflush_counter,
+						af_cnt,
+						af_cnt + 1))
+				continue;
+			if (!af_cnt)
+				continue;
+
+			/* Autoflush this stream. */
+			kbasep_tlstream_flush_instance(stream);
 		}
-		spin_unlock_irqrestore(&stream->lock, flags);
 	}
 
 	if (atomic_read(&autoflush_timer_active))
@@ -1091,39 +1268,83 @@ static void kbasep_tlstream_autoflush_timer_callback(unsigned long data)
 	CSTD_UNUSED(rcode);
 }
 
+/**
+ * kbasep_tlstream_packet_timestamp - return timestamp of packet's first message
+ * @stream: stream instance
+ * @rb_idx: read buffer index
+ *
+ * Return: timestamp of the first message stored in the packet
+ */
+static u64 kbasep_tlstream_packet_timestamp(
+		struct tl_stream *stream,
+		unsigned int     rb_idx)
+{
+	u64 timestamp;
+
+	memcpy(&timestamp,
+			&stream->buffer[rb_idx].data[PACKET_TIMESTAMP_POS],
+			sizeof(timestamp));
+
+	return timestamp;
+}
+
 /**
  * kbasep_tlstream_packet_pending - check timeline streams for pending packets
  * @stype:      pointer to variable where stream type will be placed
+ * @instance:   pointer to variable where stream instance will be placed
  * @rb_idx_raw: pointer to variable where read buffer index will be placed
  *
  * Function checks all streams for pending packets. It will stop as soon as
- * packet ready to be submitted to user space is detected. Variables under
- * pointers, passed as the parameters to this function will be updated with
- * values pointing to right stream and buffer.
+ * a stream with packet ready to be submitted to user space is detected. If
+ * more than one instance of that stream has a packet ready, the packet
+ * carrying the oldest message is selected, so that per-CPU body streams are
+ * merged approximately in timestamp order. Variables under pointers, passed
+ * as the parameters to this function will be updated with values pointing to
+ * right stream and buffer.
  *
  * Return: non-zero if any of timeline streams has at last one packet ready
  */
 static int kbasep_tlstream_packet_pending(
 		enum tl_stream_type *stype,
+		unsigned int        *instance,
 		unsigned int        *rb_idx_raw)
 {
 	int pending = 0;
 
 	KBASE_DEBUG_ASSERT(stype);
+	KBASE_DEBUG_ASSERT(instance);
 	KBASE_DEBUG_ASSERT(rb_idx_raw);
 
 	for (
 			*stype = 0;
 			(*stype < TL_STREAM_TYPE_COUNT) && !pending;
 			(*stype)++) {
-		if (NULL != tl_stream[*stype]) {
-			*rb_idx_raw = atomic_read(&tl_stream[*stype]->rbi);
-			/* Read buffer index may be updated by writer in case of
-			 * overflow. Read and write buffer indexes must be
+		u64          oldest = 0;
+		unsigned int i;
+
+		for (i = 0; i < tl_stream_count[*stype]; i++) {
+			struct tl_stream *stream = tl_stream[*stype][i];
+			unsigned int     idx_raw;
+			u64              timestamp;
+
+			idx_raw = atomic_read(&stream->rbi);
+			/* Read buffer index may be updated by writer in case
+			 * of overflow. Read and write buffer indexes must be
 			 * loaded in correct order. */
 			smp_rmb();
-			if (atomic_read(&tl_stream[*stype]->wbi) != *rb_idx_raw)
-				pending = 1;
+			if (atomic_read(&stream->wbi) == idx_raw)
+				continue;
+
+			timestamp = stream->numbered ?
+				kbasep_tlstream_packet_timestamp(
+						stream, idx_raw % PACKET_COUNT) :
+				0;
+			if (!pending || timestamp < oldest) {
+				oldest      = timestamp;
+				*instance   = i;
+				*rb_idx_raw = idx_raw;
+				pending     = 1;
+			}
 		}
 	}
 	(*stype)--;
@@ -1131,6 +1352,121 @@ static int kbasep_tlstream_packet_pending(
 	return pending;
 }
 
+/**
+ * kbasep_tlstream_ring_drain_locked - move submitted packets to the ring
+ *
+ * Packets are moved oldest first, as read() returns them. Packets that do
+ * not fit in the ring are dropped. At most one ring worth of packets is
+ * moved per call, the worker is kicked again if more are pending.
+ */
+static void kbasep_tlstream_ring_drain_locked(void)
+{
+	struct base_tlstream_ring_ctrl *ctrl = tl_ring.ctrl;
+	enum tl_stream_type stype;
+	unsigned int        instance = 0;
+	unsigned int        rb_idx_raw = 0;
+	u32                 head;
+	u32                 tail;
+	u32                 threshold;
+	u32                 n;
+
+	lockdep_assert_held(&tl_reader_lock);
+
+	if (!tl_ring.mem)
+		return;
+
+	head = ctrl->head;
+	tail = READ_ONCE(ctrl->tail);
+	/* Make sure user space is done with slots before reusing them. */
+	smp_mb();
+
+	for (n = 0; n < tl_ring.count; n++) {
+		struct tl_stream *stream;
+		unsigned int     rb_idx;
+		size_t           rb_size;
+		char             *slot;
+		u32              seq;
+
+		if (!kbasep_tlstream_packet_pending(&stype, &instance,
+					&rb_idx_raw))
+			break;
+
+		stream = tl_stream[stype][instance];
+		rb_idx = rb_idx_raw % PACKET_COUNT;
+		rb_size = atomic_read(&stream->buffer[rb_idx].size);
+
+		/* Dropped packets leave a gap in the packet numbers. */
+		if (head - tail >= tl_ring.count) {
+			seq = kbasep_tlstream_packet_seq(stream, rb_idx_raw);
+			if (atomic_cmpxchg(&stream->rbi, rb_idx_raw,
+						rb_idx_raw + 1) == rb_idx_raw) {
+				stream->rnext = rb_idx_raw + 1;
+				tl_stream_read_seq[stype] = seq + 1;
+				ctrl->dropped++;
+			}
+			continue;
+		}
+
+		slot = &tl_ring.slots[(head % tl_ring.count) * PACKET_SIZE];
+		memcpy(slot, stream->buffer[rb_idx].data, rb_size);
+		seq = kbasep_tlstream_packet_seq(stream, rb_idx_raw);
+
+		/* Only keep the packet if the writer did not overwrite it
+		 * while it was being copied. */
+		smp_rmb();
+		if (atomic_cmpxchg(&stream->rbi, rb_idx_raw, rb_idx_raw + 1) !=
+				rb_idx_raw)
+			continue;
+
+		if (stream->numbered)
+			kbasep_tlstream_packet_number_update(slot, seq);
+		stream->rnext = rb_idx_raw + 1;
+		tl_stream_read_seq[stype] = seq + 1;
+		head++;
+
+#if MALI_UNIT_TEST
+		atomic_add(rb_size, &tlstream_bytes_collected);
+#endif /* MALI_UNIT_TEST */
+	}
+
+	/* Packets must be visible before the head is moved past them. */
+	smp_wmb();
+	WRITE_ONCE(ctrl->head, head);
+
+	threshold = clamp_t(u32, READ_ONCE(ctrl->wake_threshold),
+			1, tl_ring.count);
+	if (head - tail >= threshold)
+		wake_up_interruptible(&tl_event_queue);
+
+	if (n == tl_ring.count)
+		schedule_work(&tl_ring.drain_work);
+}
+
+static void kbasep_tlstream_ring_drain_worker(struct work_struct *work)
+{
+	CSTD_UNUSED(work);
+
+	mutex_lock(&tl_reader_lock);
+	kbasep_tlstream_ring_drain_locked();
+	mutex_unlock(&tl_reader_lock);
+}
+
+/**
+ * kbasep_tlstream_ring_free_locked - stop using the packet ring
+ *
+ * Packets are handed over through read() again from now on.
+ */
+static void kbasep_tlstream_ring_free_locked(void)
+{
+	lockdep_assert_held(&tl_reader_lock);
+
+	atomic_set(&tl_ring.active, 0);
+	vfree(tl_ring.mem);
+	tl_ring.mem = NULL;
+	tl_ring.ctrl = NULL;
+	tl_ring.slots = NULL;
+}
+
 /**
  * kbasep_tlstream_read - copy data from streams to buffer provided by user
  * @filp:   pointer to file structure (unused)
@@ -1138,6 +1474,10 @@ static int kbasep_tlstream_packet_pending(
  * @size:   maximum amount of data that can be stored in the buffer
  * @f_pos:  pointer to file offset (unused)
  *
+ * Packets are handed over either through read() or through the mapped
+ * ring. While the ring is mapped read() fails with -EBUSY; once it is
+ * unmapped the stream can be read again, or mapped again.
+ *
  * Return: number of bytes stored in the buffer
  */
 static ssize_t kbasep_tlstream_read(
@@ -1159,11 +1499,20 @@ static ssize_t kbasep_tlstream_read(
 
 	mutex_lock(&tl_reader_lock);
 
+	/* Packets are handed over through the ring once it is mapped. */
+	if (tl_ring.mem) {
+		mutex_unlock(&tl_reader_lock);
+		return -EBUSY;
+	}
+
 	while (copy_len < size) {
 		enum tl_stream_type stype;
+		struct tl_stream    *stream;
+		unsigned int        instance = 0;
 		unsigned int        rb_idx_raw = 0;
 		unsigned int        rb_idx;
 		size_t              rb_size;
+		u32                 seq;
 
 		/* If we don't have any data yet, wait for packet to be
 		 * submitted. If we already read some packets and there is no
@@ -1171,6 +1520,7 @@ static ssize_t kbasep_tlstream_read(
 		if (0 < copy_len) {
 			if (!kbasep_tlstream_packet_pending(
 						&stype,
+						&instance,
 						&rb_idx_raw))
 				break;
 		} else {
@@ -1178,6 +1528,7 @@ static ssize_t kbasep_tlstream_read(
 						tl_event_queue,
 						kbasep_tlstream_packet_pending(
 							&stype,
+							&instance,
 							&rb_idx_raw))) {
 				copy_len = -ERESTARTSYS;
 				break;
@@ -1186,26 +1537,38 @@ static ssize_t kbasep_tlstream_read(
 
 		/* Check if this packet fits into the user buffer.
 		 * If so copy its content. */
+		stream = tl_stream[stype][instance];
 		rb_idx = rb_idx_raw % PACKET_COUNT;
-		rb_size = atomic_read(&tl_stream[stype]->buffer[rb_idx].size);
+		rb_size = atomic_read(&stream->buffer[rb_idx].size);
 		if (rb_size > size - copy_len)
 			break;
 		if (copy_to_user(
 					&buffer[copy_len],
-					tl_stream[stype]->buffer[rb_idx].data,
+					stream->buffer[rb_idx].data,
 					rb_size)) {
 			copy_len = -EFAULT;
 			break;
 		}
 
+		/* Number packets in the order they are read. */
+		seq = kbasep_tlstream_packet_seq(stream, rb_idx_raw);
+		if (stream->numbered && put_user(seq,
+					(u32 __user *)&buffer[
+					copy_len + PACKET_HEADER_SIZE])) {
+			copy_len = -EFAULT;
+			break;
+		}
+
 		/* If the rbi still points to the packet we just processed
 		 * then there was no overflow so we add the copied size to
 		 * copy_len and move rbi on to the next packet
 		 */
 		smp_rmb();
-		if (atomic_read(&tl_stream[stype]->rbi) == rb_idx_raw) {
+		if (atomic_read(&stream->rbi) == rb_idx_raw) {
 			copy_len += rb_size;
-			atomic_inc(&tl_stream[stype]->rbi);
+			atomic_inc(&stream->rbi);
+			stream->rnext = rb_idx_raw + 1;
+			tl_stream_read_seq[stype] = seq + 1;
 
 #if MALI_UNIT_TEST
 			atomic_add(rb_size, &tlstream_bytes_collected);
@@ -1227,17 +1590,168 @@ static ssize_t kbasep_tlstream_read(
 static unsigned int kbasep_tlstream_poll(struct file *filp, poll_table *wait)
 {
 	enum tl_stream_type stream_type;
+	unsigned int        instance;
 	unsigned int        rb_idx;
 
 	KBASE_DEBUG_ASSERT(filp);
 	KBASE_DEBUG_ASSERT(wait);
 
 	poll_wait(filp, &tl_event_queue, wait);
-	if (kbasep_tlstream_packet_pending(&stream_type, &rb_idx))
+	if (atomic_read(&tl_ring.active)) {
+		unsigned int mask = 0;
+
+		mutex_lock(&tl_reader_lock);
+		if (tl_ring.mem) {
+			struct base_tlstream_ring_ctrl *ctrl = tl_ring.ctrl;
+			u32 threshold = clamp_t(u32,
+					READ_ONCE(ctrl->wake_threshold),
+					1, tl_ring.count);
+
+			if (ctrl->head - READ_ONCE(ctrl->tail) >= threshold)
+				mask = POLLIN;
+		}
+		mutex_unlock(&tl_reader_lock);
+		if (mask)
+			return mask;
+	}
+	if (kbasep_tlstream_packet_pending(&stream_type, &instance, &rb_idx))
 		return POLLIN;
 	return 0;
 }
 
+/**
+ * kbasep_tlstream_vma_close - unmap timeline packet ring
+ * @vma: pointer to vma structure
+ *
+ * Packets are read() again from now on, and the ring may be mapped again.
+ */
+static void kbasep_tlstream_vma_close(struct vm_area_struct *vma)
+{
+	mutex_lock(&tl_reader_lock);
+	if (tl_ring.mem && tl_ring.mem == vma->vm_private_data)
+		kbasep_tlstream_ring_free_locked();
+	mutex_unlock(&tl_reader_lock);
+
+	/* Wake the reader in case packets were left in the streams. */
+	wake_up_interruptible(&tl_event_queue);
+}
+
+static const struct vm_operations_struct kbasep_tlstream_vm_ops = {
+	.close = kbasep_tlstream_vma_close,
+};
+
+/**
+ * kbasep_tlstream_mmap - map timeline packet ring
+ * @filp: pointer to file structure
+ * @vma:  pointer to vma structure
+ *
+ * The size of the mapping selects the number of packet slots, which must be
+ * a power of two. See struct base_tlstream_ring_ctrl for the layout. The
+ * ring stays in use until it is unmapped.
+ *
+ * Return: zero on success
+ */
+static int kbasep_tlstream_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	size_t        size = vma->vm_end - vma->vm_start;
+	size_t        count;
+	void          *mem;
+	int           err;
+
+	KBASE_DEBUG_ASSERT(filp);
+	KBASE_DEBUG_ASSERT(vma);
+
+	if (vma->vm_pgoff || size <= PAGE_SIZE)
+		return -EINVAL;
+	count = (size - PAGE_SIZE) / PACKET_SIZE;
+	if (!is_power_of_2(count) ||
+			count * PACKET_SIZE != size - PAGE_SIZE ||
+			count > U32_MAX)
+		return -EINVAL;
+
+	mutex_lock(&tl_reader_lock);
+
+	if (tl_ring.mem) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	mem = vmalloc_user(size);
+	if (!mem) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err = remap_vmalloc_range(vma, mem, 0);
+	if (err) {
+		vfree(mem);
+		goto out;
+	}
+
+	vma->vm_flags |= VM_DONTCOPY;
+	vma->vm_private_data = mem;
+	vma->vm_ops = &kbasep_tlstream_vm_ops;
+
+	tl_ring.mem   = mem;
+	tl_ring.ctrl  = mem;
+	tl_ring.slots = (char *)mem + PAGE_SIZE;
+	tl_ring.count = count;
+	tl_ring.ctrl->packet_count   = count;
+	tl_ring.ctrl->packet_size    = PACKET_SIZE;
+	tl_ring.ctrl->wake_threshold = 1;
+
+	/* Move the packets already pending, header streams first, then let
+	 * submissions kick the worker. */
+	atomic_set(&tl_ring.active, 1);
+	kbasep_tlstream_ring_drain_locked();
+
+out:
+	mutex_unlock(&tl_reader_lock);
+
+	return err;
+}
+
+/**
+ * kbasep_tlstream_ioctl - timeline stream ioctl handler
+ * @filp: pointer to file structure
+ * @cmd:  command
+ * @arg:  command's argument
+ *
+ * Return: zero on success
+ */
+static long kbasep_tlstream_ioctl(
+		struct file   *filp,
+		unsigned int  cmd,
+		unsigned long arg)
+{
+	u32 flags;
+
+	KBASE_DEBUG_ASSERT(filp);
+
+	if (cmd != BASE_TLSTREAM_IOCTL_SET_FLAGS)
+		return -EINVAL;
+
+	if (get_user(flags, (u32 __user *)arg))
+		return -EFAULT;
+	if (flags & ~BASE_TLSTREAM_FLAGS_MASK)
+		return -EINVAL;
+
+	mutex_lock(&tl_enable_lock);
+
+	/* Job dumping can only be selected when the stream is acquired. */
+	flags &= ~BASE_TLSTREAM_JOB_DUMPING_ENABLED;
+	flags |= atomic_read(&kbase_tlstream_enabled) &
+		BASE_TLSTREAM_JOB_DUMPING_ENABLED;
+	flags |= TLSTREAM_ENABLED;
+
+	atomic_set(&kbase_tlstream_enabled, flags);
+	kbasep_tlstream_set_classes(flags);
+
+	mutex_unlock(&tl_enable_lock);
+
+	return 0;
+}
+
 /**
  * kbasep_tlstream_release - release timeline stream descriptor
  * @inode: pointer to inode structure
@@ -1252,11 +1766,23 @@ static int kbasep_tlstream_release(struct inode *inode, struct file *filp)
 	CSTD_UNUSED(inode);
 	CSTD_UNUSED(filp);
 
+	mutex_lock(&tl_enable_lock);
+
+	/* Stop emitting events. */
+	kbasep_tlstream_set_classes(0);
+
 	/* Stop autoflush timer before releasing access to streams. */
 	atomic_set(&autoflush_timer_active, 0);
 	del_timer_sync(&autoflush_timer);
 
+	/* A mapping holds a reference to the file, so the ring has been
+	 * unmapped already. Only the worker may still be running. */
+	cancel_work_sync(&tl_ring.drain_work);
+
 	atomic_set(&kbase_tlstream_enabled, 0);
+
+	mutex_unlock(&tl_enable_lock);
+
 	return 0;
 }
 
@@ -1342,23 +1868,52 @@ static void kbasep_tlstream_timeline_header(
 
 /*****************************************************************************/
 
+/**
+ * kbasep_tlstream_free - free all instances of a stream
+ * @stype: stream type
+ */
+static void kbasep_tlstream_free(enum tl_stream_type stype)
+{
+	unsigned int i;
+
+	if (!tl_stream[stype])
+		return;
+
+	for (i = 0; i < tl_stream_count[stype]; i++) {
+		if (!tl_stream[stype][i])
+			continue;
+		kbasep_timeline_stream_term(tl_stream[stype][i]);
+		kfree(tl_stream[stype][i]);
+	}
+	kfree(tl_stream[stype]);
+	tl_stream[stype] = NULL;
+}
+
 int kbase_tlstream_init(void)
 {
-	enum tl_stream_type i;
+	enum tl_stream_type stype;
 
 	/* Prepare stream structures. */
-	for (i = 0; i < TL_STREAM_TYPE_COUNT; i++) {
-		tl_stream[i] = kmalloc(sizeof(**tl_stream), GFP_KERNEL);
-		if (!tl_stream[i])
-			break;
-		kbasep_timeline_stream_init(tl_stream[i], i);
-	}
-	if (TL_STREAM_TYPE_COUNT > i) {
-		for (; i > 0; i--) {
-			kbasep_timeline_stream_term(tl_stream[i - 1]);
-			kfree(tl_stream[i - 1]);
+	for (stype = 0; stype < TL_STREAM_TYPE_COUNT; stype++) {
+		unsigned int i;
+
+		if (TL_PACKET_TYPE_BODY == tl_stream_cfg[stype].pkt_type)
+			tl_stream_count[stype] = nr_cpu_ids;
+		else
+			tl_stream_count[stype] = 1;
+
+		tl_stream[stype] = kcalloc(tl_stream_count[stype],
+				sizeof(*tl_stream[stype]), GFP_KERNEL);
+		if (!tl_stream[stype])
+			goto error;
+
+		for (i = 0; i < tl_stream_count[stype]; i++) {
+			tl_stream[stype][i] = kmalloc(
+					sizeof(**tl_stream[stype]), GFP_KERNEL);
+			if (!tl_stream[stype][i])
+				goto error;
+			kbasep_timeline_stream_init(tl_stream[stype][i], stype);
 		}
-		return -ENOMEM;
 	}
 
 	/* Initialize autoflush timer. */
@@ -1368,72 +1923,94 @@ int kbase_tlstream_init(void)
 			0);
 
 	return 0;
+
+error:
+	for (stype = 0; stype < TL_STREAM_TYPE_COUNT; stype++)
+		kbasep_tlstream_free(stype);
+	return -ENOMEM;
 }
 
 void kbase_tlstream_term(void)
 {
-	enum tl_stream_type i;
+	enum tl_stream_type stype;
 
-	for (i = 0; i < TL_STREAM_TYPE_COUNT; i++) {
-		kbasep_timeline_stream_term(tl_stream[i]);
-		kfree(tl_stream[i]);
-	}
+	for (stype = 0; stype < TL_STREAM_TYPE_COUNT; stype++)
+		kbasep_tlstream_free(stype);
 }
 
 int kbase_tlstream_acquire(struct kbase_context *kctx, int *fd, u32 flags)
 {
-	u32 tlstream_enabled = TLSTREAM_ENABLED | flags;
+	u32         tlstream_enabled = TLSTREAM_ENABLED | flags;
+	struct file *file;
+	int         rcode;
 
-	if (0 == atomic_cmpxchg(&kbase_tlstream_enabled, 0, tlstream_enabled)) {
-		int rcode;
+	mutex_lock(&tl_enable_lock);
 
-		*fd = anon_inode_getfd(
-				"[mali_tlstream]",
-				&kbasep_tlstream_fops,
-				kctx,
-				O_RDONLY | O_CLOEXEC);
-		if (0 > *fd) {
-			atomic_set(&kbase_tlstream_enabled, 0);
-			return *fd;
-		}
+	if (atomic_read(&kbase_tlstream_enabled)) {
+		mutex_unlock(&tl_enable_lock);
+		*fd = -EBUSY;
+		return 0;
+	}
 
-		/* Reset and initialize header streams. */
-		kbasep_timeline_stream_reset(
-				tl_stream[TL_STREAM_TYPE_OBJ_HEADER]);
-		kbasep_timeline_stream_reset(
-				tl_stream[TL_STREAM_TYPE_OBJ_SUMMARY]);
-		kbasep_timeline_stream_reset(
-				tl_stream[TL_STREAM_TYPE_AUX_HEADER]);
-		kbasep_tlstream_timeline_header(
-				TL_STREAM_TYPE_OBJ_HEADER,
-				tp_desc_obj,
-				ARRAY_SIZE(tp_desc_obj));
-		kbasep_tlstream_timeline_header(
-				TL_STREAM_TYPE_AUX_HEADER,
-				tp_desc_aux,
-				ARRAY_SIZE(tp_desc_aux));
-
-		/* Start autoflush timer. */
-		atomic_set(&autoflush_timer_active, 1);
-		rcode = mod_timer(
-				&autoflush_timer,
-				jiffies + msecs_to_jiffies(AUTOFLUSH_INTERVAL));
-		CSTD_UNUSED(rcode);
-
-		/* If job dumping is enabled, readjust the software event's
-		 * timeout as the default value of 3 seconds is often
-		 * insufficient. */
-		if (flags & BASE_TLSTREAM_JOB_DUMPING_ENABLED) {
-			dev_info(kctx->kbdev->dev,
-					"Job dumping is enabled, readjusting the software event's timeout\n");
-			atomic_set(&kctx->kbdev->js_data.soft_job_timeout_ms,
-					1800000);
-		}
+	*fd = get_unused_fd_flags(O_RDONLY | O_CLOEXEC);
+	if (0 > *fd) {
+		mutex_unlock(&tl_enable_lock);
+		return *fd;
+	}
 
-	} else {
-		*fd = -EBUSY;
+	file = anon_inode_getfile(
+			"[mali_tlstream]",
+			&kbasep_tlstream_fops,
+			kctx,
+			O_RDONLY | O_CLOEXEC);
+	if (IS_ERR(file)) {
+		put_unused_fd(*fd);
+		mutex_unlock(&tl_enable_lock);
+		*fd = PTR_ERR(file);
+		return *fd;
+	}
+
+	atomic_set(&kbase_tlstream_enabled, tlstream_enabled);
+
+	/* Reset and initialize header streams. */
+	kbasep_timeline_stream_reset_all(TL_STREAM_TYPE_OBJ_HEADER);
+	kbasep_timeline_stream_reset_all(TL_STREAM_TYPE_OBJ_SUMMARY);
+	kbasep_timeline_stream_reset_all(TL_STREAM_TYPE_AUX_HEADER);
+	kbasep_tlstream_timeline_header(
+			TL_STREAM_TYPE_OBJ_HEADER,
+			tp_desc_obj,
+			ARRAY_SIZE(tp_desc_obj));
+	kbasep_tlstream_timeline_header(
+			TL_STREAM_TYPE_AUX_HEADER,
+			tp_desc_aux,
+			ARRAY_SIZE(tp_desc_aux));
+
+	/* Start emitting events. */
+	kbasep_tlstream_set_classes(tlstream_enabled);
+
+	/* Start autoflush timer. */
+	atomic_set(&autoflush_timer_active, 1);
+	rcode = mod_timer(
+			&autoflush_timer,
+			jiffies + msecs_to_jiffies(AUTOFLUSH_INTERVAL));
+	CSTD_UNUSED(rcode);
+
+	/* If job dumping is enabled, readjust the software event's
+	 * timeout as the default value of 3 seconds is often
+	 * insufficient. */
+	if (flags & BASE_TLSTREAM_JOB_DUMPING_ENABLED) {
+		dev_info(kctx->kbdev->dev,
+				"Job dumping is enabled, readjusting the software event's timeout\n");
+		atomic_set(&kctx->kbdev->js_data.soft_job_timeout_ms,
+				1800000);
 	}
 
+	/* Only expose the descriptor once the stream is set up, so it can
+	 * not be released halfway through. */
+	fd_install(*fd, file);
+
+	mutex_unlock(&tl_enable_lock);
+
 	return 0;
 }
 
@@ -1447,10 +2024,8 @@ void kbase_tlstream_flush_streams(void)
 
 void kbase_tlstream_reset_body_streams(void)
 {
-	kbasep_timeline_stream_reset(
-			tl_stream[TL_STREAM_TYPE_OBJ]);
-	kbasep_timeline_stream_reset(
-			tl_stream[TL_STREAM_TYPE_AUX]);
+	kbasep_timeline_stream_reset_all(TL_STREAM_TYPE_OBJ);
+	kbasep_timeline_stream_reset_all(TL_STREAM_TYPE_AUX);
 }
 
 #if MALI_UNIT_TEST
@@ -2471,3 +3046,54 @@ void __kbase_tlstream_aux_protected_leave_end(void *gpu)
 
 	kbasep_tlstream_msgbuf_release(TL_STREAM_TYPE_AUX, flags);
 }
+
+void __kbase_tlstream_aux_job_sample(void *atom, const u64 *values)
+{
+	const u32     msg_id = KBASE_AUX_JOB_SAMPLE;
+	const size_t  msg_size =
+		sizeof(msg_id) + sizeof(u64) + sizeof(atom) +
+		sizeof(*values) * KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS;
+	unsigned long flags;
+	char          *buffer;
+	size_t        pos = 0;
+
+	buffer = kbasep_tlstream_msgbuf_acquire(
+			TL_STREAM_TYPE_AUX,
+			msg_size, &flags);
+	KBASE_DEBUG_ASSERT(buffer);
+
+	pos = kbasep_tlstream_write_bytes(buffer, pos, &msg_id, sizeof(msg_id));
+	pos = kbasep_tlstream_write_timestamp(buffer, pos);
+	pos = kbasep_tlstream_write_bytes(
+			buffer, pos, &atom, sizeof(atom));
+	pos = kbasep_tlstream_write_bytes(buffer, pos, values,
+			sizeof(*values) * KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS);
+	KBASE_DEBUG_ASSERT(msg_size == pos);
+
+	kbasep_tlstream_msgbuf_release(TL_STREAM_TYPE_AUX, flags);
+}
+
+void __kbase_tlstream_aux_fence_wait(void *atom, u64 wait_ns)
+{
+	const u32     msg_id = KBASE_AUX_FENCE_WAIT;
+	const size_t  msg_size =
+		sizeof(msg_id) + sizeof(u64) + sizeof(atom) + sizeof(wait_ns);
+	unsigned long flags;
+	char          *buffer;
+	size_t        pos = 0;
+
+	buffer = kbasep_tlstream_msgbuf_acquire(
+			TL_STREAM_TYPE_AUX,
+			msg_size, &flags);
+	KBASE_DEBUG_ASSERT(buffer);
+
+	pos = kbasep_tlstream_write_bytes(buffer, pos, &msg_id, sizeof(msg_id));
+	pos = kbasep_tlstream_write_timestamp(buffer, pos);
+	pos = kbasep_tlstream_write_bytes(
+			buffer, pos, &atom, sizeof(atom));
+	pos = kbasep_tlstream_write_bytes(
+			buffer, pos, &wait_ns, sizeof(wait_ns));
+	KBASE_DEBUG_ASSERT(msg_size == pos);
+
+	kbasep_tlstream_msgbuf_release(TL_STREAM_TYPE_AUX, flags);
+}
@@ -18,6 +18,8 @@
 #if !defined(_KBASE_TLSTREAM_H)
 #define _KBASE_TLSTREAM_H
 
+#include <linux/jump_label.h>
+
 #include <mali_kbase.h>
 
 /*****************************************************************************/
@@ -47,6 +49,8 @@ void kbase_tlstream_term(void);
  * Only one entity can own the descriptor at any given time. Descriptor shall be
  * closed if unused. If descriptor cannot be obtained (i.e. when it is already
  * being used) argument fd will contain negative value.
+ * The BASE_TLSTREAM_CLASS_* bits of @flags select the classes of events
+ * emitted, all classes are emitted if none is set.
  *
  * Return: zero on success (this does not necessarily mean that stream
  *         descriptor could be returned), negative number on error
@@ -151,11 +155,33 @@ void __kbase_tlstream_aux_protected_enter_start(void *gpu);
 void __kbase_tlstream_aux_protected_enter_end(void *gpu);
 void __kbase_tlstream_aux_protected_leave_start(void *gpu);
 void __kbase_tlstream_aux_protected_leave_end(void *gpu);
+void __kbase_tlstream_aux_job_sample(void *atom, const u64 *values);
+void __kbase_tlstream_aux_fence_wait(void *atom, u64 wait_ns);
 
 #define TLSTREAM_ENABLED (1 << 31)
 
 extern atomic_t kbase_tlstream_enabled;
 
+/* Classes of timeline events, in the order of the BASE_TLSTREAM_CLASS_*
+ * flags. Events of a class are emitted only while its static key is
+ * enabled, so disabled classes only cost a no-op in the hot paths. */
+enum tl_class {
+	TL_CLASS_OBJ,
+	TL_CLASS_RET,
+	TL_CLASS_DEP,
+	TL_CLASS_ATTRIB,
+	TL_CLASS_STATE,
+	TL_CLASS_EVENT,
+	TL_CLASS_AUX,
+	TL_CLASS_LATENCY,
+
+	TL_CLASS_COUNT
+};
+
+extern struct static_key kbase_tlstream_key[TL_CLASS_COUNT];
+
+/* Summary events are emitted while the stream is being acquired and are
+ * needed to decode the stream, so they are not filtered. */
 #define __TRACE_IF_ENABLED(trace_name, ...)                         \
 	do {                                                        \
 		int enabled = atomic_read(&kbase_tlstream_enabled); \
@@ -163,11 +189,18 @@ extern atomic_t kbase_tlstream_enabled;
 			__kbase_tlstream_##trace_name(__VA_ARGS__); \
 	} while (0)
 
-#define __TRACE_IF_ENABLED_LATENCY(trace_name, ...)                     \
-	do {                                                            \
-		int enabled = atomic_read(&kbase_tlstream_enabled);     \
-		if (enabled & BASE_TLSTREAM_ENABLE_LATENCY_TRACEPOINTS) \
-			__kbase_tlstream_##trace_name(__VA_ARGS__);     \
+#define __TRACE_IF_CLASS(class, trace_name, ...)                      \
+	do {                                                          \
+		if (static_key_false(&kbase_tlstream_key[class]))     \
+			__kbase_tlstream_##trace_name(__VA_ARGS__);   \
+	} while (0)
+
+#define __TRACE_IF_CLASS_LATENCY(class, trace_name, ...)              \
+	do {                                                          \
+		if (static_key_false(&kbase_tlstream_key[class]) &&   \
+				static_key_false(                     \
+				&kbase_tlstream_key[TL_CLASS_LATENCY])) \
+			__kbase_tlstream_##trace_name(__VA_ARGS__);   \
 	} while (0)
 
 /*****************************************************************************/
@@ -262,7 +295,7 @@ extern atomic_t kbase_tlstream_enabled;
  * kbase context with userspace context.
  */
 #define KBASE_TLSTREAM_TL_NEW_CTX(context, nr, tgid) \
-	__TRACE_IF_ENABLED(tl_new_ctx, context, nr, tgid)
+	__TRACE_IF_CLASS(TL_CLASS_OBJ, tl_new_ctx, context, nr, tgid)
 
 /**
  * KBASE_TLSTREAM_TL_NEW_ATOM - create atom object in timeline
@@ -274,7 +307,7 @@ extern atomic_t kbase_tlstream_enabled;
  * bucket id understood by hardware.
  */
 #define KBASE_TLSTREAM_TL_NEW_ATOM(atom, nr) \
-	__TRACE_IF_ENABLED(tl_new_atom, atom, nr)
+	__TRACE_IF_CLASS(TL_CLASS_OBJ, tl_new_atom, atom, nr)
 
 /**
  * KBASE_TLSTREAM_TL_DEL_CTX - destroy context object in timeline
@@ -284,7 +317,7 @@ extern atomic_t kbase_tlstream_enabled;
  * exist.
  */
 #define KBASE_TLSTREAM_TL_DEL_CTX(context) \
-	__TRACE_IF_ENABLED(tl_del_ctx, context)
+	__TRACE_IF_CLASS(TL_CLASS_OBJ, tl_del_ctx, context)
 
 /**
  * KBASE_TLSTREAM_TL_DEL_ATOM - destroy atom object in timeline
@@ -294,7 +327,7 @@ extern atomic_t kbase_tlstream_enabled;
  * exist.
  */
 #define KBASE_TLSTREAM_TL_DEL_ATOM(atom) \
-	__TRACE_IF_ENABLED(tl_del_atom, atom)
+	__TRACE_IF_CLASS(TL_CLASS_OBJ, tl_del_atom, atom)
 
 /**
  * KBASE_TLSTREAM_TL_RET_CTX_LPU - retain context by LPU
@@ -305,7 +338,7 @@ extern atomic_t kbase_tlstream_enabled;
  * by LPU and must not be deleted unless it is released.
  */
 #define KBASE_TLSTREAM_TL_RET_CTX_LPU(context, lpu) \
-	__TRACE_IF_ENABLED(tl_ret_ctx_lpu, context, lpu)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_ret_ctx_lpu, context, lpu)
 
 /**
  * KBASE_TLSTREAM_TL_RET_ATOM_CTX - retain atom by context
@@ -316,7 +349,7 @@ extern atomic_t kbase_tlstream_enabled;
  * by context and must not be deleted unless it is released.
  */
 #define KBASE_TLSTREAM_TL_RET_ATOM_CTX(atom, context) \
-	__TRACE_IF_ENABLED(tl_ret_atom_ctx, atom, context)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_ret_atom_ctx, atom, context)
 
 /**
  * KBASE_TLSTREAM_TL_RET_ATOM_LPU - retain atom by LPU
@@ -328,7 +361,8 @@ extern atomic_t kbase_tlstream_enabled;
  * by LPU and must not be deleted unless it is released.
  */
 #define KBASE_TLSTREAM_TL_RET_ATOM_LPU(atom, lpu, attrib_match_list) \
-	__TRACE_IF_ENABLED(tl_ret_atom_lpu, atom, lpu, attrib_match_list)
+	__TRACE_IF_CLASS(TL_CLASS_RET, \
+			tl_ret_atom_lpu, atom, lpu, attrib_match_list)
 
 /**
  * KBASE_TLSTREAM_TL_NRET_CTX_LPU - release context by LPU
@@ -339,7 +373,7 @@ extern atomic_t kbase_tlstream_enabled;
  * by LPU object.
  */
 #define KBASE_TLSTREAM_TL_NRET_CTX_LPU(context, lpu) \
-	__TRACE_IF_ENABLED(tl_nret_ctx_lpu, context, lpu)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_nret_ctx_lpu, context, lpu)
 
 /**
  * KBASE_TLSTREAM_TL_NRET_ATOM_CTX - release atom by context
@@ -350,7 +384,7 @@ extern atomic_t kbase_tlstream_enabled;
  * released by context.
  */
 #define KBASE_TLSTREAM_TL_NRET_ATOM_CTX(atom, context) \
-	__TRACE_IF_ENABLED(tl_nret_atom_ctx, atom, context)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_nret_atom_ctx, atom, context)
 
 /**
  * KBASE_TLSTREAM_TL_NRET_ATOM_LPU - release atom by LPU
@@ -361,7 +395,7 @@ extern atomic_t kbase_tlstream_enabled;
  * released by LPU.
  */
 #define KBASE_TLSTREAM_TL_NRET_ATOM_LPU(atom, lpu) \
-	__TRACE_IF_ENABLED(tl_nret_atom_lpu, atom, lpu)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_nret_atom_lpu, atom, lpu)
 
 /**
  * KBASE_TLSTREAM_TL_RET_AS_CTX - lifelink address space object to context
@@ -372,7 +406,7 @@ extern atomic_t kbase_tlstream_enabled;
  * is being held by the context object.
  */
 #define KBASE_TLSTREAM_TL_RET_AS_CTX(as, ctx) \
-	__TRACE_IF_ENABLED(tl_ret_as_ctx, as, ctx)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_ret_as_ctx, as, ctx)
 
 /**
  * KBASE_TLSTREAM_TL_NRET_AS_CTX - release address space by context
@@ -383,7 +417,7 @@ extern atomic_t kbase_tlstream_enabled;
  * is being released by atom.
  */
 #define KBASE_TLSTREAM_TL_NRET_AS_CTX(as, ctx) \
-	__TRACE_IF_ENABLED(tl_nret_as_ctx, as, ctx)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_nret_as_ctx, as, ctx)
 
 /**
  * KBASE_TLSTREAM_TL_RET_ATOM_AS - retain atom by address space
@@ -394,7 +428,7 @@ extern atomic_t kbase_tlstream_enabled;
  * by address space and must not be deleted unless it is released.
  */
 #define KBASE_TLSTREAM_TL_RET_ATOM_AS(atom, as) \
-	__TRACE_IF_ENABLED(tl_ret_atom_as, atom, as)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_ret_atom_as, atom, as)
 
 /**
  * KBASE_TLSTREAM_TL_NRET_ATOM_AS - release atom by address space
@@ -405,7 +439,7 @@ extern atomic_t kbase_tlstream_enabled;
  * released by address space.
  */
 #define KBASE_TLSTREAM_TL_NRET_ATOM_AS(atom, as) \
-	__TRACE_IF_ENABLED(tl_nret_atom_as, atom, as)
+	__TRACE_IF_CLASS(TL_CLASS_RET, tl_nret_atom_as, atom, as)
 
 /**
  * KBASE_TLSTREAM_TL_DEP_ATOM_ATOM - parent atom depends on child atom
@@ -416,7 +450,7 @@ extern atomic_t kbase_tlstream_enabled;
  * child atom object to be completed before start its execution.
  */
 #define KBASE_TLSTREAM_TL_DEP_ATOM_ATOM(atom1, atom2) \
-	__TRACE_IF_ENABLED(tl_dep_atom_atom, atom1, atom2)
+	__TRACE_IF_CLASS(TL_CLASS_DEP, tl_dep_atom_atom, atom1, atom2)
 
 /**
  * KBASE_TLSTREAM_TL_NDEP_ATOM_ATOM - dependency between atoms resolved
@@ -427,7 +461,7 @@ extern atomic_t kbase_tlstream_enabled;
  * dependency on child atom has been resolved.
  */
 #define KBASE_TLSTREAM_TL_NDEP_ATOM_ATOM(atom1, atom2) \
-	__TRACE_IF_ENABLED(tl_ndep_atom_atom, atom1, atom2)
+	__TRACE_IF_CLASS(TL_CLASS_DEP, tl_ndep_atom_atom, atom1, atom2)
 
 /**
  * KBASE_TLSTREAM_TL_RDEP_ATOM_ATOM - information about already resolved dependency between atoms
@@ -438,7 +472,7 @@ extern atomic_t kbase_tlstream_enabled;
  * dependency on child atom has been resolved.
  */
 #define KBASE_TLSTREAM_TL_RDEP_ATOM_ATOM(atom1, atom2) \
-	__TRACE_IF_ENABLED(tl_rdep_atom_atom, atom1, atom2)
+	__TRACE_IF_CLASS(TL_CLASS_DEP, tl_rdep_atom_atom, atom1, atom2)
 
 /**
  * KBASE_TLSTREAM_TL_ATTRIB_ATOM_CONFIG - atom job slot attributes
@@ -450,7 +484,8 @@ extern atomic_t kbase_tlstream_enabled;
  * Function emits a timeline message containing atom attributes.
  */
 #define KBASE_TLSTREAM_TL_ATTRIB_ATOM_CONFIG(atom, jd, affinity, config) \
-	__TRACE_IF_ENABLED(tl_attrib_atom_config, atom, jd, affinity, config)
+	__TRACE_IF_CLASS(TL_CLASS_ATTRIB, \
+			tl_attrib_atom_config, atom, jd, affinity, config)
 
 /**
  * KBASE_TLSTREAM_TL_ATTRIB_ATOM_PRIORITY - atom priority
@@ -460,7 +495,8 @@ extern atomic_t kbase_tlstream_enabled;
  * Function emits a timeline message containing atom priority.
  */
 #define KBASE_TLSTREAM_TL_ATTRIB_ATOM_PRIORITY(atom, prio) \
-	__TRACE_IF_ENABLED_LATENCY(tl_attrib_atom_priority, atom, prio)
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_ATTRIB, \
+			tl_attrib_atom_priority, atom, prio)
 
 /**
  * KBASE_TLSTREAM_TL_ATTRIB_ATOM_STATE - atom state
@@ -470,7 +506,8 @@ extern atomic_t kbase_tlstream_enabled;
  * Function emits a timeline message containing atom state.
  */
 #define KBASE_TLSTREAM_TL_ATTRIB_ATOM_STATE(atom, state) \
-	__TRACE_IF_ENABLED_LATENCY(tl_attrib_atom_state, atom, state)
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_STATE, \
+			tl_attrib_atom_state, atom, state)
 
 /**
  * KBASE_TLSTREAM_TL_ATTRIB_ATOM_PRIORITY_CHANGE - atom caused priority change
@@ -479,7 +516,8 @@ extern atomic_t kbase_tlstream_enabled;
  * Function emits a timeline message signalling priority change
  */
 #define KBASE_TLSTREAM_TL_ATTRIB_ATOM_PRIORITY_CHANGE(atom) \
-	__TRACE_IF_ENABLED_LATENCY(tl_attrib_atom_priority_change, atom)
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_STATE, \
+			tl_attrib_atom_priority_change, atom)
 
 /**
  * KBASE_TLSTREAM_TL_ATTRIB_AS_CONFIG - address space attributes
@@ -491,28 +529,29 @@ extern atomic_t kbase_tlstream_enabled;
  * Function emits a timeline message containing address space attributes.
  */
 #define KBASE_TLSTREAM_TL_ATTRIB_AS_CONFIG(as, transtab, memattr, transcfg) \
-	__TRACE_IF_ENABLED(tl_attrib_as_config, as, transtab, memattr, transcfg)
+	__TRACE_IF_CLASS(TL_CLASS_ATTRIB, \
+			tl_attrib_as_config, as, transtab, memattr, transcfg)
 
 /**
  * KBASE_TLSTREAM_TL_EVENT_ATOM_SOFTSTOP_ex
  * @atom:       atom identifier
  */
 #define KBASE_TLSTREAM_TL_EVENT_ATOM_SOFTSTOP_EX(atom) \
-	__TRACE_IF_ENABLED(tl_event_atom_softstop_ex, atom)
+	__TRACE_IF_CLASS(TL_CLASS_EVENT, tl_event_atom_softstop_ex, atom)
 
 /**
  * KBASE_TLSTREAM_TL_EVENT_LPU_softstop
  * @lpu:        name of the LPU object
  */
 #define KBASE_TLSTREAM_TL_EVENT_LPU_SOFTSTOP(lpu) \
-	__TRACE_IF_ENABLED(tl_event_lpu_softstop, lpu)
+	__TRACE_IF_CLASS(TL_CLASS_EVENT, tl_event_lpu_softstop, lpu)
 
 /**
  * KBASE_TLSTREAM_TL_EVENT_ATOM_SOFTSTOP_issue
  * @atom:       atom identifier
  */
 #define KBASE_TLSTREAM_TL_EVENT_ATOM_SOFTSTOP_ISSUE(atom) \
-	__TRACE_IF_ENABLED(tl_event_atom_softstop_issue, atom)
+	__TRACE_IF_CLASS(TL_CLASS_EVENT, tl_event_atom_softstop_issue, atom)
 
 /**
  * KBASE_TLSTREAM_JD_GPU_SOFT_RESET - The GPU is being soft reset
@@ -522,7 +561,7 @@ extern atomic_t kbase_tlstream_enabled;
  * Function emits a timeline message indicating GPU soft reset.
  */
 #define KBASE_TLSTREAM_JD_GPU_SOFT_RESET(gpu) \
-	__TRACE_IF_ENABLED(jd_gpu_soft_reset, gpu)
+	__TRACE_IF_CLASS(TL_CLASS_EVENT, jd_gpu_soft_reset, gpu)
 
 
 /**
@@ -531,7 +570,7 @@ extern atomic_t kbase_tlstream_enabled;
  * @state:     64bits bitmask reporting power state of the cores (1-ON, 0-OFF)
  */
 #define KBASE_TLSTREAM_AUX_PM_STATE(core_type, state) \
-	__TRACE_IF_ENABLED(aux_pm_state, core_type, state)
+	__TRACE_IF_CLASS(TL_CLASS_AUX, aux_pm_state, core_type, state)
 
 /**
  * KBASE_TLSTREAM_AUX_PAGEFAULT - timeline message: MMU page fault event
@@ -540,7 +579,7 @@ extern atomic_t kbase_tlstream_enabled;
  * @page_count_change: number of pages to be added
  */
 #define KBASE_TLSTREAM_AUX_PAGEFAULT(ctx_nr, page_count_change) \
-	__TRACE_IF_ENABLED(aux_pagefault, ctx_nr, page_count_change)
+	__TRACE_IF_CLASS(TL_CLASS_AUX, aux_pagefault, ctx_nr, page_count_change)
 
 /**
  * KBASE_TLSTREAM_AUX_PAGESALLOC - timeline message: total number of allocated
@@ -549,7 +588,7 @@ extern atomic_t kbase_tlstream_enabled;
  * @page_count: number of pages used by the context
  */
 #define KBASE_TLSTREAM_AUX_PAGESALLOC(ctx_nr, page_count) \
-	__TRACE_IF_ENABLED(aux_pagesalloc, ctx_nr, page_count)
+	__TRACE_IF_CLASS(TL_CLASS_AUX, aux_pagesalloc, ctx_nr, page_count)
 
 /**
  * KBASE_TLSTREAM_AUX_DEVFREQ_TARGET - timeline message: new target DVFS
@@ -557,7 +596,7 @@ extern atomic_t kbase_tlstream_enabled;
  * @target_freq: new target frequency
  */
 #define KBASE_TLSTREAM_AUX_DEVFREQ_TARGET(target_freq) \
-	__TRACE_IF_ENABLED(aux_devfreq_target, target_freq)
+	__TRACE_IF_CLASS(TL_CLASS_AUX, aux_devfreq_target, target_freq)
 
 /**
  * KBASE_TLSTREAM_AUX_PROTECTED_ENTER_START - The GPU has started transitioning
@@ -568,7 +607,7 @@ extern atomic_t kbase_tlstream_enabled;
  * transition to protected mode.
  */
 #define KBASE_TLSTREAM_AUX_PROTECTED_ENTER_START(gpu) \
-	__TRACE_IF_ENABLED_LATENCY(aux_protected_enter_start, gpu)
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_AUX, aux_protected_enter_start, gpu)
 
 /**
  * KBASE_TLSTREAM_AUX_PROTECTED_ENTER_END - The GPU has finished transitioning
@@ -579,7 +618,7 @@ extern atomic_t kbase_tlstream_enabled;
  * transitioning to protected mode.
  */
 #define KBASE_TLSTREAM_AUX_PROTECTED_ENTER_END(gpu) \
-	__TRACE_IF_ENABLED_LATENCY(aux_protected_enter_end, gpu)
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_AUX, aux_protected_enter_end, gpu)
 
 /**
  * KBASE_TLSTREAM_AUX_PROTECTED_LEAVE_START - The GPU has started transitioning
@@ -590,7 +629,7 @@ extern atomic_t kbase_tlstream_enabled;
  * transition to non-protected mode.
  */
 #define KBASE_TLSTREAM_AUX_PROTECTED_LEAVE_START(gpu) \
-	__TRACE_IF_ENABLED_LATENCY(aux_protected_leave_start, gpu)
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_AUX, aux_protected_leave_start, gpu)
 
 /**
  * KBASE_TLSTREAM_AUX_PROTECTED_LEAVE_END - The GPU has finished transitioning
@@ -601,7 +640,33 @@ extern atomic_t kbase_tlstream_enabled;
  * transitioning to non-protected mode.
  */
 #define KBASE_TLSTREAM_AUX_PROTECTED_LEAVE_END(gpu) \
-	__TRACE_IF_ENABLED_LATENCY(aux_protected_leave_end, gpu)
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_AUX, aux_protected_leave_end, gpu)
+
+/* Number of counter values carried by a KBASE_TLSTREAM_AUX_JOB_SAMPLE */
+#define KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS 8
+
+/**
+ * KBASE_TLSTREAM_AUX_JOB_SAMPLE - timeline message: hardware counters counted
+ *                                 while an atom ran alone on the GPU
+ * @atom:   atom identifier
+ * @values: KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS counter values, in the order
+ *          the counters were selected through hwcnt_job_sample_counters
+ *
+ * Emitted once for every atom flagged with BASE_JD_REQ_HWCNT_SAMPLE.
+ */
+#define KBASE_TLSTREAM_AUX_JOB_SAMPLE(atom, values) \
+	__TRACE_IF_CLASS(TL_CLASS_AUX, aux_job_sample, atom, values)
+
+/**
+ * KBASE_TLSTREAM_AUX_FENCE_WAIT - timeline message: atom no longer waits for
+ *                                 dma-buf fences
+ * @atom:    atom identifier
+ * @wait_ns: time the atom waited for the fences of its external resources
+ *
+ * Only emitted for atoms which had to wait, from the dma-fence worker.
+ */
+#define KBASE_TLSTREAM_AUX_FENCE_WAIT(atom, wait_ns) \
+	__TRACE_IF_CLASS_LATENCY(TL_CLASS_AUX, aux_fence_wait, atom, wait_ns)
 
 #endif /* _KBASE_TLSTREAM_H */
 
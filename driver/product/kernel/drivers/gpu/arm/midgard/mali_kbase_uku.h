@@ -62,9 +62,19 @@
  *
  * 10.6:
  * - Add flags input variable to KBASE_FUNC_TLSTREAM_ACQUIRE
+ *
+ * 10.7:
+ * - Add BASE_JD_REQ_HWCNT_SAMPLE flag for job-boundary counter sampling
+ *
+ * 10.8:
+ * - Add BASE_JD_REQ_FENCE_EXPORT flag to signal a sync fence on completion
+ *
+ * 10.9:
+ * - Add BASE_JD_REQ_SOFT_TIMELINE_WAIT / _SIGNAL soft jobs and
+ *   KBASE_FUNC_TIMELINE_BATCH to signal or wait on many timelines at once
  */
 #define BASE_UK_VERSION_MAJOR 10
-#define BASE_UK_VERSION_MINOR 6
+#define BASE_UK_VERSION_MINOR 9
 
 struct kbase_uk_mem_alloc {
 	union uk_header header;
@@ -453,6 +463,38 @@ struct kbase_uk_soft_event_update {
 	u32 flags;
 };
 
+/* Operations for KBASE_FUNC_TIMELINE_BATCH */
+#define KBASE_TIMELINE_BATCH_SIGNAL   0
+#define KBASE_TIMELINE_BATCH_WAIT_ALL 1
+#define KBASE_TIMELINE_BATCH_WAIT_ANY 2
+
+/* Most timeline points accepted by one KBASE_FUNC_TIMELINE_BATCH call */
+#define KBASE_TIMELINE_BATCH_MAX_POINTS 64
+
+/**
+ * struct kbase_uk_timeline_batch - User/Kernel space data exchange structure
+ * @header:     UK structure header
+ * @points:     array of @count struct base_jd_timeline_point
+ * @count:      number of points, at most KBASE_TIMELINE_BATCH_MAX_POINTS
+ * @op:         one of the KBASE_TIMELINE_BATCH_* operations
+ * @timeout_ns: how long a wait may block for, 0 only polls
+ *
+ * KBASE_TIMELINE_BATCH_SIGNAL advances every timeline to its point, unless it
+ * is already past it, and completes the jobs waiting on the points reached.
+ * The wait operations block until all, or any, of the timelines have reached
+ * their points. A timeout is reported as MALI_ERROR_FUNCTION_FAILED, while a
+ * wait interrupted by a signal fails the ioctl itself with EINTR, unless it is
+ * restarted.
+ */
+struct kbase_uk_timeline_batch {
+	union uk_header header;
+	/* IN */
+	union kbase_pointer points;
+	u32 count;
+	u32 op;
+	u64 timeout_ns;
+};
+
 /**
  * struct kbase_uk_mem_jit_init - User/Kernel space data exchange structure
  * @header:     UK structure header
@@ -535,6 +577,8 @@ enum kbase_uk_function_id {
 
 	KBASE_FUNC_TLSTREAM_ACQUIRE = (UK_FUNC_ID + 40),
 
+	KBASE_FUNC_TIMELINE_BATCH = (UK_FUNC_ID + 41),
+
 	KBASE_FUNC_MAX
 };
 
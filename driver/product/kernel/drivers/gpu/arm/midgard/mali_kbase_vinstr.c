@@ -17,6 +17,7 @@
 
 #include <linux/anon_inodes.h>
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
 #include <linux/hrtimer.h>
 #include <linux/jiffies.h>
 #include <linux/kthread.h>
@@ -24,6 +25,8 @@
 #include <linux/mm.h>
 #include <linux/poll.h>
 #include <linux/preempt.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/wait.h>
 
@@ -33,11 +36,12 @@
 #include <mali_kbase_hwcnt_reader.h>
 #include <mali_kbase_mem_linux.h>
 #include <mali_kbase_tlstream.h>
+#include <mali_kbase_vinstr_neon.h>
 
 /*****************************************************************************/
 
 /* Hwcnt reader API version */
-#define HWCNT_READER_API        1
+#define HWCNT_READER_API        2
 
 /* The number of nanoseconds in a second. */
 #define NSECS_IN_SEC            1000000000ull /* ns */
@@ -72,6 +76,30 @@ enum vinstr_state {
 	VINSTR_RESUMING
 };
 
+/* Index of the GPU_ACTIVE counter in the dump buffer, reported for sampled
+ * atoms until other counters are selected */
+#define JOB_SAMPLE_GPU_ACTIVE_V4 (7 * NR_CNT_PER_BLOCK + 6)
+#define JOB_SAMPLE_GPU_ACTIVE    6
+
+/**
+ * enum vinstr_job_sample_state - state of job-boundary sampling
+ * @JOB_SAMPLE_IDLE:          no atom is being sampled
+ * @JOB_SAMPLE_DRAINING:      atom waits for the other job slots to become
+ *                            idle, no other atom is submitted meanwhile
+ * @JOB_SAMPLE_BEGIN_PENDING: counters are being dumped before the atom runs
+ * @JOB_SAMPLE_READY:         atom can be submitted
+ * @JOB_SAMPLE_RUNNING:       atom is running alone on the GPU
+ * @JOB_SAMPLE_END_PENDING:   counters are being dumped after the atom ran
+ */
+enum vinstr_job_sample_state {
+	JOB_SAMPLE_IDLE,
+	JOB_SAMPLE_DRAINING,
+	JOB_SAMPLE_BEGIN_PENDING,
+	JOB_SAMPLE_READY,
+	JOB_SAMPLE_RUNNING,
+	JOB_SAMPLE_END_PENDING
+};
+
 /**
  * struct kbase_vinstr_context - vinstr context per device
  * @lock:              protects the entire vinstr context
@@ -98,6 +126,26 @@ enum vinstr_state {
  * @thread:            periodic sampling thread
  * @waitq:             notification queue of sampling thread
  * @request_pending:   request for action for sampling thread
+ * @accum_total:       running 64-bit totals of all dumped counters. Clients
+ *                     take the difference from their own snapshot when they
+ *                     are sampled, so dumps only accumulate once regardless
+ *                     of the number of clients.
+ * @nr_dumps:          number of hwcnt dumps performed
+ * @nr_periodic_dumps: number of hwcnt dumps performed by the sampling thread
+ * @nr_samples:        number of samples delivered to clients
+ * @service_cpu_ns:    CPU time used by terminated sampling threads
+ * @job_sample_lock:   serializes enabling and disabling of job sampling
+ * @job_sample_cli:    kernel client keeping counters enabled while job
+ *                     sampling is enabled
+ * @job_sample_buffer: dump buffer of @job_sample_cli
+ * @job_sample_start:  running totals before @job_sample_atom was submitted
+ * @job_sample_work:   worker dumping counters at job boundaries
+ * @job_sample_state:  job sampling state, protected by hwaccess_lock
+ * @job_sample_atom:   atom being sampled, protected by hwaccess_lock
+ * @job_sample_valid:  true if @job_sample_start is valid for @job_sample_atom
+ * @job_sample_counters:    indices in the dump buffer of the counters
+ *                          reported for sampled atoms, protected by @lock
+ * @job_sample_nr_counters: number of valid entries in @job_sample_counters
  */
 struct kbase_vinstr_context {
 	struct mutex             lock;
@@ -126,6 +174,23 @@ struct kbase_vinstr_context {
 	struct task_struct       *thread;
 	wait_queue_head_t        waitq;
 	atomic_t                 request_pending;
+
+	u64                      *accum_total;
+	u64                      nr_dumps;
+	u64                      nr_periodic_dumps;
+	u64                      nr_samples;
+	atomic64_t               service_cpu_ns;
+
+	struct mutex                 job_sample_lock;
+	struct kbase_vinstr_client   *job_sample_cli;
+	void                         *job_sample_buffer;
+	u64                          *job_sample_start;
+	struct work_struct           job_sample_work;
+	enum vinstr_job_sample_state job_sample_state;
+	struct kbase_jd_atom         *job_sample_atom;
+	bool                         job_sample_valid;
+	u32 job_sample_counters[KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS];
+	u32                          job_sample_nr_counters;
 };
 
 /**
@@ -139,6 +204,8 @@ struct kbase_vinstr_context {
  * @legacy_buffer: userspace hwcnt dump buffer (legacy interface)
  * @kernel_buffer: kernel hwcnt dump buffer (kernel client interface)
  * @accum_buffer:  temporary accumulation buffer for preserving counters
+ * @accum_snapshot: running totals of the vinstr context when this client's
+ *                 counters were last accumulated
  * @dump_time:     next time this clients shall request hwcnt dump
  * @dump_interval: interval between periodic hwcnt dumps
  * @dump_buffers:  kernel hwcnt dump buffers allocated by this client
@@ -148,6 +215,11 @@ struct kbase_vinstr_context {
  * @write_idx:     index of buffer being written by dumping service
  * @waitq:         client's notification queue
  * @pending:       when true, client has attached but hwcnt not yet updated
+ * @mode:          format of the reader's sample buffers, see
+ *                 enum base_hwcnt_reader_mode
+ * @nr_blocks:     number of counter blocks in the dump buffer
+ * @block_types:   type of each counter block, used in compact mode
+ * @prev_buffer:   counters of the previous sample, used in delta mode
  */
 struct kbase_vinstr_client {
 	struct kbase_vinstr_context        *vinstr_ctx;
@@ -159,6 +231,7 @@ struct kbase_vinstr_client {
 	void __user                        *legacy_buffer;
 	void                               *kernel_buffer;
 	void                               *accum_buffer;
+	u64                                *accum_snapshot;
 	u64                                dump_time;
 	u32                                dump_interval;
 	char                               *dump_buffers;
@@ -168,6 +241,10 @@ struct kbase_vinstr_client {
 	atomic_t                           write_idx;
 	wait_queue_head_t                  waitq;
 	bool                               pending;
+	u32                                mode;
+	u32                                nr_blocks;
+	u8                                 *block_types;
+	u32                                *prev_buffer;
 };
 
 /**
@@ -348,6 +425,15 @@ static int kbasep_vinstr_map_kernel_dump_buffer(
 		return -ENOMEM;
 	}
 
+	vinstr_ctx->accum_total = kzalloc(
+			vinstr_ctx->dump_size / NR_BYTES_PER_CNT * sizeof(u64),
+			GFP_KERNEL);
+	if (!vinstr_ctx->accum_total) {
+		kbase_vunmap(kctx, &vinstr_ctx->vmap);
+		kbase_mem_free(kctx, vinstr_ctx->gpu_va);
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -356,6 +442,8 @@ static void kbasep_vinstr_unmap_kernel_dump_buffer(
 {
 	struct kbase_context *kctx = vinstr_ctx->kctx;
 
+	kfree(vinstr_ctx->accum_total);
+	vinstr_ctx->accum_total = NULL;
 	kbase_vunmap(kctx, &vinstr_ctx->vmap);
 	kbase_mem_free(kctx, vinstr_ctx->gpu_va);
 }
@@ -551,6 +639,11 @@ static struct kbase_vinstr_client *kbasep_vinstr_attach_client(
 	cli->accum_buffer = kzalloc(cli->dump_size, GFP_KERNEL);
 	if (!cli->accum_buffer)
 		goto error;
+	cli->accum_snapshot = kzalloc(
+			cli->dump_size / NR_BYTES_PER_CNT * sizeof(u64),
+			GFP_KERNEL);
+	if (!cli->accum_snapshot)
+		goto error;
 
 	/* Prepare buffers. */
 	if (cli->buffer_count) {
@@ -604,6 +697,7 @@ error:
 				(unsigned long)cli->dump_buffers,
 				get_order(cli->dump_size * cli->buffer_count));
 	kfree(cli->accum_buffer);
+	kfree(cli->accum_snapshot);
 	if (!vinstr_ctx->nclients && vinstr_ctx->kctx) {
 		thread = vinstr_ctx->thread;
 		kbasep_vinstr_destroy_kctx(vinstr_ctx);
@@ -659,6 +753,9 @@ void kbase_vinstr_detach_client(struct kbase_vinstr_client *cli)
 			(unsigned long)cli->dump_buffers,
 			get_order(cli->dump_size * cli->buffer_count));
 	kfree(cli->accum_buffer);
+	kfree(cli->accum_snapshot);
+	kfree(cli->block_types);
+	kfree(cli->prev_buffer);
 	kfree(cli);
 
 	vinstr_ctx->nclients--;
@@ -682,27 +779,82 @@ void kbase_vinstr_detach_client(struct kbase_vinstr_client *cli)
 }
 KBASE_EXPORT_TEST_API(kbase_vinstr_detach_client);
 
-/* Accumulate counters in the dump buffer */
-static void accum_dump_buffer(void *dst, void *src, size_t dump_size)
+/**
+ * accum_block_scalar - accumulate counters of one block into running totals
+ * @d:     64-bit running totals
+ * @s:     counters to add to @d
+ * @count: number of counters
+ */
+static inline void accum_block_scalar(u64 *d, const u32 *s, size_t count)
 {
-	size_t block_size = NR_CNT_PER_BLOCK * NR_BYTES_PER_CNT;
-	u32 *d = dst;
-	u32 *s = src;
-	size_t i, j;
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		d[i] += s[i];
+}
+
+/**
+ * delta_block_scalar - accumulate counters of one block counted since a
+ *                      snapshot of the running totals
+ * @d:     accumulation buffer
+ * @total: 64-bit running totals
+ * @snap:  totals at the previous snapshot, updated to @total
+ * @count: number of counters
+ *
+ * Results are saturated to U32_MAX if the addition wraps around. The
+ * comparisons are written so that the compiler can emit them without a
+ * branch.
+ */
+static inline void delta_block_scalar(u32 *d, const u64 *total, u64 *snap,
+		size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		u64 delta = total[i] - snap[i];
+		u32 s = (delta > U32_MAX) ? U32_MAX : (u32)delta;
+		u32 sum = d[i] + s;
+
+		d[i] = (sum < s) ? U32_MAX : sum;
+		snap[i] = total[i];
+	}
+}
+
+/**
+ * accum_dump_buffer - accumulate counters in the dump buffer into running
+ *                     totals
+ * @dst:       64-bit running totals, one per counter of the dump buffer
+ * @src:       master dump buffer
+ * @dump_size: size of the dump buffer in bytes
+ * @use_neon:  when true, use NEON widening adds. Caller must be inside a
+ *             kernel_neon_begin()/kernel_neon_end() section.
+ *
+ * Blocks whose enable mask is zero were not counted by the hardware for any
+ * client and are skipped.
+ */
+static void accum_dump_buffer(u64 *dst, const u32 *src, size_t dump_size,
+		bool use_neon)
+{
+	const size_t block_size = NR_CNT_PER_BLOCK * NR_BYTES_PER_CNT;
+	const size_t hdr_cnt = NR_BYTES_PER_HDR / NR_BYTES_PER_CNT;
+	const size_t nr_cnt = NR_CNT_PER_BLOCK - hdr_cnt;
+	size_t i;
 
 	for (i = 0; i < dump_size; i += block_size) {
-		/* skip over the header block */
-		d += NR_BYTES_PER_HDR / sizeof(u32);
-		s += NR_BYTES_PER_HDR / sizeof(u32);
-		for (j = 0; j < (block_size - NR_BYTES_PER_HDR) / sizeof(u32); j++) {
-			/* saturate result if addition would result in wraparound */
-			if (U32_MAX - *d < *s)
-				*d = U32_MAX;
+		if (src[PRFCNT_EN_MASK_OFFSET / NR_BYTES_PER_CNT]) {
+#ifdef KBASE_VINSTR_ACCUM_NEON
+			if (use_neon)
+				kbasep_vinstr_accum_neon(
+						dst + hdr_cnt, src + hdr_cnt,
+						nr_cnt);
 			else
-				*d += *s;
-			d++;
-			s++;
+#endif
+				accum_block_scalar(
+						dst + hdr_cnt, src + hdr_cnt,
+						nr_cnt);
 		}
+		dst += NR_CNT_PER_BLOCK;
+		src += NR_CNT_PER_BLOCK;
 	}
 }
 
@@ -837,46 +989,110 @@ static void patch_dump_buffer_hdr_v5(
 }
 
 /**
- * accum_clients - accumulate dumped hw counters for all known clients
+ * accum_total - accumulate dumped hw counters into the running totals
+ * @vinstr_ctx: vinstr context
+ */
+static void accum_total(struct kbase_vinstr_context *vinstr_ctx)
+{
+	bool use_neon = false;
+
+#ifdef KBASE_VINSTR_ACCUM_NEON
+	use_neon = kbasep_vinstr_has_neon();
+	if (use_neon)
+		kernel_neon_begin();
+#endif
+
+	accum_dump_buffer(
+			vinstr_ctx->accum_total,
+			vinstr_ctx->cpu_va,
+			vinstr_ctx->dump_size,
+			use_neon);
+
+#ifdef KBASE_VINSTR_ACCUM_NEON
+	if (use_neon)
+		kernel_neon_end();
+#endif
+}
+
+/**
+ * accum_client - accumulate hw counters counted since the client was last
+ *                accumulated
  * @vinstr_ctx: vinstr context
+ * @cli:        client to accumulate counters for
+ *
+ * This is only done when the client is sampled, so clients sampled at a low
+ * rate do not pay for dumps requested by other clients. Blocks whose enable
+ * mask is zero for this client are not accumulated.
  */
-static void accum_clients(struct kbase_vinstr_context *vinstr_ctx)
+static void accum_client(struct kbase_vinstr_context *vinstr_ctx,
+		struct kbase_vinstr_client *cli)
 {
-	struct kbase_vinstr_client *iter;
+	const size_t block_size = NR_CNT_PER_BLOCK * NR_BYTES_PER_CNT;
+	const size_t hdr_cnt = NR_BYTES_PER_HDR / NR_BYTES_PER_CNT;
+	const size_t nr_cnt = NR_CNT_PER_BLOCK - hdr_cnt;
+	u32 *d = cli->accum_buffer;
+	u64 *total = vinstr_ctx->accum_total;
+	u64 *snap = cli->accum_snapshot;
+	bool use_neon = false;
 	int v4 = 0;
+	size_t i;
+
+	/* Don't bother accumulating clients whose hwcnt requests
+	 * have not yet been honoured. */
+	if (cli->pending)
+		return;
 
 #ifndef CONFIG_MALI_NO_MALI
 	v4 = kbase_hw_has_feature(vinstr_ctx->kbdev, BASE_HW_FEATURE_V4);
 #endif
+	if (v4)
+		patch_dump_buffer_hdr_v4(vinstr_ctx, cli);
+	else
+		patch_dump_buffer_hdr_v5(vinstr_ctx, cli);
 
-	list_for_each_entry(iter, &vinstr_ctx->idle_clients, list) {
-		/* Don't bother accumulating clients whose hwcnt requests
-		 * have not yet been honoured. */
-		if (iter->pending)
-			continue;
-		if (v4)
-			patch_dump_buffer_hdr_v4(vinstr_ctx, iter);
-		else
-			patch_dump_buffer_hdr_v5(vinstr_ctx, iter);
-		accum_dump_buffer(
-				iter->accum_buffer,
-				vinstr_ctx->cpu_va,
-				iter->dump_size);
-	}
-	list_for_each_entry(iter, &vinstr_ctx->waiting_clients, list) {
-		/* Don't bother accumulating clients whose hwcnt requests
-		 * have not yet been honoured. */
-		if (iter->pending)
-			continue;
-		if (v4)
-			patch_dump_buffer_hdr_v4(vinstr_ctx, iter);
-		else
-			patch_dump_buffer_hdr_v5(vinstr_ctx, iter);
-		accum_dump_buffer(
-				iter->accum_buffer,
-				vinstr_ctx->cpu_va,
-				iter->dump_size);
+#ifdef KBASE_VINSTR_ACCUM_NEON
+	use_neon = kbasep_vinstr_has_neon();
+	if (use_neon)
+		kernel_neon_begin();
+#endif
+
+	for (i = 0; i < cli->dump_size; i += block_size) {
+		if (d[PRFCNT_EN_MASK_OFFSET / NR_BYTES_PER_CNT]) {
+#ifdef KBASE_VINSTR_ACCUM_NEON
+			if (use_neon)
+				kbasep_vinstr_delta_neon(
+						d + hdr_cnt, total + hdr_cnt,
+						snap + hdr_cnt, nr_cnt);
+			else
+#endif
+				delta_block_scalar(
+						d + hdr_cnt, total + hdr_cnt,
+						snap + hdr_cnt, nr_cnt);
+		} else {
+			memcpy(snap, total, NR_CNT_PER_BLOCK * sizeof(u64));
+		}
+		d += NR_CNT_PER_BLOCK;
+		total += NR_CNT_PER_BLOCK;
+		snap += NR_CNT_PER_BLOCK;
 	}
+
+#ifdef KBASE_VINSTR_ACCUM_NEON
+	if (use_neon)
+		kernel_neon_end();
+#endif
+}
+
+/**
+ * accum_client_reset - discard hw counters counted for a client so far
+ * @vinstr_ctx: vinstr context
+ * @cli:        client to reset
+ */
+static void accum_client_reset(struct kbase_vinstr_context *vinstr_ctx,
+		struct kbase_vinstr_client *cli)
+{
+	memcpy(cli->accum_snapshot, vinstr_ctx->accum_total,
+			cli->dump_size / NR_BYTES_PER_CNT * sizeof(u64));
+	memset(cli->accum_buffer, 0, cli->dump_size);
 }
 
 /*****************************************************************************/
@@ -921,6 +1137,23 @@ static void kbasep_vinstr_add_dump_request(
 	list_add_tail(&cli->list, waiting_clients);
 }
 
+/**
+ * kbasep_vinstr_align_dump_time - return first dumping time after timestamp
+ * @timestamp: current time
+ * @interval:  client's dumping interval
+ *
+ * Dumping times are aligned on multiples of the client's interval. Deadlines
+ * of clients whose intervals are multiples of each other then coincide and
+ * are served by a single dump: a client sampled every second is served by one
+ * in every thousand dumps of a client sampled every millisecond.
+ *
+ * Return: first multiple of @interval after @timestamp
+ */
+static u64 kbasep_vinstr_align_dump_time(u64 timestamp, u32 interval)
+{
+	return (div_u64(timestamp, interval) + 1) * interval;
+}
+
 /**
  * kbasep_vinstr_collect_and_accumulate - collect hw counters via low level
  *                                        dump and accumulate them for known
@@ -977,12 +1210,143 @@ static int kbasep_vinstr_collect_and_accumulate(
 	spin_unlock_irqrestore(&vinstr_ctx->state_lock, flags);
 
 	/* Accumulate values of collected counters. */
-	if (!rcode)
-		accum_clients(vinstr_ctx);
+	if (!rcode) {
+		accum_total(vinstr_ctx);
+		vinstr_ctx->nr_dumps++;
+	}
 
 	return rcode;
 }
 
+/**
+ * kbasep_vinstr_fill_block_types - describe blocks of the dump buffer
+ * @vinstr_ctx: vinstr context
+ * @types:      array receiving the type of each block
+ * @nr_blocks:  number of blocks in the dump buffer
+ */
+static void kbasep_vinstr_fill_block_types(
+		struct kbase_vinstr_context *vinstr_ctx, u8 *types,
+		u32 nr_blocks)
+{
+	struct kbase_device *kbdev = vinstr_ctx->kbdev;
+	u64 core_mask;
+	u32 i = 0;
+	int v4 = 0;
+
+#ifndef CONFIG_MALI_NO_MALI
+	v4 = kbase_hw_has_feature(kbdev, BASE_HW_FEATURE_V4);
+#endif
+
+	if (v4) {
+		u32 nr_cg = kbdev->gpu_props.num_core_groups;
+		u32 cg, sc;
+
+		for (cg = 0; cg < nr_cg && i < nr_blocks; cg++) {
+			core_mask = kbdev->gpu_props.props.coherency_info.group[
+				cg].core_mask;
+			for (sc = 0; sc < 4; sc++)
+				types[i++] = (core_mask & (1ull << sc)) ?
+					BASE_HWCNT_READER_BLOCK_SHADER :
+					BASE_HWCNT_READER_BLOCK_RESERVED;
+			types[i++] = BASE_HWCNT_READER_BLOCK_TILER;
+			types[i++] = BASE_HWCNT_READER_BLOCK_MMU_L2;
+			types[i++] = BASE_HWCNT_READER_BLOCK_RESERVED;
+			types[i++] = (0 == cg) ?
+				BASE_HWCNT_READER_BLOCK_JM :
+				BASE_HWCNT_READER_BLOCK_RESERVED;
+		}
+	} else {
+		u32 nr_l2 = kbdev->gpu_props.props.l2_props.num_l2_slices;
+		u32 j;
+
+		core_mask =
+			kbdev->gpu_props.props.coherency_info.group[0].core_mask;
+
+		types[i++] = BASE_HWCNT_READER_BLOCK_JM;
+		types[i++] = BASE_HWCNT_READER_BLOCK_TILER;
+		for (j = 0; j < nr_l2; j++)
+			types[i++] = BASE_HWCNT_READER_BLOCK_MMU_L2;
+		for (; core_mask && i < nr_blocks; core_mask >>= 1)
+			types[i++] = (core_mask & 1ull) ?
+				BASE_HWCNT_READER_BLOCK_SHADER :
+				BASE_HWCNT_READER_BLOCK_RESERVED;
+	}
+
+	/* Any block not accounted for is not backed by hardware. */
+	for (; i < nr_blocks; i++)
+		types[i] = BASE_HWCNT_READER_BLOCK_RESERVED;
+}
+
+/**
+ * kbasep_vinstr_fill_compact_buffer - copy accumulated counters of enabled
+ *                                     blocks to empty kernel buffer
+ * @cli:    requesting client
+ * @buffer: sample buffer to fill
+ *
+ * The sample buffer is laid out as described by
+ * struct kbase_hwcnt_reader_block_map. In delta mode, the previous sample is
+ * updated with the accumulated counters.
+ */
+static void kbasep_vinstr_fill_compact_buffer(
+		struct kbase_vinstr_client *cli, void *buffer)
+{
+	const size_t hdr_cnt = NR_BYTES_PER_HDR / NR_BYTES_PER_CNT;
+	const bool delta = !!(cli->mode & BASE_HWCNT_READER_MODE_DELTA);
+	struct kbase_hwcnt_reader_block_map *map = buffer;
+	struct kbase_hwcnt_reader_block_desc *desc;
+	u32 *payload;
+	u32 i, j;
+
+	desc = (struct kbase_hwcnt_reader_block_desc *)(map + 1);
+	payload = (u32 *)(desc + cli->nr_blocks);
+
+	map->nr_blocks   = cli->nr_blocks;
+	map->nr_payloads = 0;
+	map->mode        = cli->mode;
+	map->reserved    = 0;
+
+	for (i = 0; i < cli->nr_blocks; i++) {
+		u32 *src = (u32 *)cli->accum_buffer + i * NR_CNT_PER_BLOCK;
+		u32 *cnt = src + hdr_cnt;
+
+		desc[i].type        = cli->block_types[i];
+		desc[i].reserved    = 0;
+		desc[i].enable_mask =
+			src[PRFCNT_EN_MASK_OFFSET / NR_BYTES_PER_CNT];
+
+		if (BASE_HWCNT_READER_BLOCK_RESERVED == desc[i].type ||
+				!desc[i].enable_mask) {
+			desc[i].state = BASE_HWCNT_READER_BLOCK_ABSENT;
+			continue;
+		}
+
+		if (delta) {
+			u32 *prev = cli->prev_buffer + i * NR_CNT_PER_BLOCK +
+				hdr_cnt;
+			u32 changed = 0;
+
+			for (j = 0; j < BASE_HWCNT_READER_BLOCK_PAYLOAD_CNT;
+					j++) {
+				payload[j] = cnt[j] - prev[j];
+				changed |= payload[j];
+				prev[j] = cnt[j];
+			}
+			if (!changed) {
+				desc[i].state =
+					BASE_HWCNT_READER_BLOCK_UNCHANGED;
+				continue;
+			}
+		} else {
+			memcpy(payload, cnt, BASE_HWCNT_READER_BLOCK_PAYLOAD_CNT *
+					NR_BYTES_PER_CNT);
+		}
+
+		desc[i].state = BASE_HWCNT_READER_BLOCK_PRESENT;
+		payload += BASE_HWCNT_READER_BLOCK_PAYLOAD_CNT;
+		map->nr_payloads++;
+	}
+}
+
 /**
  * kbasep_vinstr_fill_dump_buffer - copy accumulated counters to empty kernel
  *                                  buffer
@@ -1013,7 +1377,10 @@ static int kbasep_vinstr_fill_dump_buffer(
 	meta->timestamp  = timestamp;
 	meta->event_id   = event_id;
 	meta->buffer_idx = write_idx;
-	memcpy(buffer, cli->accum_buffer, cli->dump_size);
+	if (cli->mode & BASE_HWCNT_READER_MODE_COMPACT)
+		kbasep_vinstr_fill_compact_buffer(cli, buffer);
+	else
+		memcpy(buffer, cli->accum_buffer, cli->dump_size);
 	return 0;
 }
 
@@ -1085,13 +1452,19 @@ static void kbasep_vinstr_reprogram(
 			list_for_each_entry(
 					iter,
 					&vinstr_ctx->idle_clients,
-					list)
+					list) {
+				if (iter->pending)
+					accum_client_reset(vinstr_ctx, iter);
 				iter->pending = false;
+			}
 			list_for_each_entry(
 					iter,
 					&vinstr_ctx->waiting_clients,
-					list)
+					list) {
+				if (iter->pending)
+					accum_client_reset(vinstr_ctx, iter);
 				iter->pending = false;
+			}
 		}
 	}
 }
@@ -1111,6 +1484,9 @@ static int kbasep_vinstr_update_client(
 {
 	int rcode = 0;
 
+	/* Accumulate counters counted since the client was last sampled. */
+	accum_client(cli->vinstr_ctx, cli);
+
 	/* Copy collected counters to user readable buffer. */
 	if (cli->buffer_count)
 		rcode = kbasep_vinstr_fill_dump_buffer(
@@ -1128,6 +1504,7 @@ static int kbasep_vinstr_update_client(
 	wmb();
 	atomic_inc(&cli->write_idx);
 	wake_up_interruptible(&cli->waitq);
+	cli->vinstr_ctx->nr_samples++;
 
 	/* Prepare for next request. */
 	memset(cli->accum_buffer, 0, cli->dump_size);
@@ -1226,6 +1603,8 @@ static int kbasep_vinstr_service_task(void *data)
 
 		rcode = kbasep_vinstr_collect_and_accumulate(vinstr_ctx,
 				&timestamp);
+		if (!rcode)
+			vinstr_ctx->nr_periodic_dumps++;
 
 		INIT_LIST_HEAD(&expired_requests);
 
@@ -1277,6 +1656,9 @@ static int kbasep_vinstr_service_task(void *data)
 		mutex_unlock(&vinstr_ctx->lock);
 	}
 
+	atomic64_add(current->se.sum_exec_runtime,
+			&vinstr_ctx->service_cpu_ns);
+
 	return 0;
 }
 
@@ -1395,8 +1777,9 @@ static long kbasep_vinstr_hwcnt_reader_ioctl_set_interval(
 	if (cli->dump_interval) {
 		if (DUMPING_RESOLUTION > cli->dump_interval)
 			cli->dump_interval = DUMPING_RESOLUTION;
-		cli->dump_time =
-			kbasep_vinstr_get_timestamp() + cli->dump_interval;
+		cli->dump_time = kbasep_vinstr_align_dump_time(
+				kbasep_vinstr_get_timestamp(),
+				cli->dump_interval);
 
 		kbasep_vinstr_add_dump_request(
 				cli, &vinstr_ctx->waiting_clients);
@@ -1494,6 +1877,63 @@ static long kbasep_vinstr_hwcnt_reader_ioctl_disable_event(
 	return 0;
 }
 
+/**
+ * kbasep_vinstr_hwcnt_reader_ioctl_set_mode - hwcnt reader's ioctl command
+ * @cli:  pointer to vinstr client structure
+ * @mode: format of sample buffers, see enum base_hwcnt_reader_mode
+ *
+ * Samples already in the sample buffers keep the format they were produced
+ * with. Setting delta mode restarts the delta encoding from zero.
+ *
+ * Return: zero on success
+ */
+static long kbasep_vinstr_hwcnt_reader_ioctl_set_mode(
+		struct kbase_vinstr_client *cli, u32 mode)
+{
+	struct kbase_vinstr_context *vinstr_ctx = cli->vinstr_ctx;
+	const u32 valid = BASE_HWCNT_READER_MODE_COMPACT |
+		BASE_HWCNT_READER_MODE_DELTA;
+	u32 nr_blocks = cli->dump_size / (NR_CNT_PER_BLOCK * NR_BYTES_PER_CNT);
+	u8 *block_types = NULL;
+	u32 *prev_buffer = NULL;
+
+	KBASE_DEBUG_ASSERT(vinstr_ctx);
+
+	if (mode & ~valid)
+		return -EINVAL;
+	/* Delta encoding is only available in compact mode. */
+	if ((mode & BASE_HWCNT_READER_MODE_DELTA) &&
+			!(mode & BASE_HWCNT_READER_MODE_COMPACT))
+		return -EINVAL;
+
+	if (mode & BASE_HWCNT_READER_MODE_COMPACT) {
+		block_types = kmalloc(nr_blocks, GFP_KERNEL);
+		if (!block_types)
+			return -ENOMEM;
+		kbasep_vinstr_fill_block_types(vinstr_ctx, block_types,
+				nr_blocks);
+	}
+	if (mode & BASE_HWCNT_READER_MODE_DELTA) {
+		prev_buffer = kzalloc(cli->dump_size, GFP_KERNEL);
+		if (!prev_buffer) {
+			kfree(block_types);
+			return -ENOMEM;
+		}
+	}
+
+	mutex_lock(&vinstr_ctx->lock);
+	swap(cli->block_types, block_types);
+	swap(cli->prev_buffer, prev_buffer);
+	cli->nr_blocks = nr_blocks;
+	cli->mode = mode;
+	mutex_unlock(&vinstr_ctx->lock);
+
+	kfree(block_types);
+	kfree(prev_buffer);
+
+	return 0;
+}
+
 /**
  * kbasep_vinstr_hwcnt_reader_ioctl_get_hwver - hwcnt reader's ioctl command
  * @cli:   pointer to vinstr client structure
@@ -1582,6 +2022,10 @@ static long kbasep_vinstr_hwcnt_reader_ioctl(struct file *filp,
 		rcode = kbasep_vinstr_hwcnt_reader_ioctl_disable_event(
 				cli, (enum base_hwcnt_reader_event)arg);
 		break;
+	case KBASE_HWCNT_READER_SET_MODE:
+		rcode = kbasep_vinstr_hwcnt_reader_ioctl_set_mode(
+				cli, (u32)arg);
+		break;
 	default:
 		rcode = -EINVAL;
 		break;
@@ -1753,6 +2197,232 @@ static void kbasep_vinstr_resume_worker(struct work_struct *data)
 
 /*****************************************************************************/
 
+/**
+ * kbasep_vinstr_job_sample_emit - emit the selected counters counted while
+ *                                 the sampled atom was running
+ * @vinstr_ctx: vinstr context
+ * @katom:      sampled atom, only used as an identifier
+ *
+ * A single message is emitted per atom, unused counter slots are zero.
+ */
+static void kbasep_vinstr_job_sample_emit(
+		struct kbase_vinstr_context *vinstr_ctx,
+		struct kbase_jd_atom *katom)
+{
+	u64 values[KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS] = { 0 };
+	u32 i;
+
+	lockdep_assert_held(&vinstr_ctx->lock);
+
+	for (i = 0; i < vinstr_ctx->job_sample_nr_counters; i++) {
+		u32 idx = vinstr_ctx->job_sample_counters[i];
+
+		values[i] = vinstr_ctx->accum_total[idx] -
+				vinstr_ctx->job_sample_start[idx];
+	}
+
+	KBASE_TLSTREAM_AUX_JOB_SAMPLE(katom, values);
+}
+
+/**
+ * kbasep_vinstr_job_sample_worker - dump counters at a job boundary
+ * @data: pointer to work structure
+ *
+ * Dumps taken before and after a sampled atom bracket the atom, as no other
+ * atom may be submitted until this worker has finished.
+ */
+static void kbasep_vinstr_job_sample_worker(struct work_struct *data)
+{
+	struct kbase_vinstr_context *vinstr_ctx =
+		container_of(data, struct kbase_vinstr_context,
+				job_sample_work);
+	struct kbase_device *kbdev = vinstr_ctx->kbdev;
+	enum vinstr_job_sample_state state;
+	struct kbase_jd_atom *katom;
+	unsigned long flags;
+	u64 timestamp;
+	int rcode;
+
+	spin_lock_irqsave(&kbdev->hwaccess_lock, flags);
+	state = vinstr_ctx->job_sample_state;
+	katom = vinstr_ctx->job_sample_atom;
+	spin_unlock_irqrestore(&kbdev->hwaccess_lock, flags);
+
+	if (state != JOB_SAMPLE_BEGIN_PENDING &&
+			state != JOB_SAMPLE_END_PENDING)
+		return;
+
+	mutex_lock(&vinstr_ctx->lock);
+	rcode = kbasep_vinstr_collect_and_accumulate(vinstr_ctx, &timestamp);
+	if (!rcode) {
+		if (state == JOB_SAMPLE_BEGIN_PENDING)
+			memcpy(vinstr_ctx->job_sample_start,
+					vinstr_ctx->accum_total,
+					vinstr_ctx->dump_size /
+					NR_BYTES_PER_CNT * sizeof(u64));
+		else if (vinstr_ctx->job_sample_valid)
+			kbasep_vinstr_job_sample_emit(vinstr_ctx, katom);
+	}
+	mutex_unlock(&vinstr_ctx->lock);
+
+	spin_lock_irqsave(&kbdev->hwaccess_lock, flags);
+	if (vinstr_ctx->job_sample_state == state &&
+			vinstr_ctx->job_sample_atom == katom) {
+		if (state == JOB_SAMPLE_BEGIN_PENDING) {
+			/* Run the atom even if counters could not be
+			 * dumped, it is just not reported. */
+			vinstr_ctx->job_sample_valid = !rcode;
+			vinstr_ctx->job_sample_state = JOB_SAMPLE_READY;
+		} else {
+			vinstr_ctx->job_sample_atom = NULL;
+			vinstr_ctx->job_sample_state = JOB_SAMPLE_IDLE;
+		}
+		kbase_backend_slot_update(kbdev);
+	}
+	spin_unlock_irqrestore(&kbdev->hwaccess_lock, flags);
+}
+
+bool kbase_vinstr_job_sample_submit(struct kbase_vinstr_context *vinstr_ctx,
+		struct kbase_jd_atom *katom, bool gpu_idle)
+{
+	lockdep_assert_held(&vinstr_ctx->kbdev->hwaccess_lock);
+
+	switch (vinstr_ctx->job_sample_state) {
+	case JOB_SAMPLE_IDLE:
+		if (!(katom->core_req & BASE_JD_REQ_HWCNT_SAMPLE))
+			return true;
+		vinstr_ctx->job_sample_atom = katom;
+		if (!gpu_idle) {
+			/* Stop refilling the other slots, otherwise the atom
+			 * could wait for an idle GPU forever. */
+			vinstr_ctx->job_sample_state = JOB_SAMPLE_DRAINING;
+			return false;
+		}
+		/* fall through */
+	case JOB_SAMPLE_DRAINING:
+		if (vinstr_ctx->job_sample_atom != katom || !gpu_idle)
+			return false;
+		vinstr_ctx->job_sample_valid = false;
+		vinstr_ctx->job_sample_state = JOB_SAMPLE_BEGIN_PENDING;
+		schedule_work(&vinstr_ctx->job_sample_work);
+		return false;
+	case JOB_SAMPLE_READY:
+		if (vinstr_ctx->job_sample_atom != katom)
+			return false;
+		vinstr_ctx->job_sample_state = JOB_SAMPLE_RUNNING;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void kbase_vinstr_job_sample_remove(struct kbase_vinstr_context *vinstr_ctx,
+		struct kbase_jd_atom *katom)
+{
+	lockdep_assert_held(&vinstr_ctx->kbdev->hwaccess_lock);
+
+	if (vinstr_ctx->job_sample_atom != katom)
+		return;
+
+	switch (vinstr_ctx->job_sample_state) {
+	case JOB_SAMPLE_RUNNING:
+		vinstr_ctx->job_sample_state = JOB_SAMPLE_END_PENDING;
+		schedule_work(&vinstr_ctx->job_sample_work);
+		break;
+	case JOB_SAMPLE_DRAINING:
+	case JOB_SAMPLE_BEGIN_PENDING:
+	case JOB_SAMPLE_READY:
+		/* Atom left the slot without being submitted. */
+		vinstr_ctx->job_sample_atom = NULL;
+		vinstr_ctx->job_sample_state = JOB_SAMPLE_IDLE;
+		break;
+	default:
+		break;
+	}
+}
+
+int kbase_vinstr_job_sample_enable(struct kbase_vinstr_context *vinstr_ctx,
+		bool enable)
+{
+	struct kbase_device *kbdev = vinstr_ctx->kbdev;
+	unsigned long flags;
+	bool v4 = false;
+	int err = 0;
+
+	mutex_lock(&vinstr_ctx->job_sample_lock);
+
+	if (enable == !!vinstr_ctx->job_sample_cli)
+		goto out;
+
+	if (enable) {
+		struct kbase_uk_hwcnt_reader_setup setup = {
+			.jm_bm     = ~0u,
+			.shader_bm = ~0u,
+			.tiler_bm  = ~0u,
+			.mmu_l2_bm = ~0u
+		};
+		size_t dump_size = kbase_vinstr_dump_size(kbdev);
+
+		vinstr_ctx->job_sample_buffer = kzalloc(dump_size, GFP_KERNEL);
+		vinstr_ctx->job_sample_start = kzalloc(
+				dump_size / NR_BYTES_PER_CNT * sizeof(u64),
+				GFP_KERNEL);
+		if (vinstr_ctx->job_sample_buffer &&
+				vinstr_ctx->job_sample_start)
+			vinstr_ctx->job_sample_cli =
+				kbase_vinstr_hwcnt_kernel_setup(vinstr_ctx,
+					&setup, vinstr_ctx->job_sample_buffer);
+		if (!vinstr_ctx->job_sample_cli) {
+			err = -ENOMEM;
+			goto free_buffers;
+		}
+
+#ifndef CONFIG_MALI_NO_MALI
+		v4 = kbase_hw_has_feature(kbdev, BASE_HW_FEATURE_V4);
+#endif
+
+		mutex_lock(&vinstr_ctx->lock);
+		if (!vinstr_ctx->job_sample_nr_counters) {
+			vinstr_ctx->job_sample_counters[0] = v4 ?
+				JOB_SAMPLE_GPU_ACTIVE_V4 :
+				JOB_SAMPLE_GPU_ACTIVE;
+			vinstr_ctx->job_sample_nr_counters = 1;
+		}
+		mutex_unlock(&vinstr_ctx->lock);
+
+		spin_lock_irqsave(&kbdev->hwaccess_lock, flags);
+		vinstr_ctx->job_sample_atom = NULL;
+		vinstr_ctx->job_sample_state = JOB_SAMPLE_IDLE;
+		kbdev->hwcnt_job_sample = true;
+		spin_unlock_irqrestore(&kbdev->hwaccess_lock, flags);
+		goto out;
+	}
+
+	spin_lock_irqsave(&kbdev->hwaccess_lock, flags);
+	kbdev->hwcnt_job_sample = false;
+	vinstr_ctx->job_sample_atom = NULL;
+	vinstr_ctx->job_sample_state = JOB_SAMPLE_IDLE;
+	/* Release atoms held back by job sampling. */
+	kbase_backend_slot_update(kbdev);
+	spin_unlock_irqrestore(&kbdev->hwaccess_lock, flags);
+
+	flush_work(&vinstr_ctx->job_sample_work);
+	kbase_vinstr_detach_client(vinstr_ctx->job_sample_cli);
+	vinstr_ctx->job_sample_cli = NULL;
+
+free_buffers:
+	kfree(vinstr_ctx->job_sample_buffer);
+	vinstr_ctx->job_sample_buffer = NULL;
+	kfree(vinstr_ctx->job_sample_start);
+	vinstr_ctx->job_sample_start = NULL;
+out:
+	mutex_unlock(&vinstr_ctx->job_sample_lock);
+
+	return err;
+}
+
+/*****************************************************************************/
+
 struct kbase_vinstr_context *kbase_vinstr_init(struct kbase_device *kbdev)
 {
 	struct kbase_vinstr_context *vinstr_ctx;
@@ -1775,6 +2445,12 @@ struct kbase_vinstr_context *kbase_vinstr_init(struct kbase_device *kbdev)
 
 	atomic_set(&vinstr_ctx->request_pending, 0);
 	init_waitqueue_head(&vinstr_ctx->waitq);
+	atomic64_set(&vinstr_ctx->service_cpu_ns, 0);
+
+	mutex_init(&vinstr_ctx->job_sample_lock);
+	INIT_WORK(&vinstr_ctx->job_sample_work,
+			kbasep_vinstr_job_sample_worker);
+	vinstr_ctx->job_sample_state = JOB_SAMPLE_IDLE;
 
 	return vinstr_ctx;
 }
@@ -1783,6 +2459,9 @@ void kbase_vinstr_term(struct kbase_vinstr_context *vinstr_ctx)
 {
 	struct kbase_vinstr_client *cli;
 
+	/* Detach the job sampling client while vinstr is still running. */
+	kbase_vinstr_job_sample_enable(vinstr_ctx, false);
+
 	/* Stop service thread first. */
 	if (vinstr_ctx->thread)
 		kthread_stop(vinstr_ctx->thread);
@@ -1790,6 +2469,7 @@ void kbase_vinstr_term(struct kbase_vinstr_context *vinstr_ctx)
 	/* Wait for workers. */
 	flush_work(&vinstr_ctx->suspend_work);
 	flush_work(&vinstr_ctx->resume_work);
+	flush_work(&vinstr_ctx->job_sample_work);
 
 	while (1) {
 		struct list_head *list = &vinstr_ctx->idle_clients;
@@ -1803,12 +2483,17 @@ void kbase_vinstr_term(struct kbase_vinstr_context *vinstr_ctx)
 		cli = list_first_entry(list, struct kbase_vinstr_client, list);
 		list_del(&cli->list);
 		kfree(cli->accum_buffer);
+		kfree(cli->accum_snapshot);
+		kfree(cli->block_types);
+		kfree(cli->prev_buffer);
 		kfree(cli);
 		vinstr_ctx->nclients--;
 	}
 	KBASE_DEBUG_ASSERT(!vinstr_ctx->nclients);
 	if (vinstr_ctx->kctx)
 		kbasep_vinstr_destroy_kctx(vinstr_ctx);
+	kfree(vinstr_ctx->job_sample_buffer);
+	kfree(vinstr_ctx->job_sample_start);
 	kfree(vinstr_ctx);
 }
 
@@ -1964,7 +2649,7 @@ int kbase_vinstr_hwc_clear(struct kbase_vinstr_client *cli)
 	rcode = kbase_instr_hwcnt_clear(vinstr_ctx->kctx);
 	if (rcode)
 		goto exit;
-	memset(cli->accum_buffer, 0, cli->dump_size);
+	accum_client_reset(vinstr_ctx, cli);
 
 	kbasep_vinstr_reprogram(vinstr_ctx);
 
@@ -2037,3 +2722,235 @@ void kbase_vinstr_resume(struct kbase_vinstr_context *vinstr_ctx)
 	}
 	spin_unlock_irqrestore(&vinstr_ctx->state_lock, flags);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int kbasep_vinstr_stats_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_device *kbdev = sfile->private;
+	struct kbase_vinstr_context *vinstr_ctx = kbdev->vinstr_ctx;
+	u64 nr_dumps, nr_periodic_dumps, nr_samples, cpu_ns;
+
+	if (!vinstr_ctx)
+		return -ENODEV;
+
+	mutex_lock(&vinstr_ctx->lock);
+	nr_dumps = vinstr_ctx->nr_dumps;
+	nr_periodic_dumps = vinstr_ctx->nr_periodic_dumps;
+	nr_samples = vinstr_ctx->nr_samples;
+	cpu_ns = atomic64_read(&vinstr_ctx->service_cpu_ns);
+	if (vinstr_ctx->thread)
+		cpu_ns += vinstr_ctx->thread->se.sum_exec_runtime;
+	mutex_unlock(&vinstr_ctx->lock);
+
+	seq_printf(sfile, "dumps: %llu\n", nr_dumps);
+	seq_printf(sfile, "periodic_dumps: %llu\n", nr_periodic_dumps);
+	seq_printf(sfile, "samples: %llu\n", nr_samples);
+	seq_printf(sfile, "service_cpu_ns: %llu\n", cpu_ns);
+
+	return 0;
+}
+
+static int kbasep_vinstr_stats_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_vinstr_stats_show, in->i_private);
+}
+
+static const struct file_operations kbasep_vinstr_stats_fops = {
+	.open = kbasep_vinstr_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int kbasep_vinstr_job_sample_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_device *kbdev = sfile->private;
+
+	seq_printf(sfile, "%d\n", kbdev->hwcnt_job_sample);
+
+	return 0;
+}
+
+static int kbasep_vinstr_job_sample_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_vinstr_job_sample_show, in->i_private);
+}
+
+static ssize_t kbasep_vinstr_job_sample_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_device *kbdev = sfile->private;
+	unsigned int enable;
+	int err;
+
+	if (!kbdev->vinstr_ctx)
+		return -ENODEV;
+
+	err = kstrtouint_from_user(ubuf, count, 0, &enable);
+	if (err)
+		return err;
+
+	err = kbase_vinstr_job_sample_enable(kbdev->vinstr_ctx, enable != 0);
+	if (err)
+		return err;
+
+	return count;
+}
+
+static const struct file_operations kbasep_vinstr_job_sample_fops = {
+	.open = kbasep_vinstr_job_sample_open,
+	.read = seq_read,
+	.write = kbasep_vinstr_job_sample_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int kbasep_vinstr_job_sample_counters_show(struct seq_file *sfile,
+		void *data)
+{
+	struct kbase_device *kbdev = sfile->private;
+	struct kbase_vinstr_context *vinstr_ctx = kbdev->vinstr_ctx;
+	u32 i;
+
+	if (!vinstr_ctx)
+		return -ENODEV;
+
+	mutex_lock(&vinstr_ctx->lock);
+	for (i = 0; i < vinstr_ctx->job_sample_nr_counters; i++)
+		seq_printf(sfile, "%s%u", i ? " " : "",
+				vinstr_ctx->job_sample_counters[i]);
+	mutex_unlock(&vinstr_ctx->lock);
+	seq_puts(sfile, "\n");
+
+	return 0;
+}
+
+static int kbasep_vinstr_job_sample_counters_open(struct inode *in,
+		struct file *file)
+{
+	return single_open(file, kbasep_vinstr_job_sample_counters_show,
+			in->i_private);
+}
+
+static ssize_t kbasep_vinstr_job_sample_counters_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_device *kbdev = sfile->private;
+	struct kbase_vinstr_context *vinstr_ctx = kbdev->vinstr_ctx;
+	u32 counters[KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS];
+	u32 nr_cnt, nr_counters = 0;
+	char buf[128], *str, *tok;
+	int err;
+
+	if (!vinstr_ctx)
+		return -ENODEV;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	nr_cnt = kbase_vinstr_dump_size(kbdev) / NR_BYTES_PER_CNT;
+	str = strim(buf);
+	while ((tok = strsep(&str, " ")) != NULL) {
+		if (!*tok)
+			continue;
+		if (nr_counters == ARRAY_SIZE(counters))
+			return -EINVAL;
+		err = kstrtou32(tok, 0, &counters[nr_counters]);
+		if (err)
+			return err;
+		if (counters[nr_counters] >= nr_cnt)
+			return -EINVAL;
+		nr_counters++;
+	}
+
+	mutex_lock(&vinstr_ctx->lock);
+	memcpy(vinstr_ctx->job_sample_counters, counters,
+			nr_counters * sizeof(counters[0]));
+	vinstr_ctx->job_sample_nr_counters = nr_counters;
+	mutex_unlock(&vinstr_ctx->lock);
+
+	return count;
+}
+
+static const struct file_operations kbasep_vinstr_job_sample_counters_fops = {
+	.open = kbasep_vinstr_job_sample_counters_open,
+	.read = seq_read,
+	.write = kbasep_vinstr_job_sample_counters_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kbase_vinstr_debugfs_init(struct kbase_device *kbdev)
+{
+	debugfs_create_file("vinstr_stats", S_IRUGO,
+			kbdev->mali_debugfs_directory, kbdev,
+			&kbasep_vinstr_stats_fops);
+	debugfs_create_file("hwcnt_job_sample", S_IRUGO | S_IWUSR,
+			kbdev->mali_debugfs_directory, kbdev,
+			&kbasep_vinstr_job_sample_fops);
+	debugfs_create_file("hwcnt_job_sample_counters", S_IRUGO | S_IWUSR,
+			kbdev->mali_debugfs_directory, kbdev,
+			&kbasep_vinstr_job_sample_counters_fops);
+}
+#endif /* CONFIG_DEBUG_FS */
+
+#if MALI_UNIT_TEST
+int kbase_vinstr_accum_benchmark(struct kbase_device *kbdev,
+		unsigned int iterations, u64 *scalar_ns, u64 *simd_ns)
+{
+	const size_t block_size = NR_CNT_PER_BLOCK * NR_BYTES_PER_CNT;
+	size_t dump_size = kbase_vinstr_dump_size(kbdev);
+	size_t nr_cnt = dump_size / NR_BYTES_PER_CNT;
+	u64 *dst;
+	u32 *src;
+	u64 start;
+	size_t i;
+	unsigned int it;
+
+	if (!iterations || !scalar_ns || !simd_ns)
+		return -EINVAL;
+
+	dst = vzalloc(nr_cnt * sizeof(u64));
+	src = vmalloc(dump_size);
+	if (!dst || !src) {
+		vfree(dst);
+		vfree(src);
+		return -ENOMEM;
+	}
+
+	/* Fill counters with arbitrary values and enable every block. */
+	for (i = 0; i < nr_cnt; i++)
+		src[i] = (u32)(i * 0x9e3779b9u);
+	for (i = 0; i < dump_size; i += block_size)
+		src[(i + PRFCNT_EN_MASK_OFFSET) / NR_BYTES_PER_CNT] = U32_MAX;
+
+	start = kbasep_vinstr_get_timestamp();
+	for (it = 0; it < iterations; it++)
+		accum_dump_buffer(dst, src, dump_size, false);
+	*scalar_ns = kbasep_vinstr_get_timestamp() - start;
+
+	*simd_ns = 0;
+#ifdef KBASE_VINSTR_ACCUM_NEON
+	if (kbasep_vinstr_has_neon()) {
+		start = kbasep_vinstr_get_timestamp();
+		for (it = 0; it < iterations; it++) {
+			kernel_neon_begin();
+			accum_dump_buffer(dst, src, dump_size, true);
+			kernel_neon_end();
+		}
+		*simd_ns = kbasep_vinstr_get_timestamp() - start;
+	}
+#endif
+
+	vfree(dst);
+	vfree(src);
+
+	return 0;
+}
+KBASE_EXPORT_TEST_API(kbase_vinstr_accum_benchmark);
+#endif /* MALI_UNIT_TEST */
@@ -151,5 +151,100 @@ size_t kbase_vinstr_dump_size(struct kbase_device *kbdev);
  */
 void kbase_vinstr_detach_client(struct kbase_vinstr_client *cli);
 
+/**
+ * kbase_vinstr_job_sample_enable - enable or disable job-boundary sampling
+ * @vinstr_ctx: vinstr context
+ * @enable:     true to enable job sampling
+ *
+ * While job sampling is enabled, atoms flagged with BASE_JD_REQ_HWCNT_SAMPLE
+ * are run alone on the GPU and the hardware counters are dumped before they
+ * are submitted and after they complete. The selected counters counted in
+ * between are emitted in the auxiliary timeline stream, as one message per
+ * atom. Atoms without the flag are only held back while a flagged atom is
+ * waiting for the GPU to drain or is being sampled.
+ *
+ * Return: zero on success
+ */
+int kbase_vinstr_job_sample_enable(struct kbase_vinstr_context *vinstr_ctx,
+		bool enable);
+
+/**
+ * kbase_vinstr_job_sample_submit - check whether an atom may be submitted
+ * @vinstr_ctx: vinstr context
+ * @katom:      atom about to be submitted
+ * @gpu_idle:   true if @katom is at the head of its slot and no other slot
+ *              has an atom submitted
+ *
+ * Must only be called while job sampling is enabled, for an atom that will
+ * be submitted immediately if true is returned. A flagged atom found while
+ * the GPU is busy stops the submission of any other atom until the GPU has
+ * drained, so that it cannot be starved. Once the GPU is idle, counters are
+ * dumped and kbase_backend_slot_update() is called when the atom can be
+ * submitted.
+ *
+ * Context: Caller must hold the HW access lock
+ *
+ * Return: true if the atom may be submitted
+ */
+bool kbase_vinstr_job_sample_submit(struct kbase_vinstr_context *vinstr_ctx,
+		struct kbase_jd_atom *katom, bool gpu_idle);
+
+/**
+ * kbase_vinstr_job_sample_remove - notify that an atom was released from its
+ *                                  job slot
+ * @vinstr_ctx: vinstr context
+ * @katom:      atom released from the slot ringbuffer
+ *
+ * Must only be called while job sampling is enabled. If @katom is being
+ * sampled, counters are dumped again and submission of other atoms resumes
+ * once they have been emitted.
+ *
+ * Context: Caller must hold the HW access lock
+ */
+void kbase_vinstr_job_sample_remove(struct kbase_vinstr_context *vinstr_ctx,
+		struct kbase_jd_atom *katom);
+
+#ifdef CONFIG_DEBUG_FS
+/**
+ * kbase_vinstr_debugfs_init - add vinstr statistics to debugfs
+ * @kbdev: kbase device
+ *
+ * Creates the "vinstr_stats" file, reporting the number of hwcnt dumps, the
+ * number of them requested by the sampling thread, the number of samples
+ * delivered to clients and the CPU time used by the sampling thread. Many
+ * more samples than dumps indicate that client deadlines are being merged.
+ *
+ * Also creates the "hwcnt_job_sample" file, writing 1 or 0 to it enables or
+ * disables job-boundary sampling, and the "hwcnt_job_sample_counters" file
+ * holding the indices in the dump buffer of the counters reported for
+ * sampled atoms, at most KBASE_TLSTREAM_JOB_SAMPLE_NR_COUNTERS of them.
+ * GPU_ACTIVE is reported if none were selected.
+ */
+void kbase_vinstr_debugfs_init(struct kbase_device *kbdev);
+#else
+static inline void kbase_vinstr_debugfs_init(struct kbase_device *kbdev)
+{
+}
+#endif /* CONFIG_DEBUG_FS */
+
+#if MALI_UNIT_TEST
+/**
+ * kbase_vinstr_accum_benchmark - compare counter accumulation implementations
+ * @kbdev:      kbase device, used to size the dump buffer
+ * @iterations: number of dump buffers to accumulate with each implementation
+ * @scalar_ns:  pointer where time taken by the scalar code will be stored
+ * @simd_ns:    pointer where time taken by the SIMD code will be stored, zero
+ *              if SIMD accumulation is not available
+ *
+ * Each iteration accumulates one dump buffer with every block enabled, as
+ * done for one client on every hwcnt dump. The SIMD iterations include the
+ * cost of entering and leaving NEON mode.
+ *
+ * Return: zero on success
+ */
+int kbase_vinstr_accum_benchmark(struct kbase_device *kbdev,
+		unsigned int iterations, u64 *scalar_ns, u64 *simd_ns);
+#endif /* MALI_UNIT_TEST */
+
 #endif /* _KBASE_VINSTR_H_ */
 
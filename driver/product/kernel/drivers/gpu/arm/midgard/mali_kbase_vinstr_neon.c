@@ -0,0 +1,69 @@
+/*
+ *
+ * (C) COPYRIGHT 2016 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+/*
+ * This file is built with NEON enabled and must not contain anything other
+ * than code run between kernel_neon_begin() and kernel_neon_end(). Kernel
+ * headers are not included as they conflict with the compiler's intrinsics
+ * headers, so the prototypes are repeated here using the standard types.
+ */
+
+#include <stddef.h>
+#include <arm_neon.h>
+
+void kbasep_vinstr_accum_neon(uint64_t *dst, const uint32_t *src,
+		size_t count);
+void kbasep_vinstr_delta_neon(uint32_t *dst, const uint64_t *total,
+		uint64_t *snap, size_t count);
+
+void kbasep_vinstr_accum_neon(uint64_t *dst, const uint32_t *src,
+		size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i += 4) {
+		uint32x4_t s = vld1q_u32(&src[i]);
+		uint64x2_t lo = vld1q_u64(&dst[i]);
+		uint64x2_t hi = vld1q_u64(&dst[i + 2]);
+
+		/* Widening add, totals cannot wrap around */
+		vst1q_u64(&dst[i], vaddw_u32(lo, vget_low_u32(s)));
+		vst1q_u64(&dst[i + 2], vaddw_u32(hi, vget_high_u32(s)));
+	}
+}
+
+void kbasep_vinstr_delta_neon(uint32_t *dst, const uint64_t *total,
+		uint64_t *snap, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i += 4) {
+		uint64x2_t t_lo = vld1q_u64(&total[i]);
+		uint64x2_t t_hi = vld1q_u64(&total[i + 2]);
+		uint64x2_t s_lo = vld1q_u64(&snap[i]);
+		uint64x2_t s_hi = vld1q_u64(&snap[i + 2]);
+		uint32x4_t d = vld1q_u32(&dst[i]);
+
+		/* Saturating narrow and add, results are clamped to
+		 * U32_MAX */
+		vst1q_u32(&dst[i], vqaddq_u32(d, vcombine_u32(
+				vqmovn_u64(vsubq_u64(t_lo, s_lo)),
+				vqmovn_u64(vsubq_u64(t_hi, s_hi)))));
+		vst1q_u64(&snap[i], t_lo);
+		vst1q_u64(&snap[i + 2], t_hi);
+	}
+}
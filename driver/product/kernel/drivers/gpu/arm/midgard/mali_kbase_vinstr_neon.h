@@ -0,0 +1,60 @@
+/*
+ *
+ * (C) COPYRIGHT 2016 ARM Limited. All rights reserved.
+ *
+ * This program is free software and is provided to you under the terms of the
+ * GNU General Public License version 2 as published by the Free Software
+ * Foundation, and any use by you of this program is subject to the terms
+ * of such GNU licence.
+ *
+ * A copy of the licence is included with the program, and can also be obtained
+ * from Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ */
+
+
+
+#ifndef _KBASE_VINSTR_NEON_H_
+#define _KBASE_VINSTR_NEON_H_
+
+#include <linux/types.h>
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+#include <asm/neon.h>
+
+#define KBASE_VINSTR_ACCUM_NEON
+
+#ifdef CONFIG_ARM64
+#define kbasep_vinstr_has_neon() true
+#else
+#define kbasep_vinstr_has_neon() cpu_has_neon()
+#endif
+
+/**
+ * kbasep_vinstr_accum_neon - accumulate counters into 64-bit totals
+ * @dst:   64-bit running totals
+ * @src:   counters to add to @dst
+ * @count: number of counters, must be a multiple of 4
+ *
+ * Must be called between kernel_neon_begin() and kernel_neon_end().
+ */
+void kbasep_vinstr_accum_neon(u64 *dst, const u32 *src, size_t count);
+
+/**
+ * kbasep_vinstr_delta_neon - accumulate counters counted since a snapshot
+ * @dst:   accumulation buffer, counters counted since @snap are added with
+ *         saturation to U32_MAX
+ * @total: 64-bit running totals
+ * @snap:  totals at the previous snapshot, updated to @total
+ * @count: number of counters, must be a multiple of 4
+ *
+ * Must be called between kernel_neon_begin() and kernel_neon_end().
+ */
+void kbasep_vinstr_delta_neon(u32 *dst, const u64 *total, u64 *snap,
+		size_t count);
+
+#endif /* CONFIG_KERNEL_MODE_NEON */
+
+#endif /* _KBASE_VINSTR_NEON_H_ */